@@ -3,8 +3,15 @@ import subprocess
 import sys
 import time
 import statistics
+import shlex
 
-def benchmark_cli(cli_path, args, warmup_runs=10, benchmark_runs=100):
+def drop_caches():
+    """Drop the Linux page cache so the next run reads from storage (needs root)."""
+    subprocess.run(["sync"])
+    with open("/proc/sys/vm/drop_caches", "w") as f:
+        f.write("3\n")
+
+def benchmark_cli(cli_path, args, warmup_runs=10, benchmark_runs=100, cold=False):
     """
     Benchmark a CLI application.
     
@@ -13,6 +20,7 @@ def benchmark_cli(cli_path, args, warmup_runs=10, benchmark_runs=100):
         args: Arguments to pass to the CLI
         warmup_runs: Number of warm-up runs (excluded from results)
         benchmark_runs: Number of timed benchmark runs
+        cold: Drop the page cache before every run, to measure storage bound runs
     """
     total_runs = warmup_runs + benchmark_runs
     times = []
@@ -24,6 +32,9 @@ def benchmark_cli(cli_path, args, warmup_runs=10, benchmark_runs=100):
         if i == warmup_runs:
             print(f"Starting {benchmark_runs} benchmark runs...")
         
+        if cold:
+            drop_caches()
+
         start = time.perf_counter()
         result = subprocess.run([cli_path] + args, 
                               capture_output=True, 
@@ -56,12 +67,38 @@ def benchmark_cli(cli_path, args, warmup_runs=10, benchmark_runs=100):
     print(f"Std dev:      {stdev*1000:.2f} ms")
     print("="*50)
 
+    return median_time
+
 if __name__ == "__main__":
-    if len(sys.argv) < 2:
-        print("Usage: python benchmark.py <cli_executable> [args...]")
+    # Options for this script come first; everything after the executable is passed to it
+    #   --cold            drop the page cache before every run (Linux, root)
+    #   --runs N          number of timed runs (default 100)
+    #   --variant "ARGS"  also benchmark with ARGS added, e.g. --variant "--read-order inode"
+    script_args = sys.argv[1:]
+    cold = False
+    runs = 100
+    variants = []
+    while script_args and script_args[0].startswith("--"):
+        option = script_args.pop(0)
+        if option == "--cold":
+            cold = True
+        elif option == "--runs" and script_args:
+            runs = int(script_args.pop(0))
+        elif option == "--variant" and script_args:
+            variants.append(shlex.split(script_args.pop(0)))
+        else:
+            print(f"Unknown option {option}")
+            sys.exit(1)
+
+    if len(script_args) < 1:
+        print("Usage: python benchmark.py [--cold] [--runs N] [--variant ARGS]... <cli_executable> [args...]")
         sys.exit(1)
     
-    cli_executable = sys.argv[1]
-    cli_args = sys.argv[2:]
+    cli_executable = script_args[0]
+    cli_args = script_args[1:]
+    warmup = 0 if cold else 10
     
-    benchmark_cli(cli_executable, cli_args)
+    baseline = benchmark_cli(cli_executable, cli_args, warmup, runs, cold)
+    for variant in variants:
+        median = benchmark_cli(cli_executable, variant + cli_args, warmup, runs, cold)
+        print(f"{' '.join(variant)}: {median / baseline:.2f}x the median time of the baseline")
@@ -0,0 +1,144 @@
+#include "Corpus.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	// SplitMix64: tiny, and unlike the standard distributions it gives the same sequence everywhere
+	class Random
+	{
+	public:
+		explicit Random(uint64_t seed) : state(seed) {}
+
+		uint64_t Next()
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		// in [low, high]
+		uint64_t Between(uint64_t low, uint64_t high)
+		{
+			return low + Next() % (high - low + 1);
+		}
+
+	private:
+		uint64_t state;
+	};
+
+	struct Flavour
+	{
+		const char* extension;
+		std::array<const char*, 6> code;
+		const char* line_comment;
+		const char* block_open;
+		const char* block_close;
+	};
+
+	// Lines with strings that contain comment markers keep the lexer honest
+	constexpr Flavour flavours[]{
+		{ ".cpp", { "int value = compute(42);", "for (int i = 0; i < n; ++i) {", "}", "auto s = \"// not a comment\";",
+			"return std::max(a, b);", "if (ptr != nullptr && ptr->ready()) {" }, "// ", "/*", " */" },
+		{ ".py", { "value = compute(42)", "for i in range(n):", "    total += i", "s = \"# not a comment\"",
+			"return max(a, b)", "if item is not None and item.ready:" }, "# ", "\"\"\"", "\"\"\"" },
+		{ ".js", { "const value = compute(42);", "for (let i = 0; i < n; i++) {", "}", "let s = `/* not a comment */`;",
+			"return Math.max(a, b);", "if (item && item.ready) {" }, "// ", "/*", " */" },
+		{ ".cs", { "var value = Compute(42);", "foreach (var item in items) {", "}", "var s = @\"C:\\path\\// not a comment\";",
+			"return Math.Max(a, b);", "if (item != null && item.Ready) {" }, "// ", "/*", " */" },
+		{ ".go", { "value := compute(42)", "for i := 0; i < n; i++ {", "}", "s := `// not a comment`",
+			"return max(a, b)", "if item != nil && item.Ready() {" }, "// ", "/*", " */" },
+	};
+
+	std::string MakeSource(Random& random, const Flavour& flavour, uint64_t size)
+	{
+		std::string source{};
+		source.reserve(size + 128);
+		while (source.size() < size)
+		{
+			uint64_t kind = random.Between(0, 19);
+			if (kind < 12)
+			{
+				source.append(random.Between(0, 3) * 4, ' ');
+				source += flavour.code[random.Between(0, flavour.code.size() - 1)];
+			}
+			else if (kind < 15)
+			{
+				source += flavour.line_comment;
+				source += "explains the next few lines";
+			}
+			else if (kind < 16)
+			{
+				source += flavour.block_open;
+				source += "\n  a block comment\n  over several lines\n";
+				source += flavour.block_close;
+			}
+			source += '\n';
+		}
+		return source;
+	}
+}
+
+CorpusStats Corpus::Generate(const std::filesystem::path& directory, CORPUS_SHAPE shape)
+{
+	// A stamp written last marks a complete corpus
+	auto stamp = directory / ("corpus-v" + std::to_string(version) + ".stamp");
+	CorpusStats stats{};
+	{
+		std::ifstream existing{ stamp };
+		if (existing >> stats.files >> stats.bytes) return stats;
+	}
+	stats = {};
+
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+
+	size_t files = 0;
+	uint64_t min_size = 0, max_size = 0;
+	size_t per_directory = 0;
+	switch (shape)
+	{
+	case CORPUS_SHAPE::TinyFiles: files = 10000; min_size = 100; max_size = 600; per_directory = 100; break;
+	case CORPUS_SHAPE::LargeFiles: files = 80; min_size = 512 << 10; max_size = 3 << 19; per_directory = 8; break;
+	case CORPUS_SHAPE::Mixed: files = 2000; min_size = 200; max_size = 256 << 10; per_directory = 40; break;
+	}
+
+	Random random{ 0x10C0000ull + static_cast<uint64_t>(shape) };
+	for (size_t i = 0; i < files; ++i)
+	{
+		// mixed sizes are spread evenly over the powers of two, like real trees
+		uint64_t size = random.Between(min_size, max_size);
+		if (shape == CORPUS_SHAPE::Mixed)
+		{
+			uint64_t bits = random.Between(8, 18);
+			size = std::max<uint64_t>(min_size, random.Between(uint64_t{ 1 } << (bits - 1), uint64_t{ 1 } << bits));
+		}
+
+		const auto& flavour = flavours[random.Between(0, std::size(flavours) - 1)];
+		auto folder = directory / ("dir" + std::to_string(i / per_directory / 10)) / ("sub" + std::to_string(i / per_directory));
+		if (i % per_directory == 0) std::filesystem::create_directories(folder);
+
+		auto source = MakeSource(random, flavour, size);
+		std::ofstream{ folder / ("file" + std::to_string(i) + flavour.extension), std::ios::binary } << source;
+
+		stats.files++;
+		stats.bytes += source.size();
+	}
+
+	std::ofstream{ stamp } << stats.files << ' ' << stats.bytes << '\n';
+	return stats;
+}
+
+std::string_view Corpus::Name(CORPUS_SHAPE shape)
+{
+	switch (shape)
+	{
+	case CORPUS_SHAPE::TinyFiles: return "tiny";
+	case CORPUS_SHAPE::LargeFiles: return "large";
+	default: return "mixed";
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+enum class CORPUS_SHAPE
+{
+	TinyFiles,	// thousands of files of a few hundred bytes: enumeration and open/close bound
+	LargeFiles,	// a few files of several MB: lexer bound
+	Mixed		// sizes spread from hundreds of bytes to hundreds of KB, like a real repository
+};
+
+struct CorpusStats
+{
+	size_t files{};
+	uint64_t bytes{};
+};
+
+// Synthetic source trees for benchmarking. The same shape always produces the
+// same bytes, on every platform, so results can be compared with a baseline.
+class Corpus
+{
+public:
+
+	// Writes the corpus into directory, unless a complete one is already there
+	static CorpusStats Generate(const std::filesystem::path& directory, CORPUS_SHAPE shape);
+
+	static std::string_view Name(CORPUS_SHAPE shape);
+
+	// Bump when the generated content changes, so old corpora and baselines aren't reused
+	static constexpr int version = 1;
+};
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "Corpus.h"
+#include "Counter.h"
+
+
+using namespace std;
+namespace fs = std::filesystem;
+
+
+struct Result
+{
+	string corpus{};
+	unsigned jobs{};
+	double files_per_second{};	// end to end
+	double bytes_per_second{};
+	double scan_seconds{};		// finding the files, in the Counter's constructor
+	double count_seconds{};		// counting them, in Count()
+	double scaling{};		// counting files/s against -j 1, or 0 without a -j 1 run
+};
+
+struct Baseline
+{
+	unsigned cpus{};	// hardware threads of the host it was recorded on
+	map<pair<string, unsigned>, Result> results{};
+};
+
+// One result per line, as written by SaveBaseline
+static Baseline LoadBaseline(const fs::path& path)
+{
+	Baseline baseline{};
+	ifstream in{ path };
+	static const regex version{ R"re("corpus_version"\s*:\s*(\d+))re" };
+	static const regex cpus{ R"re("cpus"\s*:\s*(\d+))re" };
+	static const regex field{ R"re("(\w+)"\s*:\s*("(\w+)"|[\d.eE+-]+))re" };
+	string text{};
+	smatch match{};
+	while (getline(in, text))
+	{
+		// results for a different corpus can't be compared
+		if (regex_search(text, match, version) && stoi(match[1]) != Corpus::version)
+		{
+			cerr << "Error: baseline " << path << " was recorded with corpus version " << match[1]
+				<< ", this is version " << Corpus::version << "; record it again with --update-baseline\n";
+			return {};
+		}
+		if (regex_search(text, match, cpus)) baseline.cpus = static_cast<unsigned>(stoul(match[1]));
+		if (text.find("\"corpus\":") == string::npos) continue;
+
+		map<string, string> fields{};
+		for (auto it = sregex_iterator(text.begin(), text.end(), field); it != sregex_iterator(); ++it)
+		{
+			fields[(*it)[1]] = (*it)[3].matched ? (*it)[3].str() : (*it)[2].str();
+		}
+		auto number = [&](const string& name) { return fields.count(name) ? stod(fields[name]) : 0.0; };
+
+		Result result{ fields["corpus"], static_cast<unsigned>(number("jobs")), number("files_per_second"), number("bytes_per_second"),
+			number("scan_seconds"), number("count_seconds"), number("scaling") };
+		baseline.results[{ result.corpus, result.jobs }] = result;
+	}
+
+	// without the host's size, neither throughput nor scaling can be judged
+	if (!baseline.results.empty() && baseline.cpus == 0)
+	{
+		cerr << "Error: baseline " << path << " doesn't say how many CPUs it was recorded on; record it again with --update-baseline\n";
+		return {};
+	}
+	return baseline;
+}
+
+static bool SaveBaseline(const fs::path& path, const vector<Result>& results, unsigned cpus)
+{
+	ofstream out{ path };
+	out << "{\n\t\"corpus_version\": " << Corpus::version << ",\n\t\"cpus\": " << cpus << ",\n\t\"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& result = results[i];
+		out << fixed << setprecision(1)
+			<< "\t\t{ \"corpus\": \"" << result.corpus << "\", \"jobs\": " << result.jobs
+			<< ", \"files_per_second\": " << result.files_per_second
+			<< ", \"bytes_per_second\": " << setprecision(0) << result.bytes_per_second
+			<< ", \"scan_seconds\": " << setprecision(6) << result.scan_seconds
+			<< ", \"count_seconds\": " << result.count_seconds
+			<< ", \"scaling\": " << setprecision(3) << result.scaling << " }"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "\t]\n}\n";
+	return static_cast<bool>(out);
+}
+
+struct Timing
+{
+	double scan{};
+	double count{};
+};
+
+// Seconds for one end-to-end run, split into scanning the tree and counting every file.
+// Short runs are repeated and averaged, so timer and scheduler noise don't swamp them.
+static Timing TimeRun(const fs::path& directory, unsigned jobs)
+{
+	constexpr double min_seconds = 0.25;
+
+	// the counter reports on stdout; keep it out of the benchmark's output
+	ostringstream discard{};
+	auto* previous = cout.rdbuf(discard.rdbuf());
+
+	unsigned repeats = 0;
+	Timing total{};
+	auto start = chrono::steady_clock::now();
+	double elapsed = 0;
+	do
+	{
+		auto begin = chrono::steady_clock::now();
+		Counter counter(jobs, { directory }, {}, false, {});
+		auto scanned = chrono::steady_clock::now();
+		counter.Count();
+		auto counted = chrono::steady_clock::now();
+
+		total.scan += chrono::duration<double>(scanned - begin).count();
+		total.count += chrono::duration<double>(counted - scanned).count();
+		discard.str({});
+		repeats++;
+		elapsed = chrono::duration<double>(counted - start).count();
+	} while (elapsed < min_seconds);
+
+	cout.rdbuf(previous);
+	return { total.scan / repeats, total.count / repeats };
+}
+
+static double Median(vector<double> values)
+{
+	nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+	return values[values.size() / 2];
+}
+
+
+int main(int argc, char** argv)
+{
+	CLI::App app{ "loc.bench: end-to-end throughput of loc on generated source trees" };
+
+	fs::path corpus_directory = fs::temp_directory_path() / "loc.bench";
+	app.add_option("--corpus", corpus_directory, "Directory for the generated trees; they are reused between runs")
+		->capture_default_str();
+
+	fs::path baseline_path{};
+	app.add_option("--baseline", baseline_path, "Baseline results to compare with");
+
+	double tolerance = 0.15;
+	app.add_option("--tolerance", tolerance, "Fail when throughput or scaling drops by more than this fraction of the baseline")
+		->check(CLI::Range(0.0, 1.0))
+		->capture_default_str();
+
+	bool update_baseline = false;
+	app.add_flag("--update-baseline", update_baseline, "Write the results to --baseline instead of comparing with it");
+
+	unsigned runs = 7;
+	app.add_option("--runs", runs, "Timed runs per configuration; the median is used")
+		->check(CLI::PositiveNumber)
+		->capture_default_str();
+
+	vector<unsigned> job_counts{};
+	app.add_option("-j,--jobs", job_counts, "Thread counts to measure (default 1 2 4 8)")
+		->check(CLI::PositiveNumber);
+
+	CLI11_PARSE(app, argc, argv);
+
+	if (job_counts.empty()) job_counts = { 1, 2, 4, 8 };
+
+	if (update_baseline && baseline_path.empty())
+	{
+		cerr << "Error: --update-baseline needs --baseline\n";
+		return 1;
+	}
+
+	Baseline baseline = update_baseline || baseline_path.empty() ? Baseline{} : LoadBaseline(baseline_path);
+	if (!update_baseline && !baseline_path.empty() && baseline.results.empty())
+	{
+		cerr << "Error: no results in baseline " << baseline_path << "\n";
+		return 1;
+	}
+
+	// Throughput is only comparable on the host that recorded the baseline, or one like it. How much faster
+	// more workers count is comparable on any host, up to the CPUs both have.
+	unsigned cpus = max(thread::hardware_concurrency(), 1u);
+	bool same_host = baseline.cpus == cpus;
+	unsigned max_scaled = min(baseline.cpus, cpus);
+	if (!baseline.results.empty())
+	{
+		if (!same_host)
+		{
+			cout << "Baseline was recorded on " << baseline.cpus << " CPUs and this host has " << cpus
+				<< ": throughput isn't compared, only scaling up to -j " << max_scaled << '\n';
+		}
+		if (baseline.cpus < *max_element(job_counts.begin(), job_counts.end()))
+		{
+			cout << "Scaling beyond -j " << baseline.cpus << " isn't checked; record the baseline on a host with more CPUs to check it\n";
+		}
+	}
+
+	vector<Result> results{};
+	bool regressed = false;
+	for (auto shape : { CORPUS_SHAPE::TinyFiles, CORPUS_SHAPE::LargeFiles, CORPUS_SHAPE::Mixed })
+	{
+		string name{ Corpus::Name(shape) };
+		auto directory = corpus_directory / name;
+		auto stats = Corpus::Generate(directory, shape);
+
+		// the first run warms the page cache and the allocator
+		TimeRun(directory, job_counts.front());
+
+		double single_count_seconds = 0;
+		for (unsigned jobs : job_counts)
+		{
+			vector<double> scan{}, count{}, total{};
+			for (unsigned run = 0; run < runs; ++run)
+			{
+				auto timing = TimeRun(directory, jobs);
+				scan.push_back(timing.scan);
+				count.push_back(timing.count);
+				total.push_back(timing.scan + timing.count);
+			}
+			double median = Median(total);
+
+			Result result{ name, jobs, static_cast<double>(stats.files) / median, static_cast<double>(stats.bytes) / median,
+				Median(scan), Median(count) };
+			if (jobs == 1) single_count_seconds = result.count_seconds;
+			if (single_count_seconds > 0) result.scaling = single_count_seconds / result.count_seconds;
+			results.push_back(result);
+
+			cout << left << setw(6) << name << " -j " << setw(3) << jobs << right << fixed << setprecision(0)
+				<< setw(10) << result.files_per_second << " files/s" << setprecision(1)
+				<< setw(8) << result.bytes_per_second / (1 << 20) << " MB/s"
+				<< "   scan" << setw(8) << result.scan_seconds * 1000 << " ms"
+				<< "   count" << setw(8) << result.count_seconds * 1000 << " ms";
+			if (result.scaling > 0) cout << setprecision(2) << setw(7) << result.scaling << "x -j 1";
+			if (jobs > cpus) cout << "   (more jobs than CPUs)";
+
+			auto expected = baseline.results.find({ name, jobs });
+			if (expected != baseline.results.end())
+			{
+				if (same_host)
+				{
+					double ratio = result.files_per_second / expected->second.files_per_second;
+					bool slower = ratio < 1 - tolerance;
+					regressed |= slower;
+					cout << "   " << setprecision(2) << ratio << "x baseline" << (slower ? "   REGRESSION" : "");
+				}
+				if (jobs > 1 && jobs <= max_scaled && result.scaling > 0 && expected->second.scaling > 0)
+				{
+					double ratio = result.scaling / expected->second.scaling;
+					bool worse = ratio < 1 - tolerance;
+					regressed |= worse;
+					cout << "   " << setprecision(2) << ratio << "x baseline scaling" << (worse ? "   REGRESSION" : "");
+				}
+			}
+			cout << '\n';
+		}
+	}
+
+	if (update_baseline)
+	{
+		if (!SaveBaseline(baseline_path, results, cpus))
+		{
+			cerr << "Error: can't write baseline " << baseline_path << "\n";
+			return 1;
+		}
+		cout << "Wrote baseline " << baseline_path << '\n';
+		return 0;
+	}
+
+	if (regressed)
+	{
+		cout << "Throughput or scaling regressed by more than " << setprecision(0) << tolerance * 100 << "% against " << baseline_path << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,331 @@
+#include "Differential.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+#include "Lexer.h"
+#include "LineCounter.h"
+#include "PhysicalLines.h"
+#include "ReferenceLexer.h"
+
+namespace
+{
+    // Every marker of every syntax, and what goes around them. Any syntax is fed all of them: the
+    // markers of other languages are ordinary text to it, and often a prefix of one of its own.
+    constexpr std::string_view pieces[]{
+        "//", "/*", "*/", "/", "*", "\"", "'", "\\", "`", "#", "<#", "#>", "(*", "*)", "(*)",
+        "@\"", "$@\"", "@$\"", "@'", "'@", "\"@", "\"\"", "\"\"\"", "'''", "''",
+        "R\"", "u8R\"", "r\"", "r#\"", "\"#", "r##\"", "\"##", "'\"'", "'\\\"'",
+        "<!--", "-->", "<script", "<SCRIPT", "</script", "<style", "</STYLE", "</style", ">", "<", "=",
+        "\n=begin", "\n=end", "=begin", "=end", "\n```", "```", "``",
+        "(", ")", "delim", "x", "Q", "int a = b;", "s", "def",
+        " ", "  ", "\t", "\n", "\n", "\n", "\r\n", "\r\n", "\r", "\v\f", "\\\n", "\\\r\n", "\n\n",
+        "\xC3\xA9", "\xFF", "\x80", std::string_view("\0", 1),
+    };
+
+    // What very long lines are made of
+    constexpr std::string_view line_pieces[]{ "x", "int a = b;", " ", "\t", "/", "*", "\"", "\\", "'", "#" };
+
+    // Units whose low byte is a marker or a newline, and other units no byte stands for
+    constexpr char32_t wide_units[]{ 0x100, 0x10A, 0x12F, 0x122, 0x127, 0x4E2D, 0xFEFF, 0x2028, 0xFF0A };
+
+    void Append(std::u32string& text, std::string_view bytes)
+    {
+        for (unsigned char c : bytes) text += c;
+    }
+
+    // A raw string literal, well formed or not: a delimiter near or over the limit, a missing
+    // parenthesis or close, a close with the wrong delimiter
+    void AppendRawString(std::u32string& text, std::mt19937_64& random)
+    {
+        std::string delimiter(random() % 19, 'd');
+        for (auto& c : delimiter) c = "dx_)\\ \"("[random() % 100 < 90 ? random() % 3 : 3 + random() % 5];
+        Append(text, "R\"" + delimiter);
+        if (random() % 8) text += U'(';
+        for (int i = static_cast<int>(random() % 6); i > 0; --i) Append(text, pieces[random() % std::size(pieces)]);
+        if (random() % 4 == 0) delimiter += 'x';
+        if (random() % 8) Append(text, ")" + delimiter + "\"");
+    }
+
+    void AppendFence(std::u32string& text, std::mt19937_64& random)
+    {
+        auto tags = LanguageRegistry::FenceTags();
+        std::string tag{ tags[random() % tags.size()].tag };
+        if (random() % 4 == 0) tag.insert(random() % (tag.size() + 1), 1, "xQ "[random() % 3]);
+        Append(text, "\n```" + tag);
+        const char* ends[]{ "\n", "\r\n", "\r", "", " \n" };
+        Append(text, ends[random() % std::size(ends)]);
+    }
+
+    std::string Format(const LineCounts& counts)
+    {
+        std::ostringstream out;
+        out << "code " << counts.code << ", comment " << counts.comment << ", blank " << counts.blank << ", total " << counts.total;
+        return out.str();
+    }
+
+    bool Same(const LineCounts& a, const LineCounts& b)
+    {
+        return a.code == b.code && a.comment == b.comment && a.blank == b.blank && a.total == b.total;
+    }
+
+    std::string Mismatch(const std::string& path, const LineCounts& expected, const LineCounts& actual)
+    {
+        return path + ": expected " + Format(expected) + ", got " + Format(actual);
+    }
+
+    template <typename Unit>
+    std::vector<Unit> Units(const std::u32string& text)
+    {
+        std::vector<Unit> units(text.size());
+        std::transform(text.begin(), text.end(), units.begin(), [](char32_t c) { return static_cast<Unit>(c); });
+        return units;
+    }
+
+    // Chunk sizes: all one, or random with both tiny chunks and ones longer than the kernels' blocks
+    std::vector<size_t> Chunks(size_t size, size_t step, std::mt19937_64& random)
+    {
+        std::vector<size_t> chunks{};
+        while (size) {
+            size_t chunk = step ? step : random() % 3 == 0 ? 1 + random() % 200 : 1 + random() % 8;
+            chunks.push_back(std::min(chunk, size));
+            size -= chunks.back();
+        }
+        return chunks;
+    }
+
+    template <typename Unit>
+    std::string CheckUnits(const Lexer& lexer, const std::vector<Unit>& units, const LineCounts& expected,
+        const std::vector<LineCounts>& expected_slots, const LineCounts& expected_physical, std::mt19937_64& random)
+    {
+        std::string width = "units of " + std::to_string(sizeof(Unit)) + " bytes";
+
+        for (size_t step : { size_t{ 0 }, size_t{ 1 }, units.size() }) {
+            std::string path = width + (step == 0 ? " in random chunks" : step == 1 ? " one at a time" : " at once");
+            auto chunks = Chunks(units.size(), step, random);
+
+            LineCounts counts{};
+            auto state = lexer.Start();
+            const Unit* p = units.data();
+            for (size_t chunk : chunks) {
+                lexer.Feed(state, p, chunk, counts);
+                p += chunk;
+            }
+            lexer.Finish(state, counts);
+            if (!Same(counts, expected)) return Mismatch("Feed, " + path, expected, counts);
+
+            std::vector<LineCounts> slots(lexer.SlotCount());
+            state = lexer.Start();
+            p = units.data();
+            for (size_t chunk : chunks) {
+                lexer.FeedSlots(state, p, chunk, slots.data());
+                p += chunk;
+            }
+            lexer.FinishSlots(state, slots.data());
+            for (size_t slot = 0; slot < slots.size(); ++slot) {
+                if (!Same(slots[slot], expected_slots[slot])) {
+                    return Mismatch("FeedSlots slot " + std::to_string(slot) + ", " + path, expected_slots[slot], slots[slot]);
+                }
+            }
+
+            LineCounts physical{};
+            PhysicalLines::State physical_state{};
+            p = units.data();
+            for (size_t chunk : chunks) {
+                PhysicalLines::Feed(physical_state, p, chunk, physical);
+                p += chunk;
+            }
+            PhysicalLines::Finish(physical_state, physical);
+            if (!Same(physical, expected_physical)) return Mismatch("PhysicalLines, " + path, expected_physical, physical);
+        }
+        return {};
+    }
+
+    // A line with anything but whitespace on it is code
+    LineCounts CountPhysical(const std::u32string& text)
+    {
+        LineCounts counts{};
+        bool has_text = false;
+        for (char32_t c : text) {
+            if (c == U'\n') {
+                counts.total++;
+                has_text ? counts.code++ : counts.blank++;
+                has_text = false;
+            }
+            else if (c != U' ' && (c < U'\t' || c > U'\r')) {
+                has_text = true;
+            }
+        }
+        if (!text.empty() && text.back() != U'\n') {
+            counts.total++;
+            has_text ? counts.code++ : counts.blank++;
+        }
+        return counts;
+    }
+
+    FILE_LANGUAGE LanguageOf(LEXICAL_SYNTAX syntax)
+    {
+        for (size_t i = 0; i < LanguageRegistry::language_count; ++i) {
+            auto language = static_cast<FILE_LANGUAGE>(i);
+            if (LanguageRegistry::GetInfo(language).syntax == syntax) return language;
+        }
+        return FILE_LANGUAGE::Other;
+    }
+
+    // LineCounter reports the total of every slot, and the slots with lines as embedded languages
+    std::string CheckCounter(const LineCounter& counter, const Lexer& lexer, const LineCounts& counts,
+        const std::vector<LineCounts>& expected_slots, const std::string& path)
+    {
+        LineCounts expected{};
+        for (const auto& slot : expected_slots) expected += slot;
+        if (!Same(counts, expected)) return Mismatch(path, expected, counts);
+
+        for (size_t slot = 1; slot < expected_slots.size(); ++slot) {
+            LineCounts embedded{};
+            for (const auto& lines : counter.LastEmbedded()) {
+                if (lines.language == lexer.SlotLanguage(slot)) embedded = lines.lines;
+            }
+            if (!Same(embedded, expected_slots[slot])) return Mismatch(path + ", embedded slot " + std::to_string(slot), expected_slots[slot], embedded);
+        }
+        return {};
+    }
+
+    template <typename Unit>
+    void WriteUnits(std::ofstream& file, const std::u32string& text, bool big_endian)
+    {
+        for (char32_t c : text) {
+            for (size_t i = 0; i < sizeof(Unit); ++i) {
+                size_t shift = 8 * (big_endian ? sizeof(Unit) - 1 - i : i);
+                file.put(static_cast<char>((c >> shift) & 0xFF));
+            }
+        }
+    }
+}
+
+std::u32string Differential::Generate(std::mt19937_64& random, bool wide)
+{
+    std::u32string text{};
+    size_t count = random() % 4 == 0 ? random() % 200 : random() % 30;
+    for (size_t i = 0; i < count; ++i) {
+        switch (random() % 40) {
+        case 0:
+            AppendRawString(text, random);
+            break;
+        case 1:
+            AppendFence(text, random);
+            break;
+        case 2:
+            // a very long line of one piece
+            for (size_t repeat = 100 + random() % 3000; repeat > 0; --repeat) Append(text, line_pieces[random() % std::size(line_pieces)]);
+            break;
+        case 3:
+            if (wide) {
+                text += wide_units[random() % std::size(wide_units)];
+                break;
+            }
+            [[fallthrough]];
+        default:
+            Append(text, pieces[random() % std::size(pieces)]);
+        }
+    }
+    return text;
+}
+
+std::u32string Differential::Padding(size_t units)
+{
+    std::u32string text{};
+    while (text.size() + 80 < units) text += std::u32string(79, U'p') + U'\n';
+    text += std::u32string(units - text.size(), U' ');
+    return text;
+}
+
+std::string Differential::Check(LEXICAL_SYNTAX syntax, const std::u32string& text, std::mt19937_64& random)
+{
+    const Lexer& lexer = Lexer::ForSyntax(syntax);
+    LineCounts expected{};
+    ReferenceLexer::Count(syntax, text, &expected, false);
+    std::vector<LineCounts> expected_slots(lexer.SlotCount());
+    ReferenceLexer::Count(syntax, text, expected_slots.data(), true);
+    LineCounts expected_physical = CountPhysical(text);
+
+    bool narrow = std::all_of(text.begin(), text.end(), [](char32_t c) { return c <= 0xFF; });
+    std::string failure{};
+    if (narrow) failure = CheckUnits(lexer, Units<char>(text), expected, expected_slots, expected_physical, random);
+    if (failure.empty()) failure = CheckUnits(lexer, Units<char16_t>(text), expected, expected_slots, expected_physical, random);
+    if (failure.empty()) failure = CheckUnits(lexer, Units<char32_t>(text), expected, expected_slots, expected_physical, random);
+    if (!failure.empty() || !narrow) return failure;
+
+    // in memory text is UTF-8, whose byte order mark isn't counted
+    if (text.starts_with(U"\xEF\xBB\xBF")) return {};
+    auto bytes = Units<char>(text);
+    LineCounter counter;
+    auto counts = counter.CountText({ bytes.data(), bytes.size() }, LanguageOf(syntax));
+    return CheckCounter(counter, lexer, counts, expected_slots, "CountText");
+}
+
+std::string Differential::CheckFiles(LEXICAL_SYNTAX syntax, const std::u32string& text, const std::filesystem::path& directory)
+{
+    const Lexer& lexer = Lexer::ForSyntax(syntax);
+    std::vector<LineCounts> expected_slots(lexer.SlotCount());
+    ReferenceLexer::Count(syntax, text, expected_slots.data(), true);
+    LineCounts expected_physical = CountPhysical(text);
+
+    struct Encoding
+    {
+        const char* name;
+        size_t unit_size;
+        bool big_endian;
+    };
+    const Encoding encodings[]{ { "UTF-8", 1, false }, { "UTF-16LE", 2, false }, { "UTF-16BE", 2, true }, { "UTF-32LE", 4, false }, { "UTF-32BE", 4, true } };
+
+    char32_t widest = text.empty() ? 0 : *std::max_element(text.begin(), text.end());
+    for (const auto& encoding : encodings) {
+        if (widest >> (8 * encoding.unit_size)) continue;
+
+        // a UTF-16LE mark followed by a NUL is UTF-32LE's mark
+        if (encoding.unit_size == 2 && !encoding.big_endian && text.starts_with(U'\0')) continue;
+
+        // every file starts with a byte order mark, so no text is taken for another encoding
+        auto path = directory / (std::string("differential_") + encoding.name + ".txt");
+        {
+            std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+            std::u32string marked = char32_t{ 0xFEFF } + text;
+            auto bytes = Units<char>(text);
+            if (encoding.unit_size == 1) file << "\xEF\xBB\xBF" << std::string_view(bytes.data(), bytes.size());
+            else if (encoding.unit_size == 2) WriteUnits<char16_t>(file, marked, encoding.big_endian);
+            else WriteUnits<char32_t>(file, marked, encoding.big_endian);
+        }
+
+        LineCounter counter;
+        auto counts = counter.CountLines(path, LanguageOf(syntax));
+        auto failure = CheckCounter(counter, lexer, counts, expected_slots, std::string("CountLines, ") + encoding.name);
+        if (!failure.empty()) return failure;
+
+        LineCounter physical{ false, nullptr, true };
+        counts = physical.CountLines(path, LanguageOf(syntax));
+        if (!Same(counts, expected_physical)) return Mismatch(std::string("physical CountLines, ") + encoding.name, expected_physical, counts);
+    }
+    return {};
+}
+
+std::string Differential::Describe(const std::u32string& text)
+{
+    constexpr size_t longest = 2000;
+    std::ostringstream out;
+    out << '"';
+    for (size_t i = 0; i < std::min(text.size(), longest); ++i) {
+        char32_t c = text[i];
+        if (c == U'\n') out << "\\n";
+        else if (c == U'\r') out << "\\r";
+        else if (c == U'\t') out << "\\t";
+        else if (c == U'"' || c == U'\\') out << '\\' << static_cast<char>(c);
+        else if (c >= 0x20 && c < 0x7F) out << static_cast<char>(c);
+        else out << "\\U" << std::hex << static_cast<uint32_t>(c) << std::dec << ' ';
+    }
+    out << '"';
+    if (text.size() > longest) out << " ... (" << text.size() << " units)";
+    return out.str();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+#include <random>
+#include <string>
+
+#include "LanguageRegistry.h"
+
+// Differential testing of the line counting kernels. Random and adversarial text is counted by every
+// optimised path (the lexer's table fed in chunks of any size and code unit width, its embedded language
+// slots, the physical line kernel, and LineCounter reading files block by block in each encoding) and the
+// counts are compared with ReferenceLexer::Count, which works them out from the lexical rules alone.
+namespace Differential
+{
+    // Text made of the pieces that matter to some lexer: comment and string markers of every syntax, raw
+    // string delimiters, code fences, CR LF, escapes at line ends, and now and then a very long line.
+    // Code units above 0xFF only appear when wide is set.
+    std::u32string Generate(std::mt19937_64& random, bool wide);
+
+    // Filler that puts the next code unit at offset units into the text, for lining markers up with the
+    // blocks files are read in
+    std::u32string Padding(size_t units);
+
+    // Counts text through the lexer and the physical line kernel, splitting it at random. Returns an empty
+    // string when every path agrees with the reference, otherwise what differed.
+    std::string Check(LEXICAL_SYNTAX syntax, const std::u32string& text, std::mt19937_64& random);
+
+    // As Check, through LineCounter::CountLines on a file in directory written in each encoding the text fits
+    std::string CheckFiles(LEXICAL_SYNTAX syntax, const std::u32string& text, const std::filesystem::path& directory);
+
+    // The text as an escaped string literal, cut short when it is long, for reporting a failure
+    std::string Describe(const std::u32string& text);
+}
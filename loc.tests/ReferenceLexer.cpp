@@ -0,0 +1,146 @@
+#include "ReferenceLexer.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Lexer.h"
+
+namespace
+{
+    bool IsBlank(char32_t unit)
+    {
+        return unit == ' ' || unit == '\t' || unit == '\n' || unit == '\r' || unit == '\v' || unit == '\f';
+    }
+
+    // What a line has held so far, of the file's own language and of the embedded language last entered
+    struct Line
+    {
+        bool code{};
+        bool comment{};
+        bool embedded_code{};
+        bool embedded_comment{};
+    };
+
+    // A line with code on it is code, one with only comments is a comment, and any other is blank
+    void Classify(LineCounts& counts, bool code, bool comment)
+    {
+        counts.total++;
+        if (code) counts.code++;
+        else if (comment) counts.comment++;
+        else counts.blank++;
+    }
+}
+
+void ReferenceLexer::Count(LEXICAL_SYNTAX syntax, std::u32string_view text, LineCounts* counts, bool by_slot)
+{
+    auto modes = Lexer::Rules(syntax);
+
+    // slot 0 is the file's own language, then each embedded language in the order its first mode appears
+    std::vector<FILE_LANGUAGE> languages{ FILE_LANGUAGE::Other };
+    for (const auto& mode : modes) {
+        if (std::find(languages.begin(), languages.end(), mode.embedded) == languages.end()) languages.push_back(mode.embedded);
+    }
+    auto slot_of = [&](size_t mode) {
+        return static_cast<size_t>(std::find(languages.begin(), languages.end(), modes[mode].embedded) - languages.begin());
+    };
+
+    // the lexer starts as if after a newline, which doesn't end a line, so tokens anchored to a line start match
+    std::u32string input = U"\n";
+    input += text;
+
+    size_t mode = 0;
+    size_t slot = 0;        // of the mode the text is in
+    size_t embedded = 0;    // the embedded language last entered
+    Line line{};
+
+    auto mark = [&line](bool in_embedded, bool comment) {
+        if (in_embedded) (comment ? line.embedded_comment : line.embedded_code) = true;
+        else (comment ? line.comment : line.code) = true;
+    };
+
+    // Without slots every line is the file's. With them, a line with anything of an embedded language on it
+    // is that language's, judged by that alone; a line with only the file's own is the file's; and a blank
+    // line belongs to the language it is in.
+    auto end_line = [&] {
+        if (!by_slot) Classify(counts[0], line.code || line.embedded_code, line.comment || line.embedded_comment);
+        else if (line.embedded_code || line.embedded_comment) Classify(counts[embedded], line.embedded_code, line.embedded_comment);
+        else if (line.code || line.comment) Classify(counts[0], line.code, line.comment);
+        else Classify(counts[slot], false, false);
+        line = {};
+    };
+    auto consume = [&](size_t at) {
+        if (at > 0 && input[at] == U'\n') end_line();
+    };
+    auto matches = [&](const std::string& token, size_t at) {
+        if (token.size() > input.size() - at) return false;
+        for (size_t i = 0; i < token.size(); ++i) {
+            if (input[at + i] != static_cast<unsigned char>(token[i])) return false;
+        }
+        return true;
+    };
+
+    size_t at = 0;
+    while (at < input.size()) {
+        const auto& spec = modes[mode];
+
+        if (spec.kind == MODE_KIND::CppRawString) {
+            // R"delim( ... )delim" with up to 16 basic characters of delimiter; any other character
+            // ends the literal where it is and the text carries on as code
+            auto delimiter_char = [](char32_t c) {
+                return c < 0x80 && !IsBlank(c) && c != '(' && c != ')' && c != '\\' && c != '"';
+            };
+            size_t open = at;
+            while (open < input.size() && open - at < 16 && delimiter_char(input[open])) ++open;
+
+            size_t end = input.size();
+            if (open < input.size() && input[open] == U'(') {
+                std::u32string close = U")" + input.substr(at, open - at) + U"\"";
+                auto found = input.find(close, open + 1);
+                if (found != std::u32string::npos) end = found + close.size();
+            }
+            else if (open < input.size()) {
+                end = open + 1;
+            }
+
+            for (; at < end; ++at) {
+                if (!IsBlank(input[at])) mark(slot != 0, false);
+                consume(at);
+            }
+            mode = static_cast<size_t>(spec.fallback);
+            continue;
+        }
+
+        // the longest token that matches here
+        const Lexer::TokenSpec* best = nullptr;
+        for (const auto& token : spec.tokens) {
+            if (matches(token.text, at) && (!best || token.text.size() > best->text.size())) best = &token;
+        }
+
+        if (best) {
+            // a newline inside a token ends its line before the token is known
+            size_t last = at + best->text.size() - 1;
+            for (; at < last; ++at) consume(at);
+
+            // a token is comment when it opens or closes one, and belongs to an embedded language
+            // only from inside it to inside it; entering and leaving one is the host's
+            const auto& target = modes[best->target];
+            if (!std::all_of(best->text.begin(), best->text.end(), [](char c) { return IsBlank(static_cast<unsigned char>(c)); })) {
+                bool comment = spec.kind == MODE_KIND::Comment || target.kind == MODE_KIND::Comment;
+                mark(spec.embedded != FILE_LANGUAGE::Other && target.embedded != FILE_LANGUAGE::Other, comment);
+            }
+            consume(at++);
+
+            mode = best->target;
+            slot = slot_of(mode);
+            if (slot) embedded = slot;
+            continue;
+        }
+
+        if (!IsBlank(input[at])) mark(spec.embedded != FILE_LANGUAGE::Other, spec.kind == MODE_KIND::Comment);
+        consume(at++);
+        if (spec.fallback >= 0) mode = static_cast<size_t>(spec.fallback);
+    }
+
+    if (!text.empty() && text.back() != U'\n') end_line();
+}
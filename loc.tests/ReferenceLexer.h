@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string_view>
+
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+
+// The line counts the lexer must give, worked out slowly from its lexical rules alone: every token is tried
+// at every position of the whole text, and each line is classified from what it held, with none of the
+// lexer's table, chunks, code unit widths or mark bits. It is the oracle the differential test compares
+// every optimised path with.
+namespace ReferenceLexer
+{
+    // The counts of Lexer::Feed, or of Lexer::FeedSlots with by_slot set. counts has an entry for each of
+    // the lexer's slots: the file's own language, then each embedded language in the order its rules appear.
+    void Count(LEXICAL_SYNTAX syntax, std::u32string_view text, LineCounts* counts, bool by_slot);
+}
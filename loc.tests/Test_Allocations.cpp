@@ -0,0 +1,146 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Counter.h"
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+
+// Every allocation of the test binary goes through here, so a test can tell how many its own thread made,
+// or how many were made on every thread, the workers of a Counter included
+namespace
+{
+    thread_local size_t allocations = 0;
+    std::atomic<size_t> all_allocations = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    ++all_allocations;
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+    void WriteFile(const std::filesystem::path& path, const std::string& content)
+    {
+        std::ofstream file{ path, std::ios::binary };
+        file << content;
+    }
+
+    // The language of each file and its lines, as a worker does it, returning the allocations made
+    size_t CountAll(LineCounter& counter, const std::vector<std::filesystem::path>& files)
+    {
+        size_t before = allocations;
+        for (const auto& path : files) {
+            counter.CountLines(path, LanguageRegistry::Detect(path));
+        }
+        return allocations - before;
+    }
+
+    // The allocations of a whole count of files with one worker, leaving out the scan before it
+    size_t CountWithWorker(const std::vector<std::filesystem::path>& files, const CounterOptions& options)
+    {
+        Counter counter{ 1, {}, files, false, {}, options };
+        size_t before = all_allocations;
+        counter.Count();
+        return all_allocations - before;
+    }
+
+    // The same kinds of files as the workers meet: small, large, embedded languages, UTF-16, a shebang and a minified file
+    std::vector<std::filesystem::path> WriteTestFiles(const std::filesystem::path& dir, const std::string& suffix)
+    {
+        std::string code = "#include <cstdio>\n\n// a comment\nint main() { /* inline */ return puts(\"x\"); }\n";
+        std::string large{};
+        while (large.size() < 3 * 1024 * 1024) large += code;
+
+        std::u16string wide = u"\uFEFFclass A\n{\n    // comment\n}\n";
+        std::vector<std::filesystem::path> files{
+            dir / ("code" + suffix + ".cpp"),
+            dir / ("large" + suffix + ".cpp"),
+            dir / ("page" + suffix + ".html"),
+            dir / ("wide" + suffix + ".cs"),
+            dir / ("script" + suffix),
+            dir / ("bundle" + suffix + ".js"),
+        };
+        WriteFile(files[0], code);
+        WriteFile(files[1], large);
+        WriteFile(files[2], "<html>\n<script>\nlet a = 1; // note\n</script>\n<style>\np { color: red; }\n</style>\n</html>\n");
+        WriteFile(files[3], std::string(reinterpret_cast<const char*>(wide.data()), wide.size() * sizeof(char16_t)));
+        WriteFile(files[4], "#!/usr/bin/env python3\n# comment\nprint('x')\n");
+        WriteFile(files[5], "var a=1;" + std::string(4000, ';') + "\n");
+        return files;
+    }
+}
+
+TEST_CASE("Counting files makes no allocations once the counter's buffers have grown")
+{
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_allocations";
+    std::filesystem::create_directories(dir);
+
+    auto files = WriteTestFiles(dir, "");
+    files.push_back(dir / "missing.cpp");
+
+    for (bool physical : { false, true }) {
+        LineCounter counter{ true, nullptr, physical };
+        CountAll(counter, files);
+        REQUIRE(CountAll(counter, files) == 0);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+// Twice the files, in the same directory, take no more allocations once the worker is warm. Only the paths
+// a directory count, --tree or --by-project take are checked: with --save-snapshot a worker keeps a name
+// and an entry for every file, and a file that can't be opened is kept with its error, so both allocate.
+TEST_CASE("A Counter's worker makes no allocations per file")
+{
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_worker_allocations";
+    std::filesystem::create_directories(dir);
+
+    auto files = WriteTestFiles(dir, "");
+    auto twice = files;
+    for (const auto& file : WriteTestFiles(dir, "_copy")) twice.push_back(file);
+
+    CounterOptions by_directory{};
+    by_directory.tree = true;
+    by_directory.by_project = true;
+    for (const auto& options : { CounterOptions{}, by_directory }) {
+        // the first count also sets up what lasts the whole run, such as the output's locale
+        CountWithWorker(files, options);
+        size_t once = CountWithWorker(files, options);
+        REQUIRE(CountWithWorker(twice, options) == once);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("A file that can't be opened is reported by the counter, not printed")
+{
+    LineCounter counter{ true };
+    auto lines = counter.CountLines("no_such_directory/missing.cpp", FILE_LANGUAGE::Cpp);
+
+    REQUIRE(lines.total == 0);
+    REQUIRE(counter.LastError() == std::errc::no_such_file_or_directory);
+
+    counter.CountText("int a;\n", FILE_LANGUAGE::Cpp);
+    counter.CountLines(std::string(TEST_DATA_DIR) + "/cpp_file.cpp", FILE_LANGUAGE::Cpp);
+    REQUIRE(!counter.LastError());
+}
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "Counter.h"
+#include "LineCounter.h"
 
 TEST_CASE("Count Lines in a C++ file")
 {
@@ -17,5 +18,37 @@ TEST_CASE("Count Lines in a C++ file")
 
 	Counter counter(1, files);
 
-    REQUIRE(counter.Count() == 21);
+    REQUIRE(counter.Count() == 22);
+}
+
+TEST_CASE("Break down a C++ file into code, comment and blank lines")
+{
+    // Test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    LineCounter counter;
+    LineCounts counts = counter.CountLines(test_dir + "/cpp_file.cpp", FILE_LANGUAGE::Cpp);
+
+    REQUIRE(counts.code == 9);
+    REQUIRE(counts.comment == 9);
+    REQUIRE(counts.blank == 7);
+    REQUIRE(counts.total == 25);
+}
+
+TEST_CASE("Counter totals the line breakdown per language")
+{
+    // Test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    std::vector<std::filesystem::path> files = { test_dir + "/cpp_file.cpp", test_dir + "/header.h" };
+
+    Counter counter(1, files);
+    counter.Count();
+
+    const auto& counts = counter.GetLanguageCounts();
+    REQUIRE(counts.at(FILE_LANGUAGE::Cpp).lines.total == 25);
+    REQUIRE(counts.at(FILE_LANGUAGE::Cpp).files == 1);
+    REQUIRE(counts.at(FILE_LANGUAGE::CHeader).lines.code == 13);
+    REQUIRE(counts.at(FILE_LANGUAGE::CHeader).lines.comment == 5);
+    REQUIRE(counts.at(FILE_LANGUAGE::CHeader).lines.blank == 4);
 }
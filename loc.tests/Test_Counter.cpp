@@ -1,5 +1,7 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <fstream>
+
 #include "Counter.h"
 
 TEST_CASE("Test Counter with glob")
@@ -11,7 +13,7 @@ TEST_CASE("Test Counter with glob")
 
     auto result = counter.Count();
 
-    REQUIRE(result == 33);
+    REQUIRE(result == 34);
 }
 
 TEST_CASE("Test Counter without glob")
@@ -23,7 +25,7 @@ TEST_CASE("Test Counter without glob")
 
     auto result = counter.Count();
 
-    REQUIRE(result == 13);
+    REQUIRE(result == 14);
 }
 
 TEST_CASE("Test Counter with both globs and full paths")
@@ -32,5 +34,73 @@ TEST_CASE("Test Counter with both globs and full paths")
     auto test_dir = std::string(TEST_DATA_DIR);
     Counter counter(4, { test_dir + "/py_file.py", test_dir + "/*.cpp" });
     auto result = counter.Count();
-    REQUIRE(result == 13);
+    REQUIRE(result == 14);
+}
+
+TEST_CASE("Test Counter with overlapping roots and files")
+{
+    // Path to test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    Counter once(4, { test_dir }, {}, false, {});
+    auto expected = once.Count();
+
+    Counter overlapping(4, { test_dir + "/syntax", test_dir, test_dir + "/" },
+        { test_dir + "/cpp_file.cpp", test_dir + "/syntax/../py_file.py" }, false, {});
+    REQUIRE(overlapping.Count() == expected);
+}
+
+TEST_CASE("Test Counter with the same file twice")
+{
+    // Path to test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+    Counter counter(4, { test_dir + "/cpp_file.cpp", test_dir + "/*.cpp", test_dir + "/./cpp_file.cpp" });
+    auto result = counter.Count();
+    REQUIRE(result == 9);
+}
+
+TEST_CASE("Test Counter with pinned workers")
+{
+    // Path to test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    Counter unpinned(4, { test_dir }, {}, false, {});
+    auto expected = unpinned.Count();
+
+    CounterOptions options{};
+    options.pin = true;
+    Counter pinned(4, { test_dir }, {}, false, {}, options);
+    REQUIRE(pinned.Count() == expected);
+    REQUIRE(pinned.GetLanguageCounts().size() == unpinned.GetLanguageCounts().size());
+
+    // every file is taken by one worker, from its own node or another's
+    unsigned int files = 0;
+    for (const auto& stats : pinned.GetWorkerStats()) files += stats.files;
+    unsigned int counted = 0;
+    for (const auto& stats : unpinned.GetWorkerStats()) counted += stats.files;
+    REQUIRE(files == counted);
+    REQUIRE(files > 0);
+}
+
+TEST_CASE("Test Counter with files it can't read")
+{
+    // Path to test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+    auto list = std::filesystem::temp_directory_path() / "loc_test_counter_errors.txt";
+    {
+        std::ofstream file{ list };
+        file << test_dir << "/cpp_file.cpp\n" << test_dir << "/missing_file.cpp\n";
+    }
+
+    CounterOptions options{};
+    options.files_from = list;
+    Counter counter(2, {}, {}, false, {}, options);
+    REQUIRE(counter.Count() == 9);
+
+    // collected by the worker that met it, instead of printed from inside the reader
+    REQUIRE(counter.GetFileErrors().size() == 1);
+    REQUIRE(counter.GetFileErrors()[0].path.filename() == "missing_file.cpp");
+    REQUIRE(counter.GetFileErrors()[0].error == std::errc::no_such_file_or_directory);
+
+    std::filesystem::remove(list);
 }
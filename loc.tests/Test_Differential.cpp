@@ -0,0 +1,87 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "Differential.h"
+#include "FileReader.h"
+
+namespace
+{
+    constexpr size_t syntax_count = static_cast<size_t>(LEXICAL_SYNTAX::Markdown) + 1;
+
+    LEXICAL_SYNTAX SyntaxAt(size_t index)
+    {
+        return static_cast<LEXICAL_SYNTAX>(index % syntax_count);
+    }
+
+    uint64_t Setting(const char* name, uint64_t otherwise)
+    {
+        const char* value = std::getenv(name);
+        return value && *value ? std::strtoull(value, nullptr, 10) : otherwise;
+    }
+}
+
+TEST_CASE("Optimised counting agrees with the reference lexer")
+{
+    std::mt19937_64 random{ 47 };
+    for (size_t i = 0; i < 300 * syntax_count; ++i) {
+        auto syntax = SyntaxAt(i);
+        auto text = Differential::Generate(random, i % 3 == 0);
+
+        auto failure = Differential::Check(syntax, text, random);
+        if (!failure.empty()) FAIL(failure << "\nsyntax " << static_cast<int>(syntax) << ", text " << Differential::Describe(text));
+    }
+}
+
+TEST_CASE("Counting files agrees with the reference lexer across read blocks")
+{
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_differential";
+    std::filesystem::create_directories(dir);
+
+    // markers lined up to straddle the end of the first block, for each width of code unit
+    std::mt19937_64 random{ 4747 };
+    for (size_t unit_size : { 1, 2, 4 }) {
+        size_t block_units = FileReader::block_size / unit_size - (unit_size > 1); // after the byte order mark
+        for (size_t i = 0; i < 4 * syntax_count; ++i) {
+            auto syntax = SyntaxAt(i);
+            auto text = Differential::Padding(block_units - i % 4) + Differential::Generate(random, unit_size > 1);
+
+            auto failure = Differential::CheckFiles(syntax, text, dir);
+            if (!failure.empty()) FAIL(failure << "\nsyntax " << static_cast<int>(syntax) << ", text from the block end " << Differential::Describe(text.substr(block_units - 8)));
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+// A longer run for looking deeper than CI has time for: loc.tests "[fuzz]". LOC_FUZZ_ITERATIONS and
+// LOC_FUZZ_SEED set its length and starting point; a failure prints the seed that reproduces it.
+TEST_CASE("Differential fuzzing against the reference lexer", "[.fuzz]")
+{
+    auto iterations = Setting("LOC_FUZZ_ITERATIONS", 200000);
+    auto seed = Setting("LOC_FUZZ_SEED", std::random_device{}());
+    std::cout << "fuzzing " << iterations << " texts from seed " << seed << "\n";
+
+    auto dir = std::filesystem::temp_directory_path() / "loc_fuzz_differential";
+    std::filesystem::create_directories(dir);
+
+    std::mt19937_64 random{ seed };
+    for (uint64_t i = 0; i < iterations; ++i) {
+        auto syntax = SyntaxAt(random());
+        auto text = Differential::Generate(random, random() % 2 == 0);
+        if (random() % 64 == 0) text = Differential::Padding(FileReader::block_size - random() % 16) + text;
+
+        // files are slow to write, so only some texts are also counted from a file
+        auto failure = Differential::Check(syntax, text, random);
+        if (failure.empty() && random() % 32 == 0) failure = Differential::CheckFiles(syntax, text, dir);
+
+        if (!failure.empty()) {
+            FAIL(failure << "\nseed " << seed << ", iteration " << i << ", syntax " << static_cast<int>(syntax) << ", text " << Differential::Describe(text));
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+}
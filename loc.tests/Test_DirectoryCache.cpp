@@ -0,0 +1,168 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "DirectoryCache.h"
+#include "DirectoryScanner.h"
+
+namespace
+{
+    void WriteFile(const std::filesystem::path& path, const std::string& text)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file{ path, std::ios::binary };
+        file << text;
+    }
+
+    // Directories changed just now aren't cached, so age them
+    void Age(const std::filesystem::path& directory)
+    {
+        std::filesystem::last_write_time(directory, std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+    }
+
+    std::vector<std::filesystem::path> Sorted(std::vector<std::filesystem::path> paths)
+    {
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+}
+
+TEST_CASE("Scanning with a directory cache finds the same files")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+    DirectoryScanner plain;
+    auto expected = Sorted(plain.Scan(test_dir, { "ignored" }));
+
+    DirectoryCache cache;
+    DirectoryScanner cached{ nullptr, &cache };
+    std::vector<uintmax_t> sizes{};
+    std::vector<FILE_LANGUAGE> languages{};
+    auto first = cached.Scan(test_dir, { "ignored" }, true, false, 0, &sizes, nullptr, &languages);
+    REQUIRE(Sorted(first) == expected);
+    REQUIRE(sizes.size() == first.size());
+    REQUIRE(languages.size() == first.size());
+
+    // the second scan replays what it can, and gives the files in the same order with the same languages
+    std::vector<uintmax_t> replayed_sizes{};
+    std::vector<FILE_LANGUAGE> replayed_languages{};
+    auto second = cached.Scan(test_dir, { "ignored" }, true, false, 0, &replayed_sizes, nullptr, &replayed_languages);
+    REQUIRE(second == first);
+    REQUIRE(replayed_sizes == sizes);
+    REQUIRE(replayed_languages == languages);
+}
+
+TEST_CASE("Directory cache only reads directories that changed")
+{
+    DirectoryCache::Stamp stamp{};
+    if (!DirectoryCache::StampOf(std::filesystem::temp_directory_path(), stamp)) SKIP("directories can't be stamped here");
+
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_dir_cache";
+    auto saved = std::filesystem::temp_directory_path() / "loc_test_dir_cache.bin";
+    std::filesystem::remove_all(dir);
+    WriteFile(dir / "a.cpp", "int a;\n");
+    WriteFile(dir / "sub" / "b.py", "b = 1\n");
+    WriteFile(dir / "sub" / "notes.txt", "not source\n");
+    WriteFile(dir / "sub" / "tool", "#!/usr/bin/env python3\nprint(1)\n");
+    WriteFile(dir / "CMakeLists.txt", "cmake_minimum_required(VERSION 3.20)\nproject(test)\n");
+    Age(dir / "sub");
+    Age(dir);
+
+    {
+        DirectoryCache cache;
+        cache.Load(saved.string() + ".missing");
+        DirectoryScanner scanner{ nullptr, &cache };
+        REQUIRE(scanner.Scan(dir).size() == 3);
+        REQUIRE(cache.Hits() == 0);
+        REQUIRE(cache.Misses() == 2);
+        REQUIRE(cache.Save(saved));
+    }
+
+    SECTION("Unchanged directories are replayed")
+    {
+        DirectoryCache cache;
+        cache.Load(saved);
+        DirectoryScanner scanner{ nullptr, &cache };
+        REQUIRE(scanner.Scan(dir).size() == 3);
+        REQUIRE(cache.Hits() == 2);
+        REQUIRE(cache.Misses() == 0);
+    }
+
+    SECTION("Replayed files keep the language they were found with")
+    {
+        // editing a file doesn't change its directory, so the shebang it had then still counts
+        WriteFile(dir / "sub" / "tool", "print(1)\n");
+
+        DirectoryCache cache;
+        cache.Load(saved);
+        DirectoryScanner scanner{ nullptr, &cache };
+        std::vector<FILE_LANGUAGE> languages{};
+        auto paths = scanner.Scan(dir, {}, true, false, 0, nullptr, nullptr, &languages);
+        REQUIRE(cache.Hits() == 2);
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (paths[i].filename() == "tool") REQUIRE(languages[i] == FILE_LANGUAGE::Python);
+        }
+    }
+
+    SECTION("Project manifests are only looked for when asked")
+    {
+        // the scan without --by-project didn't read the CMakeLists.txt, so its listing can't say
+        DirectoryCache::Stamp root{};
+        REQUIRE(DirectoryCache::StampOf(dir, root));
+        DirectoryCache cache;
+        cache.Load(saved);
+        REQUIRE(cache.Find(dir, root, false, false) != nullptr);
+        REQUIRE(cache.Find(dir, root, false, true) == nullptr);
+
+        DirectoryScanner scanner{ nullptr, &cache };
+        std::vector<std::filesystem::path> projects{};
+        REQUIRE(scanner.Scan(dir, {}, true, false, 0, nullptr, &projects).size() == 3);
+        REQUIRE(projects.size() == 1);
+
+        // and once it has been read, the listing says so
+        std::vector<std::filesystem::path> replayed{};
+        size_t hits = cache.Hits();
+        scanner.Scan(dir, {}, true, false, 0, nullptr, &replayed);
+        REQUIRE(cache.Hits() == hits + 2);
+        REQUIRE(replayed == projects);
+    }
+
+    SECTION("A changed directory is read again")
+    {
+        WriteFile(dir / "sub" / "c.cpp", "int c;\n");
+
+        DirectoryCache cache;
+        cache.Load(saved);
+        DirectoryScanner scanner{ nullptr, &cache };
+        REQUIRE(scanner.Scan(dir).size() == 4);
+        REQUIRE(cache.Hits() == 1);
+        REQUIRE(cache.Misses() == 1);
+    }
+
+    SECTION("Different settings start over")
+    {
+        DirectoryCache cache;
+        cache.Load(saved);
+        DirectoryScanner scanner{ nullptr, &cache };
+        REQUIRE(scanner.Scan(dir, { "sub" }).size() == 1);
+        REQUIRE(cache.Hits() == 0);
+    }
+
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove(saved);
+}
+
+TEST_CASE("Directory cache ignores files that aren't caches")
+{
+    auto bad = std::filesystem::temp_directory_path() / "loc_test_bad_dir_cache.bin";
+    WriteFile(bad, "LOCDIRS");
+
+    DirectoryCache cache;
+    cache.Load(bad);
+    REQUIRE(cache.Hits() == 0);
+
+    std::filesystem::remove(bad);
+}
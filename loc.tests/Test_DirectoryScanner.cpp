@@ -1,7 +1,12 @@
 #include <catch2/catch_test_macros.hpp>
 #include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
 
+#include "DirectoryCache.h"
 #include "DirectoryScanner.h"
 
 TEST_CASE("Test DirectoryScanner")
@@ -20,6 +25,15 @@ TEST_CASE("Test DirectoryScanner")
     expected.push_back(test_dir + "/header.h");
     expected.push_back(test_dir + "/fs_file.fs");
     expected.push_back(test_dir + "/xml_file.xml");
+    expected.push_back(test_dir + "/shell_script");
+    expected.push_back(test_dir + "/syntax/cpp_strings.cpp");
+    expected.push_back(test_dir + "/syntax/cs_strings.cs");
+    expected.push_back(test_dir + "/syntax/go_raw.go");
+    expected.push_back(test_dir + "/syntax/html_embedded.html");
+    expected.push_back(test_dir + "/syntax/js_template.js");
+    expected.push_back(test_dir + "/syntax/md_fences.md");
+    expected.push_back(test_dir + "/syntax/py_strings.py");
+    expected.push_back(test_dir + "/syntax/rs_strings.rs");
 
     // Actual data
     std::vector<std::filesystem::path> actual{};
@@ -45,3 +59,95 @@ TEST_CASE("Test DirectoryScanner")
 
     REQUIRE(actual == expected);
 }
+
+TEST_CASE("DirectoryScanner gives the language of each file it finds")
+{
+    DirectoryScanner scanner;
+    std::vector<FILE_LANGUAGE> languages{};
+    auto paths = scanner.Scan(std::string(TEST_DATA_DIR), {}, true, false, 0, nullptr, nullptr, &languages);
+
+    // an extensionless file's shebang is read once, by the scan
+    REQUIRE(languages.size() == paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (paths[i].filename() == "shell_script") REQUIRE(languages[i] == FILE_LANGUAGE::Shell);
+        else REQUIRE(languages[i] == LanguageRegistry::FromPath(paths[i]));
+    }
+}
+
+TEST_CASE("DirectoryScanner recognises project manifests")
+{
+    REQUIRE(DirectoryScanner::IsProjectMarker("web/package.json"));
+    REQUIRE(DirectoryScanner::IsProjectMarker("svc/go.mod"));
+    REQUIRE(DirectoryScanner::IsProjectMarker("tools/Tool.csproj"));
+    REQUIRE_FALSE(DirectoryScanner::IsProjectMarker("web/package.js"));
+    REQUIRE_FALSE(DirectoryScanner::IsProjectMarker("src/main.cpp"));
+
+    // the CMakeLists.txt of this repository calls project(); the one of the tests doesn't
+    auto test_dir = std::filesystem::path(TEST_DATA_DIR);
+    REQUIRE(DirectoryScanner::IsProjectMarker(test_dir.parent_path().parent_path() / "CMakeLists.txt"));
+    REQUIRE_FALSE(DirectoryScanner::IsProjectMarker(test_dir.parent_path() / "CMakeLists.txt"));
+}
+
+TEST_CASE("DirectoryScanner leaves out files by size, age and depth")
+{
+    namespace fs = std::filesystem;
+    auto dir = fs::temp_directory_path() / "loc_test_scan_filter";
+    fs::remove_all(dir);
+    auto write = [](const fs::path& path, size_t size) {
+        fs::create_directories(path.parent_path());
+        std::ofstream file{ path, std::ios::binary };
+        file << std::string(size, '\n');
+    };
+    write(dir / "small.cpp", 10);
+    write(dir / "large.cpp", 10000);
+    write(dir / "old.cpp", 100);
+    write(dir / "a" / "one.cpp", 100);
+    write(dir / "a" / "b" / "two.cpp", 100);
+    fs::last_write_time(dir / "old.cpp", fs::file_time_type::clock::now() - std::chrono::hours(24 * 30));
+
+    // directories changed just now aren't cached
+    for (const auto& directory : { dir, dir / "a", dir / "a" / "b" }) {
+        fs::last_write_time(directory, fs::file_time_type::clock::now() - std::chrono::hours(1));
+    }
+
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    auto names = [&](const std::vector<fs::path>& paths) {
+        std::vector<std::string> relative{};
+        for (const auto& path : paths) relative.push_back(path.lexically_relative(dir).generic_string());
+        std::sort(relative.begin(), relative.end());
+        return relative;
+    };
+
+    ScanFilter by_size{};
+    by_size.min_size = 50;
+    by_size.max_size = 1000;
+    ScanFilter by_age{};
+    by_age.newer_than = now - 7 * 24 * 60 * 60;
+    ScanFilter older{};
+    older.older_than = now - 7 * 24 * 60 * 60;
+    ScanFilter shallow{};
+    shallow.max_depth = 1;
+    ScanFilter top{};
+    top.max_depth = 0;
+
+    // the same with a directory cache, empty and then replaying the listings it kept
+    DirectoryCache cache{};
+    for (DirectoryCache* listings : { static_cast<DirectoryCache*>(nullptr), &cache, &cache }) {
+        std::vector<uintmax_t> sizes{};
+        auto sized = DirectoryScanner{ nullptr, listings, by_size }.Scan(dir, {}, true, false, 0, &sizes);
+        REQUIRE(names(sized) == std::vector<std::string>{ "a/b/two.cpp", "a/one.cpp", "old.cpp" });
+        REQUIRE(sizes == std::vector<uintmax_t>{ 100, 100, 100 });
+
+        REQUIRE(names(DirectoryScanner{ nullptr, listings, by_age }.Scan(dir)) ==
+            std::vector<std::string>{ "a/b/two.cpp", "a/one.cpp", "large.cpp", "small.cpp" });
+        REQUIRE(names(DirectoryScanner{ nullptr, listings, older }.Scan(dir)) == std::vector<std::string>{ "old.cpp" });
+        REQUIRE(names(DirectoryScanner{ nullptr, listings, shallow }.Scan(dir)) ==
+            std::vector<std::string>{ "a/one.cpp", "large.cpp", "old.cpp", "small.cpp" });
+        REQUIRE(names(DirectoryScanner{ nullptr, listings, top }.Scan(dir)) ==
+            std::vector<std::string>{ "large.cpp", "old.cpp", "small.cpp" });
+    }
+    DirectoryCache::Stamp stamp{};
+    if (DirectoryCache::StampOf(dir, stamp)) REQUIRE(cache.Hits() > 0);
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,187 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Counter.h"
+#include "DirectoryTree.h"
+
+namespace
+{
+    LineCounts Code(unsigned long code)
+    {
+        LineCounts lines{};
+        lines.code = code;
+        lines.total = code;
+        return lines;
+    }
+
+    void WriteFile(const std::filesystem::path& path, const std::string& text)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file{ path, std::ios::binary };
+        file << text;
+    }
+}
+
+TEST_CASE("DirectoryTree numbers parents before children")
+{
+    DirectoryTree tree;
+    auto root = tree.AddRoot("project/");
+    auto deep = tree.Add("project/src/net/socket.cpp");
+    auto src = tree.DirectoryOf("project/src/main.cpp");
+
+    REQUIRE(root == 0);
+    REQUIRE(src != DirectoryTree::none);
+    REQUIRE(src > root);
+    REQUIRE(deep > src);
+    REQUIRE(tree.Add("project/src/net/http.cpp") == deep);
+    REQUIRE(tree.DirectoryOf("elsewhere/file.cpp") == DirectoryTree::none);
+    REQUIRE(tree.Size() == 3);
+}
+
+TEST_CASE("DirectoryTree sums partials up the tree")
+{
+    DirectoryTree tree;
+    tree.AddRoot("project");
+    auto lib = tree.Add("project/lib/a.cpp");
+    auto tools = tree.Add("project/tools/b.py");
+    auto top = tree.Add("project/c.cpp");
+
+    // two workers, both with files in lib
+    std::vector<DirectoryTree::Partial> partials(2);
+    partials[0].Record(lib, FILE_LANGUAGE::Cpp, Code(10), 1);
+    partials[1].Record(lib, FILE_LANGUAGE::Cpp, Code(5), 1);
+    partials[1].Record(lib, FILE_LANGUAGE::JavaScript, Code(2), 0);
+    partials[0].Record(tools, FILE_LANGUAGE::Python, Code(7), 1);
+    partials[1].Record(top, FILE_LANGUAGE::Cpp, Code(1), 1);
+
+    tree.Reduce(partials, 2);
+
+    REQUIRE(tree.Lines(lib).code == 17);
+    REQUIRE(tree.Files(lib) == 2);
+    REQUIRE(tree.Languages(lib).size() == 2);
+    REQUIRE(tree.Lines(tools).code == 7);
+    REQUIRE(tree.Lines(top).code == 25);
+    REQUIRE(tree.Files(top) == 4);
+    REQUIRE(tree.Languages(top).size() == 3);
+
+    std::ostringstream out;
+    tree.Print(out, 0);
+    REQUIRE(out.str().find("project  (C++ 64%, Python 28%, JavaScript 8%)") != std::string::npos);
+    REQUIRE(out.str().find("lib") == std::string::npos);
+}
+
+TEST_CASE("DirectoryTree reduces wide trees on several threads")
+{
+    // enough directories on one level for the reduction to split it between threads
+    DirectoryTree tree;
+    tree.AddRoot("root");
+    std::vector<DirectoryTree::Partial> partials(4);
+    for (int i = 0; i < 10000; ++i)
+    {
+        auto directory = tree.Add("root/d" + std::to_string(i) + "/sub/file.cpp");
+        partials[i % 4].Record(directory, FILE_LANGUAGE::Cpp, Code(1), 1);
+    }
+
+    tree.Reduce(partials, 4);
+
+    REQUIRE(tree.Lines(0).code == 10000);
+    REQUIRE(tree.Files(0) == 10000);
+}
+
+TEST_CASE("Counter totals every directory with --tree")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    CounterOptions options{};
+    options.tree = true;
+    Counter counter(4, { test_dir }, {}, false, {}, options);
+    auto lines = counter.Count();
+
+    const DirectoryTree* tree = counter.GetTree();
+    REQUIRE(tree != nullptr);
+
+    uint32_t root = tree->DirectoryOf(test_dir + "/cpp_file.cpp");
+    uint32_t syntax = tree->DirectoryOf(test_dir + "/syntax/go_raw.go");
+    REQUIRE(root != DirectoryTree::none);
+    REQUIRE(syntax != DirectoryTree::none);
+
+    // the root has everything, including the subdirectory
+    REQUIRE(tree->Lines(root).code == lines);
+    REQUIRE(tree->Lines(syntax).code < lines);
+
+    unsigned int files = 0;
+    for (const auto& [language, totals] : counter.GetLanguageCounts()) files += totals.files;
+    REQUIRE(tree->Files(root) == files);
+}
+
+TEST_CASE("DirectoryTree totals projects without the projects nested in them")
+{
+    DirectoryTree tree;
+    tree.AddRoot("repo");
+    auto top = tree.Add("repo/setup.cpp");
+    auto app = tree.Add("repo/app/src/main.cpp");
+    auto lib = tree.Add("repo/app/lib/util.cpp");
+    auto tools = tree.Add("repo/tools/gen.py");
+
+    std::vector<DirectoryTree::Partial> partials(1);
+    partials[0].Record(top, FILE_LANGUAGE::Cpp, Code(1), 1);
+    partials[0].Record(app, FILE_LANGUAGE::Cpp, Code(10), 1);
+    partials[0].Record(lib, FILE_LANGUAGE::Cpp, Code(20), 1);
+    partials[0].Record(tools, FILE_LANGUAGE::Python, Code(3), 1);
+    tree.Reduce(partials, 1);
+
+    // app/lib is a project inside the app project; tools isn't a project, so it is part of the root
+    auto projects = tree.Projects({ "repo/app", "repo/app/lib/" });
+    REQUIRE(projects.size() == 3);
+    REQUIRE(projects[0].path == "repo/app/lib");
+    REQUIRE(projects[0].languages[0].lines.code == 20);
+    REQUIRE(projects[1].path == "repo/app");
+    REQUIRE(projects[1].languages.size() == 1);
+    REQUIRE(projects[1].languages[0].lines.code == 10);
+    REQUIRE(projects[1].languages[0].files == 1);
+    REQUIRE(projects[2].path == "repo");
+    REQUIRE(projects[2].languages.size() == 2);
+    REQUIRE(projects[2].languages[0].language == FILE_LANGUAGE::Python);
+    REQUIRE(projects[2].languages[1].lines.code == 1);
+
+    std::ostringstream out;
+    DirectoryTree::PrintProjects(out, projects);
+    REQUIRE(out.str().find("repo/app/lib\n") != std::string::npos);
+}
+
+TEST_CASE("Counter finds projects in the same scan with --by-project")
+{
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_projects";
+    std::filesystem::remove_all(dir);
+    WriteFile(dir / "CMakeLists.txt", "cmake_minimum_required(VERSION 3.20)\nproject (mono)\n");
+    WriteFile(dir / "lib" / "CMakeLists.txt", "add_library(lib a.cpp)\n");
+    WriteFile(dir / "lib" / "a.cpp", "int a;\nint b;\n");
+    WriteFile(dir / "web" / "package.json", "{}\n");
+    WriteFile(dir / "web" / "app.js", "let x = 1;\n");
+    WriteFile(dir / "web" / "native" / "Cargo.toml", "[package]\n");
+    WriteFile(dir / "web" / "native" / "src" / "main.rs", "fn main() {}\n");
+
+    CounterOptions options{};
+    options.by_project = true;
+    Counter counter(1, { dir }, {}, false, {}, options);
+    counter.Count();
+
+    // a CMakeLists.txt without project() is part of the project above it
+    const auto& projects = counter.GetProjects();
+    REQUIRE(counter.GetTree() == nullptr);
+    REQUIRE(projects.size() == 3);
+    REQUIRE(projects[0].path == dir);
+    REQUIRE(projects[0].languages[0].language == FILE_LANGUAGE::Cpp);
+    REQUIRE(projects[0].languages[0].lines.code == 2);
+    REQUIRE(projects[1].path == dir / "web");
+    REQUIRE(projects[1].languages.size() == 1);
+    REQUIRE(projects[1].languages[0].language == FILE_LANGUAGE::JavaScript);
+    REQUIRE(projects[2].path == dir / "web" / "native");
+    REQUIRE(projects[2].languages[0].language == FILE_LANGUAGE::Rust);
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,95 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Counter.h"
+#include "Estimator.h"
+
+namespace
+{
+    // 1000 small files of 5 to 15 code lines and 10 large files of about 1000
+    void MakePopulation(std::vector<FILE_LANGUAGE>& languages, std::vector<uintmax_t>& sizes, std::vector<LineCounts>& counts)
+    {
+        for (int i = 0; i < 1010; ++i)
+        {
+            bool large = i % 101 == 0;
+            languages.push_back(i % 2 ? FILE_LANGUAGE::Cpp : FILE_LANGUAGE::Python);
+            sizes.push_back(large ? 40000 : 400);
+            unsigned long code = large ? 1000ul + i : 5ul + i % 11;
+            counts.push_back({ code, 2, 1, code + 3 });
+        }
+    }
+}
+
+TEST_CASE("Sampling order is a stratified permutation")
+{
+    std::vector<FILE_LANGUAGE> languages{};
+    std::vector<uintmax_t> sizes{};
+    std::vector<LineCounts> counts{};
+    MakePopulation(languages, sizes, counts);
+
+    Estimator estimator(languages, sizes);
+    auto order = estimator.Order();
+    REQUIRE(order.size() == languages.size());
+
+    // the first tenth of the order holds about a tenth of the large files
+    size_t large = std::count_if(order.begin(), order.begin() + 101, [&](size_t file) { return sizes[file] > 400; });
+    REQUIRE(large >= 1);
+    REQUIRE(large <= 2);
+
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i) REQUIRE(order[i] == i);
+}
+
+TEST_CASE("Estimates tighten and become exact")
+{
+    std::vector<FILE_LANGUAGE> languages{};
+    std::vector<uintmax_t> sizes{};
+    std::vector<LineCounts> counts{};
+    MakePopulation(languages, sizes, counts);
+
+    double exact = 0;
+    for (const auto& c : counts) exact += static_cast<double>(c.code);
+
+    Estimator estimator(languages, sizes, 42);
+    const auto& order = estimator.Order();
+
+    std::vector<EstimatedValue> checkpoints{};
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        estimator.Record(i, counts[order[i]]);
+        if ((i + 1) % 250 == 0) checkpoints.push_back(estimator.TotalCode());
+    }
+
+    // the random sequence differs between standard libraries, so only check what holds for any sample
+    for (const auto& checkpoint : checkpoints)
+    {
+        REQUIRE(checkpoint.margin > 0);
+        REQUIRE(std::abs(checkpoint.value - exact) <= 3 * checkpoint.margin);
+    }
+    REQUIRE(checkpoints.back().margin < checkpoints.front().margin);
+
+    auto total = estimator.TotalCode();
+    REQUIRE(total.value == exact);
+    REQUIRE(total.margin == 0);
+    REQUIRE(estimator.Estimate().at(FILE_LANGUAGE::Cpp).sampled == 505);
+}
+
+TEST_CASE("Counter gives the exact count when it samples every file")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    Counter exact(2, { test_dir }, {}, false, {});
+    auto expected = exact.Count();
+
+    CounterOptions options{};
+    options.estimate = true;
+    options.estimate_precision = 0;
+    Counter sampled(2, { test_dir }, {}, false, {}, options);
+
+    REQUIRE(sampled.Count() == expected);
+    REQUIRE_FALSE(sampled.Estimated());
+    REQUIRE(sampled.GetLanguageCounts().size() == exact.GetLanguageCounts().size());
+}
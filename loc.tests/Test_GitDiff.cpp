@@ -0,0 +1,180 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "GitDiff.h"
+
+namespace
+{
+    void WriteFile(const std::filesystem::path& path, const std::string& text)
+    {
+        std::ofstream file{ path, std::ios::binary };
+        file << text;
+    }
+}
+
+TEST_CASE("Git raw diff output is parsed into file deltas")
+{
+    using namespace std::string_literals;
+    auto output = ":100644 100644 1111111 2222222 M\0src/a.cpp\0"
+        ":000000 100755 0000000 3333333 A\0new.py\0"
+        ":100644 000000 4444444 0000000 D\0old.js\0"
+        ":100644 100644 5555555 6666666 R087\0from.cpp\0to.cpp\0"
+        ":100644 100644 7777777 7777777 C100\0orig.h\0copy.h\0"
+        ":160000 160000 8888888 9999999 M\0lib\0"
+        ":100644 160000 aaaaaaa bbbbbbb T\0vendor.cpp\0"
+        ":160000 100644 ccccccc ddddddd T\0module\0"s;
+
+    auto deltas = GitDiff::ParseRaw(output);
+    REQUIRE(deltas.size() == 7);
+    REQUIRE(deltas[0].status == DIFF_STATUS::Modified);
+    REQUIRE(deltas[0].path == "src/a.cpp");
+    REQUIRE(deltas[1].status == DIFF_STATUS::Added);
+    REQUIRE(deltas[2].status == DIFF_STATUS::Deleted);
+    REQUIRE(deltas[2].old_path == "old.js");
+    REQUIRE(deltas[3].status == DIFF_STATUS::Renamed);
+    REQUIRE(deltas[3].old_path == "from.cpp");
+    REQUIRE(deltas[3].path == "to.cpp");
+    REQUIRE(deltas[4].status == DIFF_STATUS::Added);
+    REQUIRE(deltas[4].path == "copy.h");
+
+    // a submodule has no lines, so only the file on the other side of a type change counts
+    REQUIRE(deltas[5].status == DIFF_STATUS::Deleted);
+    REQUIRE(deltas[5].old_path == "vendor.cpp");
+    REQUIRE(deltas[6].status == DIFF_STATUS::Added);
+    REQUIRE(deltas[6].path == "module");
+}
+
+TEST_CASE("Git diff counts the net change per language between revisions and in the working tree")
+{
+    if (std::system("git --version") != 0) SKIP("git isn't installed");
+
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_git_diff";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    auto git = [&dir](const std::string& arguments) {
+        return std::system(("git -C \"" + dir.string() + "\" -c user.name=loc -c user.email=loc@example.com " + arguments).c_str());
+    };
+
+    REQUIRE(git("init -q") == 0);
+    WriteFile(dir / "a.cpp", "// a\nint a = 1;\n\nint b = 2;\n");
+    WriteFile(dir / "b.py", "x = 1\ny = 2\n");
+    WriteFile(dir / "moved.cpp", "int moved = 0;\n");
+    WriteFile(dir / "notes.txt", "not source\n");
+    REQUIRE(git("add -A") == 0);
+    REQUIRE(git("commit -q -m first") == 0);
+
+    WriteFile(dir / "a.cpp", "// a\nint a = 1;\n\nint b = 2;\nint c = 3;\nint d = 4;\n");
+    std::filesystem::remove(dir / "b.py");
+    WriteFile(dir / "d.js", "/* d */\nlet d = 4;\n");
+    std::filesystem::create_directories(dir / "src");
+    std::filesystem::rename(dir / "moved.cpp", dir / "src" / "moved.cpp");
+    WriteFile(dir / "notes.txt", "still not source\n");
+    REQUIRE(git("add -A") == 0);
+    REQUIRE(git("commit -q -m second") == 0);
+
+    SECTION("Between two commits")
+    {
+        GitDiff diff("HEAD~1..HEAD", { dir }, true);
+        REQUIRE(diff.Load());
+        REQUIRE(diff.Count(2));
+
+        auto languages = diff.ByLanguage();
+        REQUIRE(languages[FILE_LANGUAGE::Cpp].code == 2);
+        REQUIRE(languages[FILE_LANGUAGE::Cpp].files == 2);
+        REQUIRE(languages[FILE_LANGUAGE::Python].code == -2);
+        REQUIRE(languages[FILE_LANGUAGE::JavaScript].code == 1);
+        REQUIRE(languages[FILE_LANGUAGE::JavaScript].comment == 1);
+        REQUIRE(diff.NetCode() == 1);
+
+        bool renamed = false;
+        for (const auto& file : diff.Files())
+        {
+            if (file.status != DIFF_STATUS::Renamed) continue;
+            renamed = true;
+            REQUIRE(file.old_path == "moved.cpp");
+            REQUIRE(file.path == "src/moved.cpp");
+            REQUIRE(file.before.code == file.after.code);
+        }
+        REQUIRE(renamed);
+    }
+
+    SECTION("Against the working tree")
+    {
+        WriteFile(dir / "a.cpp", "// a\nint a = 1;\n");
+        GitDiff diff("HEAD", { dir }, true);
+        REQUIRE(diff.Load());
+        REQUIRE(diff.Count(1));
+
+        REQUIRE(diff.Files().size() == 1);
+        REQUIRE(diff.NetCode() == -3);
+        REQUIRE(diff.ByLanguage()[FILE_LANGUAGE::Cpp].blank == -1);
+    }
+
+    SECTION("Each worker reads every blob of its files through one git")
+    {
+        // both sides of every file, empty and larger than a pipe holds, must line up with the file asked for
+        auto lines = [](size_t count) {
+            std::string text{};
+            for (size_t i = 0; i < count; ++i) text += "int v" + std::to_string(i) + " = 0;\n";
+            return text;
+        };
+        for (size_t i = 0; i < 30; ++i) WriteFile(dir / ("many" + std::to_string(i) + ".cpp"), lines(i));
+        WriteFile(dir / "large.cpp", lines(20000));
+        REQUIRE(git("add -A") == 0);
+        REQUIRE(git("commit -q -m third") == 0);
+
+        for (size_t i = 0; i < 30; ++i) WriteFile(dir / ("many" + std::to_string(i) + ".cpp"), lines(i + 1));
+        WriteFile(dir / "large.cpp", lines(20001));
+        REQUIRE(git("add -A") == 0);
+        REQUIRE(git("commit -q -m fourth") == 0);
+
+        GitDiff diff("HEAD~1..HEAD", { dir }, true);
+        REQUIRE(diff.Load());
+        REQUIRE(diff.Count(3));
+
+        REQUIRE(diff.Files().size() == 31);
+        for (const auto& file : diff.Files())
+        {
+            REQUIRE(file.after.code == file.before.code + 1);
+        }
+        REQUIRE(diff.NetCode() == 31);
+    }
+
+    SECTION("A submodule that moved to another commit is left out")
+    {
+        // the submodule's commits are only in its own repository, so git can't read them from this one
+        std::filesystem::create_directories(dir / "lib");
+        WriteFile(dir / "lib" / "lib.cpp", "int lib = 0;\n");
+        REQUIRE(git("-C lib init -q") == 0);
+        REQUIRE(git("-C lib add -A") == 0);
+        REQUIRE(git("-C lib commit -q -m first") == 0);
+        REQUIRE(git("-c advice.addEmbeddedRepo=false add lib") == 0);
+        REQUIRE(git("commit -q -m third") == 0);
+
+        WriteFile(dir / "lib" / "lib.cpp", "int lib = 1;\nint more = 2;\n");
+        REQUIRE(git("-C lib commit -q -a -m second") == 0);
+        WriteFile(dir / "a.cpp", "// a\nint a = 1;\n");
+        REQUIRE(git("add -A") == 0);
+        REQUIRE(git("commit -q -m fourth") == 0);
+
+        GitDiff diff("HEAD~1..HEAD", { dir }, true);
+        REQUIRE(diff.Load());
+        REQUIRE(diff.Count(2));
+        REQUIRE(diff.Files().size() == 1);
+        REQUIRE(diff.Files().front().path == "a.cpp");
+        REQUIRE(diff.NetCode() == -3);
+
+        // and in the working tree, where the submodule is a directory
+        WriteFile(dir / "lib" / "lib.cpp", "int lib = 2;\n");
+        REQUIRE(git("-C lib commit -q -a -m third") == 0);
+        GitDiff working("HEAD", { dir }, true);
+        REQUIRE(working.Load());
+        REQUIRE(working.Count(1));
+        REQUIRE(working.Files().empty());
+    }
+
+    std::filesystem::remove_all(dir);
+}
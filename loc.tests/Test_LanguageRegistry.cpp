@@ -0,0 +1,56 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <string>
+
+#include "LanguageRegistry.h"
+
+TEST_CASE("Registry maps extensions to languages")
+{
+    REQUIRE(LanguageRegistry::FromExtension(".cpp") == FILE_LANGUAGE::Cpp);
+    REQUIRE(LanguageRegistry::FromExtension(".c++") == FILE_LANGUAGE::Cpp);
+    REQUIRE(LanguageRegistry::FromExtension(".h") == FILE_LANGUAGE::CHeader);
+    REQUIRE(LanguageRegistry::FromExtension(".psm1") == FILE_LANGUAGE::PowerShell);
+    REQUIRE(LanguageRegistry::FromExtension(".xaml") == FILE_LANGUAGE::Xaml);
+    REQUIRE(LanguageRegistry::FromExtension(".txt") == FILE_LANGUAGE::Other);
+    REQUIRE(LanguageRegistry::FromExtension("cpp") == FILE_LANGUAGE::Other);
+    REQUIRE(LanguageRegistry::FromExtension("") == FILE_LANGUAGE::Other);
+    REQUIRE(LanguageRegistry::FromExtension(".averylongextension") == FILE_LANGUAGE::Other);
+}
+
+TEST_CASE("Registry extension lookup is case insensitive by default")
+{
+    REQUIRE(LanguageRegistry::FromExtension(".CPP") == FILE_LANGUAGE::Cpp);
+    REQUIRE(LanguageRegistry::FromExtension(".Py") == FILE_LANGUAGE::Python);
+    REQUIRE(LanguageRegistry::FromExtension(".CPP", false) == FILE_LANGUAGE::Other);
+    REQUIRE(LanguageRegistry::FromPath("src/Main.CS") == FILE_LANGUAGE::CS);
+}
+
+TEST_CASE("Registry reads extensions from paths")
+{
+    REQUIRE(LanguageRegistry::FromPath("dir.d/file.rs") == FILE_LANGUAGE::Rust);
+    REQUIRE(LanguageRegistry::FromPath("archive.tar.go") == FILE_LANGUAGE::Go);
+    REQUIRE(LanguageRegistry::FromPath("dir.cpp/Makefile") == FILE_LANGUAGE::Other);
+    REQUIRE(LanguageRegistry::FromPath(".h") == FILE_LANGUAGE::Other);
+
+    REQUIRE(LanguageRegistry::HasExtension("main.cpp"));
+    REQUIRE_FALSE(LanguageRegistry::HasExtension("dir.d/script"));
+    REQUIRE_FALSE(LanguageRegistry::HasExtension(".bashrc"));
+}
+
+TEST_CASE("Registry detects scripts from their shebang")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    REQUIRE(LanguageRegistry::FromShebang(test_dir + "/shell_script") == FILE_LANGUAGE::Shell);
+    REQUIRE(LanguageRegistry::Detect(test_dir + "/shell_script") == FILE_LANGUAGE::Shell);
+    REQUIRE(LanguageRegistry::FromShebang(test_dir + "/py_file.py") == FILE_LANGUAGE::Other);
+    REQUIRE(LanguageRegistry::FromShebang(test_dir + "/does_not_exist") == FILE_LANGUAGE::Other);
+}
+
+TEST_CASE("Registry provides names and lexical syntax")
+{
+    REQUIRE(LanguageRegistry::GetInfo(FILE_LANGUAGE::CS).name == "C#");
+    REQUIRE(LanguageRegistry::GetInfo(FILE_LANGUAGE::FSharp).syntax == LEXICAL_SYNTAX::FSharp);
+    REQUIRE(LanguageRegistry::GetInfo(FILE_LANGUAGE::TypeScript).syntax == LEXICAL_SYNTAX::JavaScript);
+    REQUIRE(LanguageRegistry::GetInfo(FILE_LANGUAGE::Xml).syntax == LEXICAL_SYNTAX::Markup);
+}
@@ -0,0 +1,198 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Lexer.h"
+#include "LineCounter.h"
+
+namespace
+{
+    LineCounts CountSyntaxFile(const std::string& name, FILE_LANGUAGE language)
+    {
+        auto test_dir = std::string(TEST_DATA_DIR);
+
+        LineCounter counter;
+        return counter.CountLines(test_dir + "/syntax/" + name, language);
+    }
+
+    LineCounts EmbeddedLines(const LineCounter& counter, FILE_LANGUAGE language)
+    {
+        for (const auto& embedded : counter.LastEmbedded()) {
+            if (embedded.language == language) return embedded.lines;
+        }
+        return {};
+    }
+}
+
+TEST_CASE("Lexer handles C++ char literals and raw strings")
+{
+    auto counts = CountSyntaxFile("cpp_strings.cpp", FILE_LANGUAGE::Cpp);
+
+    REQUIRE(counts.code == 10);
+    REQUIRE(counts.comment == 3);
+    REQUIRE(counts.blank == 1);
+    REQUIRE(counts.total == 14);
+}
+
+TEST_CASE("Lexer handles Python triple quoted strings")
+{
+    auto counts = CountSyntaxFile("py_strings.py", FILE_LANGUAGE::Python);
+
+    REQUIRE(counts.code == 10);
+    REQUIRE(counts.comment == 1);
+    REQUIRE(counts.blank == 1);
+}
+
+TEST_CASE("Lexer handles Rust raw strings, char literals and lifetimes")
+{
+    auto counts = CountSyntaxFile("rs_strings.rs", FILE_LANGUAGE::Rust);
+
+    REQUIRE(counts.code == 7);
+    REQUIRE(counts.comment == 1);
+    REQUIRE(counts.blank == 1);
+}
+
+TEST_CASE("Lexer handles JavaScript template literals")
+{
+    auto counts = CountSyntaxFile("js_template.js", FILE_LANGUAGE::JavaScript);
+
+    REQUIRE(counts.code == 7);
+    REQUIRE(counts.comment == 3);
+    REQUIRE(counts.blank == 1);
+}
+
+TEST_CASE("Lexer handles Go raw strings")
+{
+    auto counts = CountSyntaxFile("go_raw.go", FILE_LANGUAGE::Go);
+
+    REQUIRE(counts.code == 6);
+    REQUIRE(counts.comment == 1);
+    REQUIRE(counts.blank == 3);
+}
+
+TEST_CASE("Lexer handles C# verbatim strings")
+{
+    auto counts = CountSyntaxFile("cs_strings.cs", FILE_LANGUAGE::CS);
+
+    REQUIRE(counts.code == 3);
+    REQUIRE(counts.comment == 1);
+    REQUIRE(counts.blank == 1);
+}
+
+TEST_CASE("Lexer state carries across input chunks")
+{
+    std::string_view text = "int a; /* one\n two */ int b;\nauto s = R\"x(\n// )\" )x\";\n// done";
+
+    LineCounter counter;
+    LineCounts whole = counter.CountText(text, FILE_LANGUAGE::Cpp);
+
+    // feed the same text one byte at a time
+    const Lexer& lexer = Lexer::ForSyntax(LEXICAL_SYNTAX::CFamily);
+    auto state = lexer.Start();
+    LineCounts split{};
+    for (char c : text) lexer.Feed(state, &c, 1, split);
+    lexer.Finish(state, split);
+
+    REQUIRE(whole.code == 4);
+    REQUIRE(whole.comment == 1);
+    REQUIRE(whole.total == 5);
+    REQUIRE(split.code == whole.code);
+    REQUIRE(split.comment == whole.comment);
+    REQUIRE(split.blank == whole.blank);
+    REQUIRE(split.total == whole.total);
+}
+
+TEST_CASE("Lexer tables stay small")
+{
+    REQUIRE(Lexer::ForSyntax(LEXICAL_SYNTAX::CFamily).StateCount() < 32);
+    REQUIRE(Lexer::ForSyntax(LEXICAL_SYNTAX::Ruby).StateCount() < 32);
+}
+
+TEST_CASE("Lexer counts the script and style of an HTML page as JavaScript and CSS")
+{
+    LineCounter counter;
+    auto counts = counter.CountLines(std::string(TEST_DATA_DIR) + "/syntax/html_embedded.html", FILE_LANGUAGE::Html);
+
+    // the totals include the embedded lines
+    REQUIRE(counts.total == 19);
+    REQUIRE(counter.LastEmbedded().size() == 2);
+
+    auto css = EmbeddedLines(counter, FILE_LANGUAGE::Css);
+    REQUIRE(css.code == 1);
+    REQUIRE(css.comment == 1);
+    REQUIRE(css.blank == 1);
+
+    // the tags are HTML, and a "</p>" in a string doesn't end the script
+    auto js = EmbeddedLines(counter, FILE_LANGUAGE::JavaScript);
+    REQUIRE(js.code == 1);
+    REQUIRE(js.comment == 1);
+    REQUIRE(js.total == 2);
+
+    REQUIRE(counts.code - css.code - js.code == 13);
+    REQUIRE(counts.comment - css.comment - js.comment == 1);
+}
+
+TEST_CASE("Lexer counts tagged Markdown fences as their language")
+{
+    LineCounter counter;
+    auto counts = counter.CountLines(std::string(TEST_DATA_DIR) + "/syntax/md_fences.md", FILE_LANGUAGE::Markdown);
+
+    REQUIRE(counts.total == 17);
+
+    auto python = EmbeddedLines(counter, FILE_LANGUAGE::Python);
+    REQUIRE(python.code == 1);
+    REQUIRE(python.comment == 1);
+    REQUIRE(python.blank == 1);
+
+    auto js = EmbeddedLines(counter, FILE_LANGUAGE::JavaScript);
+    REQUIRE(js.code == 1);
+    REQUIRE(js.total == 1);
+
+    // prose is comment; an untagged fence is Markdown code
+    REQUIRE(counts.code - python.code - js.code == 1);
+    REQUIRE(counts.comment - python.comment == 8);
+}
+
+TEST_CASE("Lexer doesn't take bytes outside every token for token bytes")
+{
+    // 'x' ends fence tags such as jsx, so another byte must stand for the bytes no token uses
+    LineCounter counter;
+    auto counts = counter.CountText("Text\n```jsQ\nvar a;\n```\n", FILE_LANGUAGE::Markdown);
+
+    REQUIRE(counts.total == 4);
+    REQUIRE(counter.LastEmbedded().empty());
+}
+
+TEST_CASE("Lexer embedded languages carry across input chunks")
+{
+    std::string_view text = "<p>a</p>\n<script>\nvar s = '</b>';\n/* x\n*/</script><style>\n\na {}\n</style>\n";
+
+    const Lexer& lexer = Lexer::ForSyntax(LEXICAL_SYNTAX::Html);
+    std::vector<LineCounts> whole(lexer.SlotCount());
+    auto state = lexer.Start();
+    lexer.FeedSlots(state, text.data(), text.size(), whole.data());
+    lexer.FinishSlots(state, whole.data());
+
+    std::vector<LineCounts> split(lexer.SlotCount());
+    state = lexer.Start();
+    for (char c : text) lexer.FeedSlots(state, &c, 1, split.data());
+    lexer.FinishSlots(state, split.data());
+
+    for (size_t slot = 0; slot < lexer.SlotCount(); ++slot) {
+        REQUIRE(split[slot].code == whole[slot].code);
+        REQUIRE(split[slot].comment == whole[slot].comment);
+        REQUIRE(split[slot].blank == whole[slot].blank);
+    }
+
+    // Feed counts every line together
+    LineCounts together{};
+    state = lexer.Start();
+    lexer.Feed(state, text.data(), text.size(), together);
+    lexer.Finish(state, together);
+    REQUIRE(together.total == 8);
+    REQUIRE(together.code == 6);
+    REQUIRE(together.comment == 1);
+    REQUIRE(together.blank == 1);
+}
@@ -0,0 +1,134 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Counter.h"
+#include "PartialResult.h"
+
+TEST_CASE("Shards partition the files")
+{
+    // Test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    Counter whole(1, { test_dir }, {}, false, {});
+    auto total = whole.Count();
+
+    unsigned long sharded_total = 0;
+    unsigned int sharded_files = 0;
+    for (unsigned int shard = 1; shard <= 3; ++shard)
+    {
+        CounterOptions options{};
+        options.shard_index = shard;
+        options.shard_count = 3;
+
+        Counter counter(1, { test_dir }, {}, false, {}, options);
+        sharded_total += counter.Count();
+        for (const auto& [language, totals] : counter.GetLanguageCounts()) sharded_files += totals.files;
+    }
+
+    unsigned int files = 0;
+    for (const auto& [language, totals] : whole.GetLanguageCounts()) files += totals.files;
+
+    REQUIRE(sharded_total == total);
+    REQUIRE(sharded_files == files);
+}
+
+TEST_CASE("Shard assignment only depends on the relative path")
+{
+    REQUIRE(Counter::ShardOf("src/main.cpp", 7) == Counter::ShardOf("src/./main.cpp", 7));
+    REQUIRE(Counter::ShardOf("src/main.cpp", 1) == 1);
+    REQUIRE(Counter::ShardOf("src/main.cpp", 7) >= 1);
+    REQUIRE(Counter::ShardOf("src/main.cpp", 7) <= 7);
+}
+
+TEST_CASE("Partial results round trip and merge")
+{
+    // Test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+    auto partial = std::filesystem::temp_directory_path() / "loc_test_partial.txt";
+
+    Counter counter(1, std::vector<std::filesystem::path>{ test_dir + "/cpp_file.cpp", test_dir + "/header.h" });
+    counter.Count();
+    REQUIRE(PartialResult::Save(partial, counter.GetLanguageCounts()));
+
+    std::map<FILE_LANGUAGE, LanguageTotals> merged{};
+    REQUIRE(PartialResult::Load(partial, merged));
+    REQUIRE(PartialResult::Load(partial, merged));
+
+    REQUIRE(merged.at(FILE_LANGUAGE::CHeader).lines.code == 26);
+    REQUIRE(merged.at(FILE_LANGUAGE::CHeader).files == 2);
+    REQUIRE(merged.at(FILE_LANGUAGE::Cpp).lines.total == 50);
+
+    std::filesystem::remove(partial);
+}
+
+TEST_CASE("Malformed partial results are rejected")
+{
+    auto partial = std::filesystem::temp_directory_path() / "loc_test_bad_partial.txt";
+    {
+        std::ofstream file{ partial };
+        file << "loc-partial 1\nNotALanguage\t1\t2\t3\t4\t5\n";
+    }
+
+    std::map<FILE_LANGUAGE, LanguageTotals> merged{};
+    REQUIRE_FALSE(PartialResult::Load(partial, merged));
+    REQUIRE(merged.empty());
+
+    std::filesystem::remove(partial);
+}
+
+TEST_CASE("Partial results carry the skipped files")
+{
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_partial_skipped";
+    std::filesystem::create_directories(dir);
+    for (int i = 0; i < 6; ++i)
+    {
+        std::ofstream{ dir / ("code" + std::to_string(i) + ".cpp") } << "int a;\n";
+        std::ofstream{ dir / ("generated" + std::to_string(i) + ".cpp") } << "// Code generated by protoc. DO NOT EDIT.\nint a;\n";
+        std::ofstream{ dir / ("binary" + std::to_string(i) + ".c"), std::ios::binary } << std::string("int\0a;\n", 7);
+    }
+
+    Counter whole(1, { dir }, {}, false, {});
+    whole.Count();
+
+    // the shards' skipped files add up to those of a single run
+    SkippedCounts merged_skipped{};
+    std::map<FILE_LANGUAGE, LanguageTotals> merged{};
+    auto partial = dir / "partial.txt";
+    for (unsigned int shard = 1; shard <= 2; ++shard)
+    {
+        CounterOptions options{};
+        options.shard_index = shard;
+        options.shard_count = 2;
+        Counter counter(1, { dir }, {}, false, {}, options);
+        counter.Count();
+        REQUIRE(PartialResult::Save(partial, counter.GetLanguageCounts(), counter.GetSkippedCounts()));
+        REQUIRE(PartialResult::Load(partial, merged, &merged_skipped));
+    }
+
+    REQUIRE(whole.GetSkippedCount(FILE_KIND::Generated) == 6);
+    REQUIRE(whole.GetSkippedCount(FILE_KIND::Binary) == 6);
+    REQUIRE(merged_skipped == whole.GetSkippedCounts());
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Partial results from before skipped files were kept still load")
+{
+    auto partial = std::filesystem::temp_directory_path() / "loc_test_partial_v1.txt";
+    {
+        std::ofstream file{ partial };
+        file << "loc-partial 1\nC++\t1\t9\t2\t3\t14\n";
+    }
+
+    std::map<FILE_LANGUAGE, LanguageTotals> merged{};
+    SkippedCounts skipped{};
+    REQUIRE(PartialResult::Load(partial, merged, &skipped));
+    REQUIRE(merged.at(FILE_LANGUAGE::Cpp).lines.code == 9);
+    REQUIRE(skipped == SkippedCounts{});
+
+    std::filesystem::remove(partial);
+}
@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Counter.h"
+#include "PathQueue.h"
+
+TEST_CASE("Path queue hands every path to the workers once")
+{
+    PathQueue queue{ 8 };
+    std::vector<std::vector<std::filesystem::path>> received(3);
+
+    std::vector<std::jthread> workers{};
+    for (auto& paths : received)
+    {
+        workers.emplace_back([&queue, &paths] {
+            std::vector<std::filesystem::path> batch{};
+            while (queue.PopBatch(batch, 5)) paths.insert(paths.end(), batch.begin(), batch.end());
+        });
+    }
+
+    // far more paths than fit in the queue, so the producer has to wait for the workers
+    for (int i = 0; i < 1000; ++i) queue.Push(std::to_string(i));
+    queue.Close();
+    workers.clear();
+
+    std::vector<bool> seen(1000);
+    size_t total = 0;
+    for (const auto& paths : received)
+    {
+        for (const auto& path : paths)
+        {
+            int i = std::stoi(path.string());
+            REQUIRE_FALSE(seen[i]);
+            seen[i] = true;
+            total++;
+        }
+    }
+    REQUIRE(total == 1000);
+}
+
+TEST_CASE("Counter counts the files in a file list")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+    auto list = std::filesystem::temp_directory_path() / "loc_test_file_list.txt";
+
+    Counter expected(2, { test_dir + "/py_file.py", test_dir + "/cpp_file.cpp" });
+    auto expected_lines = expected.Count();
+
+    SECTION("one per line")
+    {
+        std::ofstream{ list, std::ios::binary } << test_dir << "/py_file.py\r\n\n" << test_dir << "/cpp_file.cpp\n" << test_dir << "/readme.txt\n";
+
+        CounterOptions options{};
+        options.files_from = list;
+        Counter counter(2, {}, {}, false, {}, options);
+        REQUIRE(counter.Count() == expected_lines);
+        REQUIRE(counter.GetLanguageCounts().size() == 2);
+    }
+
+    SECTION("NUL separated")
+    {
+        std::ofstream{ list, std::ios::binary } << test_dir << "/py_file.py" << '\0' << test_dir << "/cpp_file.cpp" << '\0';
+
+        CounterOptions options{};
+        options.files_from = list;
+        options.null_separated = true;
+        Counter counter(2, {}, {}, false, {}, options);
+        REQUIRE(counter.Count() == expected_lines);
+        REQUIRE_FALSE(counter.Failed());
+    }
+
+    std::filesystem::remove(list);
+}
+
+TEST_CASE("A file list that can't be read fails the count")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    CounterOptions options{};
+    options.files_from = std::filesystem::temp_directory_path() / "loc_test_missing_list.txt";
+    std::filesystem::remove(options.files_from);
+
+    // the files given directly are still counted, but the result is incomplete
+    Counter counter(2, {}, { test_dir + "/cpp_file.cpp" }, false, {}, options);
+    REQUIRE(counter.Count() > 0);
+    REQUIRE(counter.Failed());
+}
@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "DirectoryScanner.h"
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+#include "PhysicalLines.h"
+
+namespace
+{
+    LineCounts CountPhysical(std::string_view text)
+    {
+        PhysicalLines::State state{};
+        LineCounts counts{};
+        PhysicalLines::Feed(state, text.data(), text.size(), counts);
+        PhysicalLines::Finish(state, counts);
+        return counts;
+    }
+}
+
+TEST_CASE("PhysicalLines splits lines into blank and code")
+{
+    auto counts = CountPhysical("int a;\n\n  \t\r\n// comment\n \f\v\nlast");
+
+    REQUIRE(counts.total == 6);
+    REQUIRE(counts.code == 3);
+    REQUIRE(counts.blank == 3);
+    REQUIRE(counts.comment == 0);
+
+    // a whitespace only last line without a newline is still a blank line
+    auto trailing = CountPhysical("x\n   ");
+    REQUIRE(trailing.total == 2);
+    REQUIRE(trailing.blank == 1);
+
+    REQUIRE(CountPhysical("").total == 0);
+    REQUIRE(CountPhysical("\n").blank == 1);
+}
+
+TEST_CASE("PhysicalLines gives the same counts however the input is split")
+{
+    // long and short lines, so lines start and end on both sides of the 64 byte chunks
+    std::mt19937 random{ 42 };
+    std::string text{};
+    for (int line = 0; line < 500; ++line)
+    {
+        size_t length = random() % 3 == 0 ? random() % 200 : random() % 8;
+        for (size_t i = 0; i < length; ++i) text += " \txy;\r"[random() % 6];
+        text += '\n';
+    }
+    text += "  tail";
+
+    auto whole = CountPhysical(text);
+
+    // compared against the obvious byte at a time count
+    LineCounts expected{};
+    bool has_text = false;
+    for (char c : text)
+    {
+        if (c == '\n')
+        {
+            expected.total++;
+            has_text ? expected.code++ : expected.blank++;
+            has_text = false;
+        }
+        else if (c != ' ' && c != '\t' && c != '\r') has_text = true;
+    }
+    expected.total++;
+    expected.code++;
+
+    REQUIRE(whole.total == expected.total);
+    REQUIRE(whole.code == expected.code);
+    REQUIRE(whole.blank == expected.blank);
+
+    for (size_t step : { 1, 7, 63, 64, 65, 1000 })
+    {
+        PhysicalLines::State state{};
+        LineCounts split{};
+        for (size_t i = 0; i < text.size(); i += step)
+        {
+            auto part = std::string_view(text).substr(i, step);
+            PhysicalLines::Feed(state, part.data(), part.size(), split);
+        }
+        PhysicalLines::Finish(state, split);
+
+        REQUIRE(split.total == whole.total);
+        REQUIRE(split.code == whole.code);
+        REQUIRE(split.blank == whole.blank);
+    }
+}
+
+TEST_CASE("PhysicalLines counts wide text")
+{
+    std::u16string text = u"a\n\n é\n";
+    PhysicalLines::State state{};
+    LineCounts counts{};
+    PhysicalLines::Feed(state, text.data(), text.size(), counts);
+    PhysicalLines::Finish(state, counts);
+
+    REQUIRE(counts.total == 3);
+    REQUIRE(counts.code == 2);
+    REQUIRE(counts.blank == 1);
+}
+
+TEST_CASE("Physical counts agree with the lexer on blank lines")
+{
+    // every line the lexer calls code or comment is a non-blank physical line
+    DirectoryScanner scanner;
+    for (const auto& path : scanner.Scan(std::string(TEST_DATA_DIR), {}))
+    {
+        FILE_LANGUAGE language = LanguageRegistry::Detect(path);
+        LineCounter lexed{ false };
+        LineCounter physical{ false, nullptr, true };
+        auto full = lexed.CountLines(path, language);
+        auto fast = physical.CountLines(path, language);
+
+        INFO(path.string());
+        REQUIRE(fast.total == full.total);
+        REQUIRE(fast.blank == full.blank);
+        REQUIRE(fast.code == full.code + full.comment);
+        REQUIRE(fast.comment == 0);
+    }
+}
@@ -0,0 +1,98 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Counter.h"
+#include "DirectoryScanner.h"
+#include "Prefetcher.h"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Prefetch window follows the read latency")
+{
+    // cached reads keep the window at its minimum
+    REQUIRE(Prefetcher::ComputeWindow(0ns, 10000, 8, 512) == 8);
+
+    // 1ms reads at 10,000 files/s means 10 files in flight, doubled for headroom
+    REQUIRE(Prefetcher::ComputeWindow(1ms, 10000, 8, 512) == 28);
+
+    // never beyond the limit
+    REQUIRE(Prefetcher::ComputeWindow(100ms, 10000, 8, 512) == 512);
+}
+
+TEST_CASE("Prefetch window changes are damped")
+{
+    // small changes are ignored
+    REQUIRE(Prefetcher::DampWindow(100, 110) == 100);
+    REQUIRE(Prefetcher::DampWindow(100, 80) == 100);
+
+    // larger ones are followed
+    REQUIRE(Prefetcher::DampWindow(100, 130) == 130);
+    REQUIRE(Prefetcher::DampWindow(100, 60) == 60);
+
+    // but one sample can at most double or halve the window
+    REQUIRE(Prefetcher::DampWindow(100, 1000) == 200);
+    REQUIRE(Prefetcher::DampWindow(100, 10) == 50);
+}
+
+TEST_CASE("Prefetcher stops once the workers are done")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    DirectoryScanner scanner;
+    auto paths = scanner.Scan(test_dir, {});
+    std::atomic<size_t> next_index = 0;
+
+    Prefetcher prefetcher(paths, next_index, 1, 4);
+    prefetcher.Start();
+    while (next_index < paths.size())
+    {
+        std::this_thread::sleep_for(1ms);
+        next_index++;
+    }
+    prefetcher.Stop();
+
+    REQUIRE(prefetcher.Prefetched() <= paths.size());
+    REQUIRE(prefetcher.Window() >= 4);
+}
+
+TEST_CASE("Prefetcher reads the files the workers have claimed but not opened")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    DirectoryScanner scanner;
+    auto paths = scanner.Scan(test_dir, {});
+
+    // a single batch taking every file, none of which has been opened yet
+    std::atomic<size_t> next_index = paths.size();
+
+    Prefetcher prefetcher(paths, next_index, paths.size(), 4);
+    prefetcher.Start();
+    for (int i = 0; i < 5000 && prefetcher.Prefetched() < paths.size(); ++i)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    prefetcher.Stop();
+
+#ifdef __linux__
+    REQUIRE(prefetcher.Prefetched() == paths.size());
+#endif
+}
+
+TEST_CASE("Prefetching doesn't change the counts")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    Counter plain(2, { test_dir }, {}, false, {});
+    auto expected = plain.Count();
+
+    CounterOptions options{};
+    options.prefetch = true;
+    Counter prefetched(2, { test_dir }, {}, false, {}, options);
+
+    REQUIRE(prefetched.Count() == expected);
+    REQUIRE(prefetched.GetLanguageCounts().size() == plain.GetLanguageCounts().size());
+}
@@ -0,0 +1,63 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Counter.h"
+#include "ProgressReporter.h"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Progress reports what the workers published")
+{
+    std::vector<std::filesystem::path> paths{ "a.cpp", "b \"quoted\".cpp", "c.cpp" };
+    std::ostringstream out;
+    ProgressReporter reporter(paths, 2, PROGRESS_FORMAT::Json, 1000ms, out);
+
+    reporter.Worker(0).Begin(0);
+    reporter.Worker(0).Done(100);
+    reporter.Worker(1).Begin(1);
+
+    auto report = reporter.Report();
+    REQUIRE(report.find("\"files_done\":1,") != std::string::npos);
+    REQUIRE(report.find("\"files_total\":3,") != std::string::npos);
+    REQUIRE(report.find("\"bytes_done\":100,") != std::string::npos);
+    REQUIRE(report.find("{\"files\":1,\"bytes\":100,\"current\":null}") != std::string::npos);
+    REQUIRE(report.find("\"current\":\"b \\\"quoted\\\".cpp\"") != std::string::npos);
+}
+
+TEST_CASE("Progress is reported at the interval and once more at the end")
+{
+    std::vector<std::filesystem::path> paths{ "a.cpp" };
+    std::ostringstream out;
+    ProgressReporter reporter(paths, 1, PROGRESS_FORMAT::Text, 10ms, out);
+
+    reporter.Start();
+    std::this_thread::sleep_for(50ms);
+    reporter.Worker(0).Begin(0);
+    reporter.Worker(0).Done(2048);
+    reporter.Stop();
+
+    auto text = out.str();
+    REQUIRE(text.find('\r') != std::string::npos);
+    REQUIRE(text.find("1/1 files, 2.0 KB") != std::string::npos);
+    REQUIRE(text.back() == '\n');
+}
+
+TEST_CASE("Progress reporting doesn't change the counts")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    Counter plain(2, { test_dir }, {}, false, {});
+    auto expected = plain.Count();
+
+    CounterOptions options{};
+    options.progress = PROGRESS_FORMAT::Json;
+    options.progress_interval = 1ms;
+    Counter reported(2, { test_dir }, {}, false, {}, options);
+
+    REQUIRE(reported.Count() == expected);
+}
@@ -0,0 +1,146 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+#include "DirectoryScanner.h"
+#include "ReadOrder.h"
+
+#ifdef __linux__
+namespace
+{
+    // The device and inode of a file, which is what the inode order sorts by
+    std::pair<dev_t, ino_t> InodeKey(const std::filesystem::path& path)
+    {
+        struct stat st{};
+        REQUIRE(stat(path.c_str(), &st) == 0);
+        return { st.st_dev, st.st_ino };
+    }
+
+    std::vector<std::filesystem::path> MakeFiles(const std::filesystem::path& dir, int count)
+    {
+        std::filesystem::create_directories(dir);
+        std::vector<std::filesystem::path> files{};
+        for (int i = 0; i < count; ++i) {
+            files.push_back(dir / ("file" + std::to_string(i) + ".cpp"));
+            std::ofstream{ files.back() } << "int a;\n";
+        }
+        return files;
+    }
+}
+#endif
+
+TEST_CASE("Read order keeps every file")
+{
+    // Test files directory
+    auto test_dir = std::string(TEST_DATA_DIR);
+
+    DirectoryScanner scanner;
+    auto expected = scanner.Scan(test_dir, {});
+
+    for (auto order : { READ_ORDER::Inode, READ_ORDER::Extent })
+    {
+        auto actual = expected;
+        ReadOrder::Sort(actual, order, 2, true);
+
+        std::sort(actual.begin(), actual.end());
+        auto sorted_expected = expected;
+        std::sort(sorted_expected.begin(), sorted_expected.end());
+
+        REQUIRE(actual == sorted_expected);
+    }
+}
+
+TEST_CASE("Read order none leaves the files alone")
+{
+    std::vector<std::filesystem::path> paths{ "b.cpp", "a.cpp" };
+    auto original = paths;
+
+    REQUIRE_FALSE(ReadOrder::Sort(paths, READ_ORDER::None, 1, true));
+    REQUIRE(paths == original);
+}
+
+#ifdef __linux__
+TEST_CASE("Inode read order sorts the files by device and inode")
+{
+    DirectoryScanner scanner;
+    auto paths = scanner.Scan(std::string(TEST_DATA_DIR), {});
+    REQUIRE(paths.size() > 2);
+
+    REQUIRE(ReadOrder::Sort(paths, READ_ORDER::Inode, 3, true));
+
+    for (size_t i = 1; i < paths.size(); ++i)
+    {
+        REQUIRE(InodeKey(paths[i - 1]) <= InodeKey(paths[i]));
+    }
+}
+
+TEST_CASE("Read order asks about the storage once for each device")
+{
+    DirectoryScanner scanner;
+    auto paths = scanner.Scan(std::string(TEST_DATA_DIR), {});
+
+    std::vector<dev_t> devices{};
+    for (const auto& path : paths) devices.push_back(InodeKey(path).first);
+    std::sort(devices.begin(), devices.end());
+    devices.erase(std::unique(devices.begin(), devices.end()), devices.end());
+
+    size_t asked = 0;
+    auto ordered = ReadOrder::OrderWhere(paths, READ_ORDER::Inode, 2, [&](const std::filesystem::path&) { ++asked; return false; });
+
+    REQUIRE(asked == devices.size());
+    REQUIRE(ordered.empty());
+}
+
+TEST_CASE("Read order only reorders the files on storage that benefits")
+{
+    auto ssd = std::filesystem::temp_directory_path() / "loc_test_read_order";
+    auto disk = std::filesystem::path("/dev/shm/loc_test_read_order");
+    std::error_code ec;
+    std::filesystem::create_directories(disk, ec);
+    if (ec) SKIP("there's no /dev/shm to test with");
+
+    auto ssd_files = MakeFiles(ssd, 8);
+    auto disk_files = MakeFiles(disk, 8);
+    if (InodeKey(ssd_files.front()).first == InodeKey(disk_files.front()).first)
+    {
+        std::filesystem::remove_all(ssd);
+        std::filesystem::remove_all(disk);
+        SKIP("the temporary directory and /dev/shm are on the same device");
+    }
+
+    // interleave them, with the files on the disk in reverse inode order
+    std::sort(disk_files.begin(), disk_files.end(), [](const auto& a, const auto& b) { return InodeKey(a) > InodeKey(b); });
+    std::vector<std::filesystem::path> paths{};
+    for (size_t i = 0; i < ssd_files.size(); ++i)
+    {
+        paths.push_back(disk_files[i]);
+        paths.push_back(ssd_files[i]);
+    }
+
+    auto disk_device = InodeKey(disk_files.front()).first;
+    auto ordered = ReadOrder::OrderWhere(paths, READ_ORDER::Inode, 2,
+        [&](const std::filesystem::path& path) { return InodeKey(path).first == disk_device; });
+    REQUIRE(ordered.size() == paths.size());
+
+    std::vector<std::filesystem::path> ssd_order{};
+    std::vector<std::filesystem::path> disk_order{};
+    for (auto index : ordered)
+    {
+        (InodeKey(paths[index]).first == disk_device ? disk_order : ssd_order).push_back(paths[index]);
+    }
+
+    REQUIRE(ssd_order == ssd_files);
+    REQUIRE(std::is_sorted(disk_order.begin(), disk_order.end(), [](const auto& a, const auto& b) { return InodeKey(a) < InodeKey(b); }));
+
+    std::filesystem::remove_all(ssd);
+    std::filesystem::remove_all(disk);
+}
+#endif
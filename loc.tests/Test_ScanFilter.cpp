@@ -0,0 +1,69 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "ScanFilter.h"
+
+TEST_CASE("ScanFilter parses sizes")
+{
+    REQUIRE(ScanFilter::ParseSize("4096") == 4096u);
+    REQUIRE(ScanFilter::ParseSize("100K") == 100u * 1024);
+    REQUIRE(ScanFilter::ParseSize("10m") == 10u * 1024 * 1024);
+    REQUIRE(ScanFilter::ParseSize("2G") == uintmax_t{ 2 } << 30);
+    REQUIRE(ScanFilter::ParseSize("1t") == uintmax_t{ 1 } << 40);
+    REQUIRE(ScanFilter::ParseSize("0") == 0u);
+
+    REQUIRE(!ScanFilter::ParseSize(""));
+    REQUIRE(!ScanFilter::ParseSize("K"));
+    REQUIRE(!ScanFilter::ParseSize("1.5M"));
+    REQUIRE(!ScanFilter::ParseSize("-1"));
+    REQUIRE(!ScanFilter::ParseSize("10MB"));
+    REQUIRE(!ScanFilter::ParseSize("99999999999999999999T"));
+}
+
+TEST_CASE("ScanFilter parses ages and dates")
+{
+    constexpr int64_t now = 1'700'000'000;
+    REQUIRE(ScanFilter::ParseTime("90s", now) == now - 90);
+    REQUIRE(ScanFilter::ParseTime("30m", now) == now - 30 * 60);
+    REQUIRE(ScanFilter::ParseTime("12h", now) == now - 12 * 60 * 60);
+    REQUIRE(ScanFilter::ParseTime("7d", now) == now - 7 * 24 * 60 * 60);
+    REQUIRE(ScanFilter::ParseTime("2w", now) == now - 14 * 24 * 60 * 60);
+
+    // dates are midnight UTC, whatever now is
+    REQUIRE(ScanFilter::ParseTime("1970-01-02", now) == 24 * 60 * 60);
+    REQUIRE(ScanFilter::ParseTime("2024-02-29", now) == 1'709'164'800);
+
+    REQUIRE(!ScanFilter::ParseTime("", now));
+    REQUIRE(!ScanFilter::ParseTime("7", now));
+    REQUIRE(!ScanFilter::ParseTime("d", now));
+    REQUIRE(!ScanFilter::ParseTime("-7d", now));
+    REQUIRE(!ScanFilter::ParseTime("7y", now));
+    REQUIRE(!ScanFilter::ParseTime("2023-02-29", now));
+    REQUIRE(!ScanFilter::ParseTime("2024-13-01", now));
+    REQUIRE(!ScanFilter::ParseTime("2024/01/01", now));
+}
+
+TEST_CASE("ScanFilter admits files within its limits")
+{
+    ScanFilter unlimited{};
+    REQUIRE(!unlimited.NeedsMetadata());
+    REQUIRE(unlimited.Admits(0, 0));
+    REQUIRE(unlimited.Admits(UINTMAX_MAX, INT64_MAX - 1));
+
+    // depth alone is known from the walk
+    ScanFilter shallow{};
+    shallow.max_depth = 1;
+    REQUIRE(!shallow.NeedsMetadata());
+
+    ScanFilter filter{};
+    filter.min_size = 10;
+    filter.max_size = 100;
+    filter.newer_than = 1000;
+    filter.older_than = 2000;
+    REQUIRE(filter.NeedsMetadata());
+    REQUIRE(filter.Admits(10, 1000));
+    REQUIRE(filter.Admits(100, 1999));
+    REQUIRE(!filter.Admits(9, 1500));
+    REQUIRE(!filter.Admits(101, 1500));
+    REQUIRE(!filter.Admits(50, 999));
+    REQUIRE(!filter.Admits(50, 2000));
+}
@@ -0,0 +1,112 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "Counter.h"
+#include "Snapshot.h"
+
+namespace
+{
+    void WriteFile(const std::filesystem::path& path, const std::string& text)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file{ path, std::ios::binary };
+        file << text;
+    }
+
+    bool SaveSnapshot(const std::filesystem::path& directory, const std::filesystem::path& snapshot)
+    {
+        CounterOptions options{};
+        options.snapshot = true;
+        Counter counter(2, { directory }, {}, false, {}, options);
+        counter.Count();
+        return counter.GetTree() == nullptr && counter.SaveSnapshot(snapshot);
+    }
+}
+
+TEST_CASE("Snapshot keeps the counts of every file")
+{
+    auto saved = std::filesystem::temp_directory_path() / "loc_test_snapshot.snap";
+    REQUIRE(SaveSnapshot(std::string(TEST_DATA_DIR), saved));
+
+    Snapshot snapshot{};
+    REQUIRE(snapshot.Load(saved));
+    REQUIRE(snapshot.DirectoryCount() >= 2);
+    REQUIRE(snapshot.Directory(0) == "");
+    REQUIRE(snapshot.Directory(1) == "syntax");
+
+    bool found = false;
+    for (size_t i = 0; i < snapshot.FileCount(); ++i)
+    {
+        auto file = snapshot.GetFile(i);
+        if (file.name != "cpp_file.cpp") continue;
+        found = true;
+        REQUIRE(file.directory == 0);
+        REQUIRE(file.language == FILE_LANGUAGE::Cpp);
+        REQUIRE(file.size == std::filesystem::file_size(std::string(TEST_DATA_DIR) + "/cpp_file.cpp"));
+        REQUIRE(file.modified > 0);
+    }
+    REQUIRE(found);
+
+    // nothing changes between a snapshot and itself
+    auto delta = Snapshot::Compare(snapshot, snapshot, 10);
+    REQUIRE(delta.languages.empty());
+    REQUIRE(delta.directories.empty());
+
+    std::filesystem::remove(saved);
+}
+
+TEST_CASE("Snapshots of trees in different places compare file by file")
+{
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_snapshot";
+    std::filesystem::remove_all(dir);
+    auto old_tree = dir / "old";
+    auto new_tree = dir / "checkout";
+
+    WriteFile(old_tree / "a.cpp", "int a;\nint b;\n");
+    WriteFile(old_tree / "src" / "b.py", "x = 1\n");
+    WriteFile(old_tree / "src" / "deep" / "c.cpp", "int c;\n");
+
+    WriteFile(new_tree / "a.cpp", "int a;\nint b;\n// c\nint c;\n");
+    WriteFile(new_tree / "src" / "d.py", "y = 1\nz = 2\n");
+    WriteFile(new_tree / "src" / "deep" / "c.cpp", "int c;\n");
+
+    REQUIRE(SaveSnapshot(old_tree, dir / "old.snap"));
+    REQUIRE(SaveSnapshot(new_tree, dir / "new.snap"));
+
+    Snapshot before{};
+    Snapshot after{};
+    REQUIRE(before.Load(dir / "old.snap"));
+    REQUIRE(after.Load(dir / "new.snap"));
+
+    auto delta = Snapshot::Compare(before, after, 1);
+    REQUIRE(delta.languages[FILE_LANGUAGE::Cpp].code == 1);
+    REQUIRE(delta.languages[FILE_LANGUAGE::Cpp].comment == 1);
+    REQUIRE(delta.languages[FILE_LANGUAGE::Cpp].files == 1);
+    REQUIRE(delta.languages[FILE_LANGUAGE::Python].code == 1);
+    REQUIRE(delta.languages[FILE_LANGUAGE::Python].files == 2);
+
+    // the unchanged src/deep is neither listed nor below the depth
+    REQUIRE(delta.directories.size() == 2);
+    REQUIRE(delta.directories[""].code == 2);
+    REQUIRE(delta.directories[""].files == 3);
+    REQUIRE(delta.directories["src"].code == 1);
+    REQUIRE(delta.directories["src"].files == 2);
+
+    REQUIRE(Snapshot::Compare(before, after, 0).directories.size() == 1);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Snapshot rejects files that aren't snapshots")
+{
+    auto bad = std::filesystem::temp_directory_path() / "loc_test_bad_snapshot.snap";
+    WriteFile(bad, "loc-partial 1\nC++\t1\t2\t3\t4\t9\n");
+
+    Snapshot snapshot{};
+    REQUIRE_FALSE(snapshot.Load(bad));
+    REQUIRE_FALSE(snapshot.Load(bad.string() + ".missing"));
+
+    std::filesystem::remove(bad);
+}
@@ -0,0 +1,68 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "Counter.h"
+#include "Sniffer.h"
+
+TEST_CASE("Sniffing recognises source")
+{
+    REQUIRE(Sniffer::Sniff("int main()\n{\n    return 0;\n}\n") == FILE_KIND::Source);
+    REQUIRE(Sniffer::Sniff("") == FILE_KIND::Source);
+
+    // markers past the sniffed bytes aren't seen
+    std::string late = std::string(Sniffer::sniff_size, '\n') + "// DO NOT EDIT\n";
+    REQUIRE(Sniffer::Sniff(late) == FILE_KIND::Source);
+
+    // markers in the code rather than in the leading comments
+    REQUIRE(Sniffer::Sniff("package gen\n\nconst header = \"// Code generated. DO NOT EDIT.\"\n") == FILE_KIND::Source);
+    REQUIRE(Sniffer::Sniff("// Copyright 2024\n\nint x;\n// DO NOT EDIT this constant\nint y = 1;\n") == FILE_KIND::Source);
+    REQUIRE(Sniffer::Sniff("def is_generated(text):\n    return '@generated' in text\n") == FILE_KIND::Source);
+
+    // a single long line among hand-written ones
+    std::string table = "#include <cstdint>\n\n// the table\nconst uint8_t table[] = {" + std::string(1500, '1') + "};\n";
+    for (int i = 0; i < 40; ++i) table += "int f" + std::to_string(i) + "() { return table[" + std::to_string(i) + "]; }\n";
+    REQUIRE(Sniffer::Sniff(table) == FILE_KIND::Source);
+}
+
+TEST_CASE("Sniffing recognises binary, minified and generated files")
+{
+    REQUIRE(Sniffer::Sniff(std::string("MZ\x90\0\x03", 5)) == FILE_KIND::Binary);
+    REQUIRE(Sniffer::Sniff("var a=1;" + std::string(2000, 'x')) == FILE_KIND::Minified);
+    REQUIRE(Sniffer::Sniff("// Code generated by protoc-gen-go. DO NOT EDIT.\npackage pb\n") == FILE_KIND::Generated);
+    REQUIRE(Sniffer::Sniff("/* @generated */\nint x;\n") == FILE_KIND::Generated);
+    REQUIRE(Sniffer::Sniff("// <auto-generated>\nclass A {}\n") == FILE_KIND::Generated);
+
+    // the marker may come after other comments and inside a block comment
+    REQUIRE(Sniffer::Sniff("#!/usr/bin/env python3\n# -*- coding: utf-8 -*-\n\n# @generated by tool\nx = 1\n") == FILE_KIND::Generated);
+    REQUIRE(Sniffer::Sniff("/*\n * Copyright 2024\n *\n   DO NOT EDIT\n */\nint x;\n") == FILE_KIND::Generated);
+    REQUIRE(Sniffer::Sniff("<!--\n  <auto-generated>\n-->\n<Project />\n") == FILE_KIND::Generated);
+
+    // a licence comment before a minified bundle
+    REQUIRE(Sniffer::Sniff("/*! lib v1.0 | MIT */\n" + std::string(3000, 'x') + "\n") == FILE_KIND::Minified);
+}
+
+TEST_CASE("Counter skips unusual files unless asked to count them")
+{
+    auto dir = std::filesystem::temp_directory_path() / "loc_test_sniffer";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::ofstream{ dir / "main.js" } << "let a = 1;\nlet b = 2;\n";
+    std::ofstream{ dir / "bundle.min.js" } << "let a=1;" << std::string(5000, 'a') << "\n";
+    std::ofstream{ dir / "schema.pb.go" } << "// Code generated by protoc. DO NOT EDIT.\npackage pb\n";
+
+    Counter skipping(1, { dir }, {}, false, {});
+    REQUIRE(skipping.Count() == 2);
+    REQUIRE(skipping.GetSkippedCount(FILE_KIND::Minified) == 1);
+    REQUIRE(skipping.GetSkippedCount(FILE_KIND::Generated) == 1);
+    REQUIRE(skipping.GetLanguageCounts().count(FILE_LANGUAGE::Go) == 0);
+
+    CounterOptions options{};
+    options.include_unusual = true;
+    Counter counting(1, { dir }, {}, false, {}, options);
+    REQUIRE(counting.Count() == 4);
+    REQUIRE(counting.GetSkippedCount(FILE_KIND::Minified) == 0);
+
+    std::filesystem::remove_all(dir);
+}
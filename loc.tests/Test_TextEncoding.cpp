@@ -0,0 +1,104 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "LineCounter.h"
+#include "TextEncoding.h"
+
+namespace
+{
+    // ASCII text in 2 or 4 byte code units
+    std::string Widen(const std::string& text, size_t unit_size, bool big_endian)
+    {
+        std::string wide{};
+        for (char c : text)
+        {
+            std::string unit(unit_size, '\0');
+            unit[big_endian ? unit_size - 1 : 0] = c;
+            wide += unit;
+        }
+        return wide;
+    }
+
+    LineCounts CountFile(const std::string& bytes, FILE_LANGUAGE language)
+    {
+        auto path = std::filesystem::temp_directory_path() / "loc_test_encoding.txt";
+        std::ofstream{ path, std::ios::binary } << bytes;
+
+        LineCounter counter{ true };
+        auto counts = counter.CountLines(path, language);
+        REQUIRE(counter.LastKind() == FILE_KIND::Source);
+
+        std::filesystem::remove(path);
+        return counts;
+    }
+
+    const std::string cs_source =
+        "// comment\n"
+        "using System;\n"
+        "\n"
+        "/* block\n"
+        "   comment */\n"
+        "class A { string s = \"// not a comment\"; }\n";
+}
+
+TEST_CASE("Encodings are detected from the byte order mark")
+{
+    size_t bom = 0;
+    REQUIRE(TextEncoding::Detect("\xEF\xBB\xBFint x;", bom) == TEXT_ENCODING::Utf8);
+    REQUIRE(bom == 3);
+    REQUIRE(TextEncoding::Detect(std::string("\xFF\xFE" "a\0", 4), bom) == TEXT_ENCODING::Utf16LE);
+    REQUIRE(bom == 2);
+    REQUIRE(TextEncoding::Detect(std::string("\xFE\xFF\0a", 4), bom) == TEXT_ENCODING::Utf16BE);
+    REQUIRE(TextEncoding::Detect(std::string("\xFF\xFE\0\0a\0\0\0", 8), bom) == TEXT_ENCODING::Utf32LE);
+    REQUIRE(bom == 4);
+    REQUIRE(TextEncoding::Detect(std::string("\0\0\xFE\xFF", 4), bom) == TEXT_ENCODING::Utf32BE);
+}
+
+TEST_CASE("Encodings are detected without a byte order mark")
+{
+    size_t bom = 0;
+    REQUIRE(TextEncoding::Detect("int main() { return 0; }\n", bom) == TEXT_ENCODING::Utf8);
+    REQUIRE(bom == 0);
+    REQUIRE(TextEncoding::Detect(Widen(cs_source, 2, false), bom) == TEXT_ENCODING::Utf16LE);
+    REQUIRE(TextEncoding::Detect(Widen(cs_source, 2, true), bom) == TEXT_ENCODING::Utf16BE);
+    REQUIRE(TextEncoding::Detect(Widen(cs_source, 4, false), bom) == TEXT_ENCODING::Utf32LE);
+    REQUIRE(TextEncoding::Detect(Widen(cs_source, 4, true), bom) == TEXT_ENCODING::Utf32BE);
+}
+
+TEST_CASE("Wide files count the same as UTF-8")
+{
+    LineCounter counter;
+    auto expected = counter.CountText(cs_source, FILE_LANGUAGE::CS);
+    REQUIRE(expected.code == 2);
+    REQUIRE(expected.comment == 3);
+
+    auto check = [&](const std::string& bytes) {
+        auto counts = CountFile(bytes, FILE_LANGUAGE::CS);
+        REQUIRE(counts.code == expected.code);
+        REQUIRE(counts.comment == expected.comment);
+        REQUIRE(counts.blank == expected.blank);
+        REQUIRE(counts.total == expected.total);
+    };
+
+    check("\xEF\xBB\xBF" + cs_source);
+    check("\xFF\xFE" + Widen(cs_source, 2, false));
+    check("\xFE\xFF" + Widen(cs_source, 2, true));
+    check(Widen(cs_source, 2, false));
+    check(std::string("\xFF\xFE\0\0", 4) + Widen(cs_source, 4, false));
+    check(std::string("\0\0\xFE\xFF", 4) + Widen(cs_source, 4, true));
+}
+
+TEST_CASE("Wide files are lexed across blocks")
+{
+    // a block comment that straddles the first 64 KB block boundary
+    std::string source = std::string(40000, '\n') + "/*\n" + std::string(10000, '\n') + "*/\nint x;\n";
+    LineCounter counter;
+    auto expected = counter.CountText(source, FILE_LANGUAGE::Cpp);
+
+    auto counts = CountFile("\xFF\xFE" + Widen(source, 2, false), FILE_LANGUAGE::Cpp);
+    REQUIRE(counts.code == expected.code);
+    REQUIRE(counts.comment == expected.comment);
+    REQUIRE(counts.blank == expected.blank);
+}
@@ -0,0 +1,53 @@
+#include <catch2/catch_test_macros.hpp>
+#include <set>
+#include <vector>
+
+#include "Topology.h"
+
+TEST_CASE("Topology parses sysfs CPU lists")
+{
+    REQUIRE(Topology::ParseCpuList("0-3,8,10-11\n") == std::vector<unsigned int>{ 0, 1, 2, 3, 8, 10, 11 });
+    REQUIRE(Topology::ParseCpuList("5") == std::vector<unsigned int>{ 5 });
+    REQUIRE(Topology::ParseCpuList("").empty());
+    REQUIRE(Topology::ParseCpuList("\n").empty());
+
+    // ranges that can't be read are skipped
+    REQUIRE(Topology::ParseCpuList("x,2,4-3,6-7") == std::vector<unsigned int>{ 2, 6, 7 });
+}
+
+TEST_CASE("Topology deals workers out over nodes and CPUs")
+{
+    Topology topology{ { { 0, { 0, 1, 2, 3 } }, { 1, {} }, { 2, { 4, 5 } } } };
+
+    // the node without CPUs is left out
+    REQUIRE(topology.Nodes().size() == 2);
+    REQUIRE(topology.Nodes()[1].id == 2);
+
+    std::vector<unsigned int> per_node(2);
+    std::set<unsigned int> cpus{};
+    for (unsigned int worker = 0; worker < 6; ++worker)
+    {
+        auto placement = topology.Place(worker);
+        per_node[placement.node]++;
+        cpus.insert(placement.cpu);
+
+        // neighbouring workers are on different nodes
+        REQUIRE(placement.node == worker % 2);
+    }
+    REQUIRE(per_node == std::vector<unsigned int>{ 3, 3 });
+    REQUIRE(cpus.size() == 5);
+
+    // more workers than CPUs wrap around the node's CPUs
+    REQUIRE(topology.Place(5).cpu == 4);
+}
+
+TEST_CASE("Topology always has a node to place workers on")
+{
+    auto detected = Topology::Detect();
+    REQUIRE_FALSE(detected.Nodes().empty());
+    for (const auto& node : detected.Nodes()) REQUIRE_FALSE(node.cpus.empty());
+
+    Topology empty{ {} };
+    REQUIRE(empty.Nodes().size() == 1);
+    REQUIRE(empty.Place(3).cpu == 0);
+}
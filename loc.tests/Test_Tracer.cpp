@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "Counter.h"
+#include "Tracer.h"
+
+TEST_CASE("Trace has a named track per thread with its spans")
+{
+    Tracer tracer{};
+    tracer.NameThread("main");
+    {
+        std::filesystem::path path{ "dir/a \"quoted\".cpp" };
+        TraceSpan outer{ &tracer, "file", "file", &path };
+        TraceSpan inner{ &tracer, "read", "io" };
+    }
+    std::jthread([&tracer] {
+        tracer.NameThread("worker 0");
+        TraceSpan span{ &tracer, "lex", "classify" };
+    }).join();
+
+    std::ostringstream out;
+    tracer.Write(out);
+    auto json = out.str();
+
+    REQUIRE(json.starts_with("{\"traceEvents\":["));
+    REQUIRE(json.find("\"tid\":1,\"args\":{\"name\":\"main\"}") != std::string::npos);
+    REQUIRE(json.find("\"tid\":2,\"args\":{\"name\":\"worker 0\"}") != std::string::npos);
+    REQUIRE(json.find("{\"name\":\"read\",\"cat\":\"io\",\"ph\":\"X\",\"pid\":1,\"tid\":1,") != std::string::npos);
+    REQUIRE(json.find("{\"name\":\"lex\",\"cat\":\"classify\",\"ph\":\"X\",\"pid\":1,\"tid\":2,") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"path\":\"dir/a \\\"quoted\\\".cpp\"}") != std::string::npos);
+    REQUIRE(json.find("\"dropped_events\":0") != std::string::npos);
+
+    // the inner span ends first, so it is recorded first
+    REQUIRE(json.find("\"name\":\"read\"") < json.find("\"name\":\"file\""));
+}
+
+TEST_CASE("Trace keeps the most recent events when a thread's buffer is full")
+{
+    const char* names[]{ "e0", "e1", "e2", "e3", "e4", "e5", "e6", "e7", "e8", "e9" };
+    Tracer tracer{ 4 };
+    for (const char* name : names)
+    {
+        TraceSpan span{ &tracer, name, "test" };
+    }
+
+    REQUIRE(tracer.Dropped() == 6);
+
+    std::ostringstream out;
+    tracer.Write(out);
+    auto json = out.str();
+    REQUIRE(json.find("\"e5\"") == std::string::npos);
+    REQUIRE(json.find("\"e6\"") < json.find("\"e7\""));
+    REQUIRE(json.find("\"e7\"") < json.find("\"e8\""));
+    REQUIRE(json.find("\"e8\"") < json.find("\"e9\""));
+    REQUIRE(json.find("\"dropped_events\":6") != std::string::npos);
+}
+
+TEST_CASE("Tracing a count records the scan and the workers without changing the counts")
+{
+    auto test_dir = std::string(TEST_DATA_DIR);
+    auto trace_path = std::filesystem::temp_directory_path() / "loc_test_trace.json";
+
+    Counter plain(2, { test_dir }, {}, false, {});
+    auto expected = plain.Count();
+
+    CounterOptions options{};
+    options.trace = trace_path;
+    Counter traced(2, { test_dir }, {}, false, {}, options);
+    REQUIRE(traced.Count() == expected);
+
+    std::ifstream file{ trace_path };
+    std::string json{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    file.close();
+    std::filesystem::remove(trace_path);
+
+    for (const char* name : { "\"scan\"", "\"directory\"", "\"wait for workers\"", "\"file\"", "\"open\"", "\"read\"", "\"lex\"", "\"merge\"", "\"worker 0\"" })
+    {
+        INFO(name);
+        REQUIRE(json.find(name) != std::string::npos);
+    }
+}
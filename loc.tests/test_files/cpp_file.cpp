@@ -20,6 +20,6 @@ int main()
     return 0;
 }
 
-// This file should have 8 lines of code
+// This file should have 9 lines of code
 
 // */
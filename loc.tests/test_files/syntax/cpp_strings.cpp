@@ -0,0 +1,14 @@
+// Strings and character literals that contain comment markers
+
+char quote = '"';
+char slash = '/';
+const char* a = "/* not a comment";
+const char* b = R"(raw "string" with // and /* inside)";
+const char* c = R"delim(
+/* still inside the raw string
+)" not the end yet
+)delim";
+int x = 1; // trailing comment
+/* a real
+   comment */
+const char* d = "escaped \" quote /* still a string";
@@ -0,0 +1,5 @@
+// C# verbatim strings double their quotes
+
+var path = @"C:\dir\"" // still in the string
+/* still */";
+var c = '"'; // char
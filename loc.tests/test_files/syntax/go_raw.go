@@ -0,0 +1,10 @@
+// Go raw strings use backticks
+
+package main
+
+var usage = `usage:
+  // this is help text, not a comment
+  /* neither is this */
+`
+
+func main() {} // trailing
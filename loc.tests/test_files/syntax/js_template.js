@@ -0,0 +1,11 @@
+// Template literals may span lines
+
+const html = `
+  <div>
+    // not a comment
+  </div>
+`;
+const re = "a \" /* b";
+/* a
+ * comment */
+let s = 'x'; // done
@@ -0,0 +1,12 @@
+# Triple quoted strings span lines
+
+def f():
+    """Docstring with a # hash
+    and a second line
+    """
+    s = '#not a comment'
+    t = "it's # fine"
+    u = '''
+# inside a string
+'''
+    return s + t  # trailing comment
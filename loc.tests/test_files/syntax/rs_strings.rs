@@ -0,0 +1,9 @@
+// Rust raw strings, char literals and lifetimes
+
+fn longest<'a>(x: &'a str) -> &'a str {
+    let quote = '"';
+    let raw = r#"a "raw" string with // inside"#;
+    let multi = "first line
+// second line of the string";
+    /* block */ x
+}
@@ -3,14 +3,131 @@
 #include <vector>
 #include <string>
 #include <thread>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <system_error>
 
 #include "DirectoryScanner.h"
+#include "DirectoryTree.h"
+#include "Estimator.h"
 #include "ExpandGlob.h"
+#include "LanguageRegistry.h"
 #include "LineCounter.h"
+#include "PathQueue.h"
+#include "Prefetcher.h"
+#include "ProgressReporter.h"
+#include "ReadOrder.h"
+#include "ScanFilter.h"
+#include "Snapshot.h"
+#include "Topology.h"
+#include "Tracer.h"
+
+// Totals for all the files of one language
+struct LanguageTotals
+{
+	LineCounts lines{};
+	unsigned int files{};
+};
+
+// Files skipped because they are binary, minified or generated, indexed by FILE_KIND
+using SkippedCounts = std::array<unsigned int, 4>;
+
+// What one worker did during a counting run, for --stats
+struct WorkerStats
+{
+	int node{ -1 };		// NUMA node the worker was pinned to, or -1 when it wasn't
+	int cpu{ -1 };
+	unsigned int files{};
+	unsigned int stolen{};	// files taken from another node's share
+	uint64_t bytes{};
+	std::chrono::nanoseconds busy{};
+};
+
+// A file that couldn't be opened or read, and counted as empty
+struct FileError
+{
+	std::filesystem::path path{};
+	std::error_code error{};
+};
+
+// Optional behaviour of a counting run
+struct CounterOptions
+{
+	// Only count the files of shard shard_index (1 based) out of shard_count
+	unsigned int shard_index{ 1 };
+	unsigned int shard_count{ 1 };
+
+	// Sort the files into on-disk order before counting (rotational and network storage only, unless forced)
+	READ_ORDER read_order{ READ_ORDER::None };
+	bool force_read_order{ false };
+
+	// Ask the kernel to read files into the page cache ahead of the workers (Linux only).
+	// prefetch_window caps how far ahead; 0 lets it size itself from the measured read latency.
+	bool prefetch{ false };
+	size_t prefetch_window{ 0 };
+
+	// Count a stratified random sample of the files and extrapolate the totals. Sampling stops once the
+	// 95% confidence interval of the code lines is within estimate_precision of the estimate, or when
+	// time_budget (if not zero, which also turns estimating on) runs out. Sampling every file is exact.
+	bool estimate{ false };
+	double estimate_precision{ 0.01 };
+	std::chrono::milliseconds time_budget{ 0 };
+	uint64_t estimate_seed{ 0 };
+
+	// Report progress on stderr while counting
+	PROGRESS_FORMAT progress{ PROGRESS_FORMAT::None };
+	std::chrono::milliseconds progress_interval{ 1000 };
+
+	// Also count the files listed in this file ("-" for stdin), one per line or NUL separated.
+	// The list is streamed to the workers as it is read; the files aren't checked for overlaps,
+	// and read ordering, prefetching and estimating don't apply to them.
+	std::filesystem::path files_from{};
+	bool null_separated{ false };
+
+	// Count binary, minified and generated files instead of skipping them
+	bool include_unusual{ false };
+
+	// Only count physical lines: every line that isn't blank is code, comments included. Much faster,
+	// for when only the size of a code base matters.
+	bool fast{ false };
+
+	// Also total the lines of every directory, for GetTree(). Not with files_from or estimating.
+	bool tree{ false };
+
+	// Also total the lines of every project, a directory with a build or package manifest, for GetProjects().
+	// Not with files_from or estimating.
+	bool by_project{ false };
+
+	// Keep the counts, size and modification time of every file, for SaveSnapshot(). Not with files_from or estimating.
+	bool snapshot{ false };
+
+	// Count the Markdown files found when scanning or in the list, with their fenced code as the language
+	// it is tagged with. Markdown is mostly prose, so it is left out unless asked for; files given directly are counted.
+	bool markdown{ false };
+
+	// Record a timeline of the scan and of every worker, written here as Chrome trace-event JSON
+	std::filesystem::path trace{};
+
+	// Pin each worker to a CPU, dealing them out over the NUMA nodes, and give each node its own share
+	// of the files; a node's workers only take files from another node once their own share is done.
+	// With prefetching or estimating the workers are pinned but share one queue, which the order matters for.
+	bool pin{ false };
+
+	// Only count the files found by scanning directories that are within these limits of size, age and depth.
+	// The files and directories left out are never opened.
+	ScanFilter filter{};
+
+	// Keep the directory listings of the scan in this file, and only read again the directories
+	// that changed since the last run (Linux only; elsewhere the file is written but never used)
+	std::filesystem::path dir_cache{};
+};
 
 class Counter
 {
@@ -20,45 +137,123 @@ public:
 
 	Counter(unsigned int jobs, const std::vector<std::filesystem::path>& directoryPaths,
 		const std::vector<std::filesystem::path>& filePaths,
-		bool includeGenerated, const std::vector<std::filesystem::path>& ignoreDirs);
+		bool includeGenerated, const std::vector<std::filesystem::path>& ignoreDirs,
+		const CounterOptions& options = {});
 
 	unsigned long Count();
 
+	// True when Count() couldn't read all of its input, such as a --files-from list that can't be opened.
+	// The counts are then incomplete and shouldn't be reported or saved.
+	bool Failed() const;
+
 	void PrintLanguageBreakdown() const;
+	static void PrintLanguageBreakdown(const std::map<FILE_LANGUAGE, LanguageTotals>& counts);
+
+	// When the result is an estimate these are the totals of the files that were sampled
+	const std::map<FILE_LANGUAGE, LanguageTotals>& GetLanguageCounts() const;
+
+	// Number of files skipped because they are binary, minified or generated
+	unsigned int GetSkippedCount(FILE_KIND kind) const;
+	SkippedCounts GetSkippedCounts() const;
+
+	// One line listing the skipped files, if there were any
+	void PrintSkipped() const;
+	static void PrintSkipped(const SkippedCounts& skipped);
+
+	// True when Count() stopped sampling before every file was counted
+	bool Estimated() const;
+
+	// The sampling estimate, or null when the result is exact
+	const Estimator* GetEstimator() const;
+
+	// Lines per directory when options.tree is set, otherwise null
+	const DirectoryTree* GetTree() const;
+
+	// Lines per project when options.by_project is set, largest first
+	const std::vector<DirectoryTree::Project>& GetProjects() const;
+
+	// Writes the files counted to a snapshot, when options.snapshot is set. Prints an error and returns false if it can't.
+	bool SaveSnapshot(const std::filesystem::path& path);
+
+	// What the workers did, one entry per worker
+	const std::vector<WorkerStats>& GetWorkerStats() const;
+
+	// The files, bytes and throughput of the workers of each NUMA node, or of all of them when they weren't pinned
+	void PrintStats() const;
+
+	// The files that couldn't be opened or read, by path. They are also printed when counting ends.
+	const std::vector<FileError>& GetFileErrors() const;
+
+	static void PrintEstimateBreakdown(const std::map<FILE_LANGUAGE, LanguageEstimate>& estimates);
+
+	// Shard (1 based) that a file belongs to. key is the path relative to the directory that was scanned.
+	static unsigned int ShardOf(const std::filesystem::path& key, unsigned int shard_count);
 
 
 private:
 
-	enum class FILE_LANGUAGE
+	// What each worker owns. Its line counter's buffers are reused from file to file, and are first
+	// touched on the worker's thread so they are on its node. Its totals and the files it couldn't read
+	// are merged once the workers are done, so workers share no lock, counter or stream while they count;
+	// aligned so they share no cache line.
+	struct alignas(64) Worker
+	{
+		unsigned int node{};	// index into topology's nodes
+		LineCounter counter{};
+		WorkerProgress* published{};
+		DirectoryTree::Partial* directories{};
+		std::vector<Snapshot::Entry>* files{};
+		std::array<LanguageTotals, LanguageRegistry::language_count> languages{};
+		unsigned long code{};
+		WorkerStats stats{};
+		std::vector<FileError> errors{};
+	};
+
+	// With options.pin, each node's share of paths: its workers take batches from next up to end
+	struct alignas(64) NodeQueue
 	{
-		C,
-		CHeader,
-		Cpp,
-		CS,
-		Go,
-		Html,
-		Java,
-		JavaScript,
-		TypeScript,
-		Kotlin,
-		Ruby,
-		Rust,
-		Shell,
-		PowerShell,
-		Python,
-		FSharp,
-		Xaml,
-		Xml,
-		Other
+		std::atomic<size_t> next{};
+		size_t end{};
 	};
 
 	unsigned int jobs{};
+	CounterOptions options{};
 	std::vector<std::filesystem::path> paths{};
+	std::vector<FILE_LANGUAGE> languages{};	// of each path, as the scan found it so no file is read again to tell
+	std::vector<uint32_t> directories{};	// of each path in tree, only with options.tree, by_project or snapshot
 	std::atomic<unsigned long> total_lines{};
 	std::atomic<size_t> next_index = 0;
+	bool failed{};
+
+	std::vector<Worker> workers{};
+	std::vector<WorkerStats> worker_stats{};
+	std::vector<FileError> file_errors{};
+	std::optional<Topology> topology{};
+	std::vector<NodeQueue> node_queues{};
+	std::array<std::atomic<unsigned int>, 4> skipped{};
+
+	// sampling state, only used when estimating
+	std::vector<uintmax_t> sizes{};
+	std::unique_ptr<Estimator> estimator{};
+	std::atomic<bool> stop_sampling{ false };
+
+	// only set while Count() is running with prefetching or progress reporting enabled
+	Prefetcher* prefetcher{};
+	ProgressReporter* progress{};
+
+	// only set when tracing, from construction so the scan is included
+	std::unique_ptr<Tracer> tracer{};
+
+	// only set with options.tree, options.by_project or options.snapshot; each worker records into its own partial and list of files
+	std::unique_ptr<DirectoryTree> tree{};
+	std::vector<DirectoryTree::Partial> tree_partials{};
+	std::vector<std::vector<Snapshot::Entry>> snapshot_files{};
+
+	// only with options.by_project: the directories the scan found manifests in, and the totals of each
+	std::vector<std::filesystem::path> project_markers{};
+	std::vector<DirectoryTree::Project> projects{};
 
-	std::mutex language_line_counts_mutex{};
-	std::map<FILE_LANGUAGE, std::pair<unsigned int, unsigned int>> language_line_counts{};
+	std::map<FILE_LANGUAGE, LanguageTotals> language_line_counts{};
 
 	// struct for printing out large numbers with commas
 	struct comma_numpunct : std::numpunct<char>
@@ -69,10 +264,28 @@ private:
 	};
 
 	bool IsDirectory(const std::filesystem::path& path) const;
-	unsigned long CountFile(const std::filesystem::path& path);
+	unsigned long CountFile(Worker& worker, const std::filesystem::path& path, FILE_LANGUAGE language, uint32_t directory);
+	unsigned long CountStream();
+	bool ReadFileList(PathQueue& queue);
+	void StreamWorker(PathQueue& queue, unsigned int worker);
+	LineCounts CountFileLines(Worker& worker, const std::filesystem::path& path, FILE_LANGUAGE language);
+	void AddFileLines(Worker& worker, const std::filesystem::path& path, FILE_LANGUAGE language, uint32_t directory, LineCounts lines);
+	void PrepareWorkers(unsigned int count);
+	Worker& BeginWorker(unsigned int worker);
+	void MergeWorkers();
+	void ShareByNode();
+	bool GetNodeBatch(unsigned int node, size_t& begin, size_t& end, size_t max_paths, bool& stolen);
+	void Reorder(const std::vector<size_t>& order);
+	void PrepareSample();
+	void WaitForSample();
+	void EstimateWorker(unsigned int worker);
 	FILE_LANGUAGE GetFileLanguage(const std::filesystem::path& path) const;
-	void CounterWorker();
-	bool isFileInDirectory(const std::filesystem::path& parentDir, const std::filesystem::path& filePath) const;
+	void CounterWorker(unsigned int worker);
+	void NameWorkerThread(unsigned int worker);
+	void WriteTrace();
+	static void RemoveOverlaps(std::vector<std::filesystem::path>& directories, std::vector<std::filesystem::path>& files);
+	static bool IsWithin(const std::filesystem::path& parent, const std::filesystem::path& child);
 	void expandAllGlobsInPaths(const std::vector<std::filesystem::path>& paths_to_expand);
-	void GetNextPaths(std::vector<std::filesystem::path>& out_paths, int max_paths);
+	bool InShard(const std::filesystem::path& key) const;
+	bool GetNextBatch(size_t& begin, size_t& end, size_t max_paths);
 };
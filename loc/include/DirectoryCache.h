@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "LanguageRegistry.h"
+
+// Directory listings kept between runs, so that a directory that hasn't changed since it was last
+// scanned is replayed instead of read again. A directory is known by its device and inode and its
+// listing is trusted while its modification and change times are the same, which costs one stat per
+// directory instead of a read of every entry.
+//
+// Only the files that matched and the subdirectories to descend into are kept. Changing a file
+// doesn't change its directory, so sizes are as they were when the directory was read, and an
+// extensionless file is recognised by the shebang it had then.
+//
+// Directories can only be stamped on Linux; elsewhere every directory is read.
+class DirectoryCache
+{
+public:
+
+	struct Stamp
+	{
+		uint64_t device{};
+		uint64_t inode{};
+		int64_t modified{};	// nanoseconds since the Unix epoch
+		int64_t changed{};
+
+		bool operator==(const Stamp& other) const = default;
+	};
+
+	struct Listing
+	{
+		Stamp stamp{};
+		std::vector<std::filesystem::path> subdirectories{};
+		std::vector<std::filesystem::path> files{};
+		std::vector<FILE_LANGUAGE> languages{};	// of each file, so an extensionless file's shebang isn't read again
+		std::vector<uintmax_t> sizes{};	// only when sized
+		bool sized{ false };
+		bool marked{ false };	// whether its files were checked for a project's manifest
+		bool project{ false };	// holds a project's manifest, only when marked
+	};
+
+	// Reads a cache written by Save. A missing file is an empty cache; one that can't be read is reported and ignored.
+	void Load(const std::filesystem::path& file);
+
+	// Writes the directories looked up since Load, so directories that are gone drop out
+	bool Save(const std::filesystem::path& file) const;
+
+	// Listings only hold for the scan settings they were made with; different settings empty the cache
+	void UseSettings(const std::string& settings);
+
+	// False when the directory can't be stamped, and so can't be cached
+	static bool StampOf(const std::filesystem::path& directory, Stamp& stamp);
+
+	// The listing of a directory that hasn't changed since it was stored, or null. One made without
+	// the sizes or project manifests asked for is treated as missing.
+	const Listing* Find(const std::filesystem::path& directory, const Stamp& stamp, bool sized, bool marked);
+
+	// Keeps a fresh listing. A directory modified in the last couple of seconds isn't kept: another
+	// change within the same tick of the file system's clock wouldn't change its stamp.
+	void Store(const std::filesystem::path& directory, Listing listing);
+
+	// Directories replayed and read since Load
+	size_t Hits() const;
+	size_t Misses() const;
+
+	static constexpr uint32_t version = 4;
+
+private:
+
+	struct Entry
+	{
+		Listing listing{};
+		bool used{ false };
+	};
+
+	std::string settings{};
+	std::unordered_map<std::filesystem::path::string_type, Entry> entries{};
+	size_t hits{};
+	size_t misses{};
+};
@@ -1,39 +1,64 @@
 #pragma once
+#include <cstdint>
 #include <filesystem>
 #include <string>
 #include <string_view>
+#include <unordered_set>
 #include <vector>
 
+#include "DirectoryCache.h"
+#include "ScanFilter.h"
+#include "Tracer.h"
+
 class DirectoryScanner
 {
 public:
     DirectoryScanner() = default;
 
+    // tracer, when given, records the time spent in each directory.
+    // cache, when given, replays the directories that haven't changed since it was filled.
+    // filter leaves out files by size and age, and directories by depth, before they are opened.
+    explicit DirectoryScanner(Tracer* tracer, DirectoryCache* cache = nullptr, const ScanFilter& filter = {});
+
+    // sizes, when given, receives the size in bytes of each file returned.
+    // projects, when given, receives the directories holding a project's build or package manifest.
+    // languages, when given, receives the language of each file returned, so that extensionless files,
+    // which are recognised by their shebang, don't have to be read again to tell.
     std::vector<std::filesystem::path> Scan(
         const std::filesystem::path& root,
         const std::vector<std::filesystem::path>& ignore_dir_names = {},
         bool case_insensitive = true,
         bool follow_directory_symlinks = false,
-        size_t reserve_result = 0);
+        size_t reserve_result = 0,
+        std::vector<uintmax_t>* sizes = nullptr,
+        std::vector<std::filesystem::path>* projects = nullptr,
+        std::vector<FILE_LANGUAGE>* languages = nullptr);
+
+    // Whether a file marks the top of a project: CMakeLists.txt calling project(), package.json,
+    // Cargo.toml, go.mod, *.csproj and the like
+    static bool IsProjectMarker(const std::filesystem::path& file);
 
 private:
+    Tracer* tracer{};
+    DirectoryCache* cache{};
+    ScanFilter filter{};
+
+    void ScanWithCache(
+        const std::filesystem::path& root,
+        const std::unordered_set<std::string>& ignore_set,
+        bool case_insensitive,
+        bool follow_directory_symlinks,
+        std::vector<std::filesystem::path>& result,
+        std::vector<uintmax_t>* sizes,
+        std::vector<std::filesystem::path>* projects,
+        std::vector<FILE_LANGUAGE>* languages);
+    DirectoryCache::Listing List(
+        const std::filesystem::path& directory,
+        const std::unordered_set<std::string>& ignore_set,
+        bool case_insensitive,
+        bool follow_directory_symlinks,
+        bool sized,
+        bool marked);
+
     std::string to_lower_ascii(std::string_view s);
-    std::string normalize_ext(std::string_view ext, bool case_insensitive);
-
-    static constexpr const char* supported_extensions[] = {
-        ".c", ".h",
-        ".py", ".pyw",
-        ".fs", ".fsx",
-        ".cpp", ".hpp", ".cxx", ".ino",
-        ".hxx", ".c++", ".cc", ".ixx", ".cppm",
-        ".cs",
-        ".rs",
-        ".go",
-        ".xml", ".xaml", ".html",
-        ".java", ".kt", ".kts",
-        ".js", ".jsx", ".ts", ".tsx",
-        ".rb",
-        ".sh", ".zsh",
-        ".ps1", ".psd1", "psm1",
-    };
 };
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+
+// Line counts per directory and language, for a du-like breakdown of where the code is.
+//
+// The directories of the files to count are numbered before counting starts, parents
+// before their children. Each worker records its files against those numbers in a
+// Partial of its own, without locking; at the end the partials are summed into their
+// directories and every directory into its parent, bottom up, a level at a time.
+class DirectoryTree
+{
+public:
+
+	static constexpr uint32_t none = UINT32_MAX;
+
+	struct LanguageLines
+	{
+		FILE_LANGUAGE language{};
+		LineCounts lines{};
+		unsigned int files{};
+	};
+
+	// A directory holding a project's manifest, with the totals of everything under it except the projects nested inside
+	struct Project
+	{
+		std::filesystem::path path{};
+		std::vector<LanguageLines> languages{};
+	};
+
+	// What one worker has counted, by directory. Only that worker writes it.
+	class Partial
+	{
+	public:
+
+		void Record(uint32_t directory, FILE_LANGUAGE language, const LineCounts& lines, unsigned int files);
+
+	private:
+
+		friend class DirectoryTree;
+		std::unordered_map<uint64_t, LanguageLines> totals{};
+	};
+
+	// A directory that was given to count; the directories found under it hang off it
+	uint32_t AddRoot(const std::filesystem::path& directory);
+
+	// Adds the directory of file, and any directories between it and a root, and returns its number.
+	// Directories above a file that isn't under a root become roots of their own.
+	uint32_t Add(const std::filesystem::path& file);
+
+	// The number of the directory of a file that was added, or none. Safe to call from any thread once the tree is built.
+	uint32_t DirectoryOf(const std::filesystem::path& file) const;
+
+	size_t Size() const;
+
+	// The directory above, or none for a root, and the path a directory was added as
+	uint32_t Parent(uint32_t directory) const;
+	const std::filesystem::path& Path(uint32_t directory) const;
+
+	// Sums the partials into their directories and each directory into its parent, on up to jobs threads
+	void Reduce(const std::vector<Partial>& partials, unsigned int jobs);
+
+	// Totals of a directory and everything under it, after Reduce
+	LineCounts Lines(uint32_t directory) const;
+	unsigned int Files(uint32_t directory) const;
+	const std::vector<LanguageLines>& Languages(uint32_t directory) const;
+
+	// Lists the directories down to depth levels below the roots, largest first, with their main languages
+	void Print(std::ostream& out, unsigned int depth) const;
+
+	// The totals of each project, after Reduce, largest first. marked are the directories holding a manifest;
+	// files that aren't under any of them count towards their root, as a project of its own.
+	std::vector<Project> Projects(const std::vector<std::filesystem::path>& marked) const;
+
+	// Lists the projects with the lines and files of each of their languages
+	static void PrintProjects(std::ostream& out, const std::vector<Project>& projects);
+
+private:
+
+	struct Node
+	{
+		uint32_t parent{ none };
+		uint32_t depth{};
+		std::filesystem::path path{};
+		std::vector<LanguageLines> languages{};
+	};
+
+	uint32_t Insert(const std::filesystem::path& directory, bool root);
+	static void Merge(std::vector<LanguageLines>& into, const LanguageLines& lines);
+	static void Subtract(std::vector<LanguageLines>& from, const LanguageLines& lines);
+	void PrintNode(std::ostream& out, uint32_t directory, unsigned int depth, const std::vector<std::vector<uint32_t>>& children) const;
+
+	std::vector<Node> nodes{};
+	std::unordered_map<std::filesystem::path::string_type, uint32_t> ids{};
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+
+// An estimated total with the half width of its 95% confidence interval
+struct EstimatedValue
+{
+	double value{};
+	double margin{};
+};
+
+struct LanguageEstimate
+{
+	EstimatedValue code{};
+	EstimatedValue comment{};
+	EstimatedValue blank{};
+	size_t files{};
+	size_t sampled{};
+};
+
+// Extrapolates line counts from a stratified random sample of the files.
+//
+// Files are grouped into strata by language and by size (powers of two), and
+// Order() interleaves the strata so that every prefix of it is a proportional
+// sample of each one. Counting files in that order and stopping at any point
+// gives an unbiased estimate, which becomes exact once every file is counted.
+class Estimator
+{
+public:
+
+	// languages and sizes are per file, in the order the files were found
+	Estimator(const std::vector<FILE_LANGUAGE>& languages, const std::vector<uintmax_t>& sizes, uint64_t seed = 0);
+
+	// The order in which to count the files: sample i is file Order()[i]
+	const std::vector<size_t>& Order() const;
+
+	// Records the counts of sample sample_index. Thread safe.
+	void Record(size_t sample_index, const LineCounts& counts);
+
+	size_t Sampled() const;
+	size_t FileCount() const;
+
+	std::map<FILE_LANGUAGE, LanguageEstimate> Estimate() const;
+
+	// Estimated code lines over all the languages
+	EstimatedValue TotalCode() const;
+
+private:
+
+	struct Stratum
+	{
+		FILE_LANGUAGE language{};
+		size_t files{};
+		double bytes{};
+
+		// running sums of the sampled files, for code, comment and blank lines
+		size_t sampled{};
+		double sampled_bytes{};
+		double sum[3]{};
+		double sum_squares[3]{};
+	};
+
+	std::vector<size_t> order{};
+	std::vector<Stratum> strata{};
+
+	// stratum and size of each sample, by position in order
+	std::vector<uint32_t> sample_stratum{};
+	std::vector<uintmax_t> sample_size{};
+
+	mutable std::mutex mutex{};
+	size_t sampled{};
+};
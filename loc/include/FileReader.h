@@ -1,23 +1,43 @@
 #pragma once
 
-#include <string>
-#include <vector>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <array>
+#include <system_error>
 
+// Reads a file in large blocks with unbuffered OS calls, so the caller's buffer
+// is the only copy of the data. Failures aren't reported, only kept for Error(),
+// so threads reading files don't contend on a stream and the caller decides what to say.
 class FileReader
 {
 public:
 
-	static void ReadFile(const std::filesystem::path& path, std::vector<std::string>& output);
+	// Size of the blocks files are read in
+	static constexpr size_t block_size = 64 * 1024;
 
-private:
+	FileReader() = default;
+	~FileReader();
+
+	FileReader(const FileReader&) = delete;
+	FileReader& operator=(const FileReader&) = delete;
+
+	// False when the file can't be opened; Error() tells why
+	bool Open(const std::filesystem::path& path);
+
+	// Reads up to size bytes; returns 0 at the end of the file or on error
+	size_t Read(char* buffer, size_t size);
 
-    static std::string_view trim(const std::string& s);
+	// Bytes read since the file was opened
+	uint64_t BytesRead() const;
+
+	// Why the file last opened couldn't be opened or read, or no error
+	std::error_code Error() const;
+
+	void Close();
+
+private:
 
-	static constexpr std::array<bool, 256> is_whitespace = []() {
-		std::array<bool, 256> arr{};
-		arr[' '] = arr['\t'] = arr['\n'] = arr['\r'] = arr['\v'] = arr['\f'] = true;
-		return arr;
-		}();
+	int fd{ -1 };
+	uint64_t bytes_read{};
+	int error{};
 };
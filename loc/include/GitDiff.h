@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+
+enum class DIFF_STATUS
+{
+	Added,
+	Deleted,
+	Modified,
+	Renamed
+};
+
+// One file that differs between the two revisions, counted on both sides
+struct FileDelta
+{
+	DIFF_STATUS status{};
+	std::filesystem::path path{};		// relative to the top of the repository
+	std::filesystem::path old_path{};	// differs from path only when renamed
+	FILE_LANGUAGE old_language{ FILE_LANGUAGE::Other };
+	FILE_LANGUAGE language{ FILE_LANGUAGE::Other };
+	LineCounts before{};
+	LineCounts after{};
+
+	// the parts of before and after in embedded languages, such as the script of an HTML page
+	std::vector<LineCounter::EmbeddedLines> before_embedded{};
+	std::vector<LineCounter::EmbeddedLines> after_embedded{};
+};
+
+// Net change in the lines of one language
+struct LanguageDelta
+{
+	long long code{};
+	long long comment{};
+	long long blank{};
+	unsigned int files{};
+};
+
+// Counts the lines of code a change adds or removes, reading only the files git reports as changed.
+// The old side of each file is read from git's object store; the new side from head, or from the
+// working tree when there is no head. Each worker reads its blobs through one git cat-file --batch. Both sides are classified by the same line counter, so the
+// deltas are exactly what two full runs would give.
+class GitDiff
+{
+public:
+
+	// range is "base" (base against the working tree) or "base..head".
+	// Markdown files only count with markdown set, as in a full run.
+	GitDiff(std::string_view range, const std::vector<std::filesystem::path>& pathspecs, bool skip_unusual, bool markdown = false);
+
+	// Lists the changed files. Prints an error and returns false if git can't.
+	bool Load();
+
+	// Counts both sides of every changed file on jobs threads. False if git failed on any of them.
+	bool Count(unsigned int jobs);
+
+	const std::vector<FileDelta>& Files() const;
+	std::map<FILE_LANGUAGE, LanguageDelta> ByLanguage() const;
+
+	// Net code lines over all the languages
+	long long NetCode() const;
+
+	static void PrintLanguageBreakdown(const std::map<FILE_LANGUAGE, LanguageDelta>& deltas);
+	void PrintFiles() const;
+
+	// Parses the output of git diff --raw -z. A submodule that moved to another commit is left out, and one
+	// that replaced a file, or was replaced by one, counts as that file's deletion or addition.
+	static std::vector<FileDelta> ParseRaw(std::string_view output);
+
+private:
+
+	// A worker's git cat-file --batch process
+	class BlobReader;
+
+	bool CountDelta(LineCounter& counter, BlobReader& blobs, FileDelta& delta) const;
+
+	// The contents of path at revision, or in the working tree when revision is empty
+	bool ReadSide(BlobReader& blobs, const std::string& revision, const std::filesystem::path& path, std::string& text) const;
+
+	LineCounts CountSide(LineCounter& counter, const std::filesystem::path& path, const std::string& text, FILE_LANGUAGE& language,
+		std::vector<LineCounter::EmbeddedLines>& embedded) const;
+
+	std::string base{};
+	std::string head{};
+	bool from_merge_base{};
+	std::vector<std::filesystem::path> pathspecs{};
+	bool skip_unusual{};
+	bool markdown{};
+
+	std::filesystem::path top{};
+	std::vector<FileDelta> files{};
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+
+enum class FILE_LANGUAGE
+{
+    C,
+    CHeader,
+    Cpp,
+    CS,
+    Css,
+    Go,
+    Html,
+    Java,
+    JavaScript,
+    TypeScript,
+    Kotlin,
+    Markdown,
+    Ruby,
+    Rust,
+    Shell,
+    PowerShell,
+    Python,
+    FSharp,
+    Xaml,
+    Xml,
+    Other
+};
+
+// Comment and string literal rules, shared by languages with the same syntax
+enum class LEXICAL_SYNTAX
+{
+    CFamily,
+    CSharp,
+    Java,
+    Kotlin,
+    JavaScript,
+    Go,
+    Rust,
+    Python,
+    Ruby,
+    Shell,
+    PowerShell,
+    FSharp,
+    Markup,
+    Css,
+    Html,       // Markup with embedded JavaScript and CSS
+    Markdown    // prose, with embedded fenced code
+};
+
+// Single source of truth for the languages loc understands: display names,
+// lexical syntax, file extensions and shebang interpreters.
+class LanguageRegistry
+{
+public:
+
+    struct LanguageInfo
+    {
+        FILE_LANGUAGE language;
+        std::string_view name;
+        LEXICAL_SYNTAX syntax;
+    };
+
+    // A Markdown code fence info string, e.g. ```python
+    struct FenceTag
+    {
+        std::string_view tag;
+        FILE_LANGUAGE language;
+    };
+
+    // Look up a language by extension (including the leading '.'). Allocation free.
+    static FILE_LANGUAGE FromExtension(std::string_view extension, bool case_insensitive = true);
+
+    // Look up a language from the extension of a path. Allocation free.
+    static FILE_LANGUAGE FromPath(const std::filesystem::path& path, bool case_insensitive = true);
+
+    // Detect the language of a script from its "#!" line. Only the first bytes of the file are read. Allocation free.
+    static FILE_LANGUAGE FromShebang(const std::filesystem::path& path);
+
+    // The same, from the start of a file that is already in memory
+    static FILE_LANGUAGE FromShebangText(std::string_view head);
+
+    // Detect the language of a file, falling back to the shebang for extensionless files. Allocation free.
+    static FILE_LANGUAGE Detect(const std::filesystem::path& path);
+
+    // Look up a language by its display name, e.g. "C++"
+    static std::optional<FILE_LANGUAGE> FromName(std::string_view name);
+
+    static bool HasExtension(const std::filesystem::path& path);
+
+    static const LanguageInfo& GetInfo(FILE_LANGUAGE language);
+
+    // The fence info strings whose code is counted as another language
+    static std::span<const FenceTag> FenceTags();
+
+    static constexpr size_t language_count = static_cast<size_t>(FILE_LANGUAGE::Other) + 1;
+
+private:
+
+    static FILE_LANGUAGE FromInterpreter(std::string_view interpreter);
+};
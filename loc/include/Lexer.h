@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+
+enum class MODE_KIND : uint8_t
+{
+    Code,
+    Comment,
+    String,
+    CppRawString
+};
+
+// The lexical rules of a language (comments and string literals) compiled into a
+// DFA transition table. Each input byte costs one table lookup, and lines are
+// classified as code, comment or blank as their newline is consumed.
+class Lexer
+{
+public:
+
+    // Scanning state carried between chunks of the same file
+    struct State
+    {
+        uint16_t state{};
+        uint8_t marks{};
+        bool line_open{};
+
+        // slot of the language the lexer is in, and of the embedded language it was last in
+        uint8_t slot{};
+        uint8_t embedded{};
+
+        // C++ raw string literals have a user defined delimiter, which a DFA can't match
+        uint8_t raw_phase{};
+        uint8_t raw_length{};
+        uint8_t raw_match{};
+        char raw_delimiter[16]{};
+    };
+
+    static const Lexer& ForSyntax(LEXICAL_SYNTAX syntax);
+
+    State Start() const;
+    void Feed(State& state, const char* data, size_t size, LineCounts& counts) const;
+
+    // UTF-16 and UTF-32 text, in host byte order. Code units above 0xFF are treated like any other non-token character.
+    void Feed(State& state, const char16_t* data, size_t size, LineCounts& counts) const;
+    void Feed(State& state, const char32_t* data, size_t size, LineCounts& counts) const;
+    void Finish(State& state, LineCounts& counts) const;
+
+    // Files can embed other languages: the JavaScript and CSS of an HTML page, the fenced code of Markdown.
+    // Their lines are counted by slot: slot 0 is the file's own language, slot i is SlotLanguage(i).
+    // Feed and Finish count every line together.
+    size_t SlotCount() const;
+    FILE_LANGUAGE SlotLanguage(size_t slot) const;
+
+    // As Feed and Finish, with counts[i] receiving the lines of slot i. counts has SlotCount() entries.
+    void FeedSlots(State& state, const char* data, size_t size, LineCounts* counts) const;
+    void FeedSlots(State& state, const char16_t* data, size_t size, LineCounts* counts) const;
+    void FeedSlots(State& state, const char32_t* data, size_t size, LineCounts* counts) const;
+    void FinishSlots(State& state, LineCounts* counts) const;
+
+    size_t StateCount() const;
+
+    // Marks set on a line by the bytes it contains. Marks of an embedded language are shifted up by embedded_shift.
+    static constexpr uint8_t mark_code = 1;
+    static constexpr uint8_t mark_comment = 2;
+    static constexpr uint8_t embedded_shift = 2;
+
+    struct TokenSpec
+    {
+        std::string text;
+        uint8_t target;
+    };
+
+    // One lexical context (code, a comment, a string literal...). Tokens switch to
+    // another mode; any other byte stays in the mode, or moves to the fallback mode
+    // when there is one (used for escape sequences). Modes of an embedded language
+    // name it; their lines are counted as that language.
+    struct ModeSpec
+    {
+        MODE_KIND kind;
+        std::vector<TokenSpec> tokens;
+        int fallback = -1;
+        FILE_LANGUAGE embedded = FILE_LANGUAGE::Other;
+    };
+
+    // The rules a syntax's table is built from, mode 0 first. Tests work out what the table must do from them.
+    static std::vector<ModeSpec> Rules(LEXICAL_SYNTAX syntax);
+
+private:
+
+    explicit Lexer(const std::vector<ModeSpec>& modes);
+
+    template <typename Unit, bool Slots>
+    void FeedUnits(State& state, const Unit* data, size_t size, LineCounts* counts) const;
+
+    template <typename Unit, bool Slots>
+    const Unit* FeedRawString(State& state, const Unit* p, const Unit* end, uint32_t& marks, LineCounts* counts) const;
+
+    template <bool Slots>
+    void FinishLine(State& state, LineCounts* counts) const;
+
+    // Class of a code unit; units outside the byte range share the class of bytes no token uses
+    template <typename Unit>
+    uint8_t ClassOf(Unit unit) const;
+
+    static constexpr uint8_t other_class = 0;
+
+    static constexpr uint32_t state_mask = 0xFFFF;
+    static constexpr uint32_t mark_shift = 16;
+    static constexpr uint32_t mark_mask = 0xF;
+    static constexpr uint32_t special_bit = 1u << 31;
+
+    std::array<uint8_t, 256> classes{};
+    size_t class_count{};
+    uint16_t start_state{};
+
+    // table[state * class_count + class] = next state | marks << mark_shift | special_bit
+    std::vector<uint32_t> table{};
+    std::vector<uint8_t> eof_marks{};
+    std::vector<uint8_t> special{};
+    std::vector<uint16_t> special_return{};
+
+    // slot of each state, and the language of each slot
+    std::vector<uint8_t> slots{};
+    std::vector<FILE_LANGUAGE> slot_languages{};
+};
@@ -1,18 +1,94 @@
 #pragma once
 
-#include <string>
-#include <vector>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
-#include "FileReader.h"
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "LanguageRegistry.h"
+#include "Sniffer.h"
+#include "Tracer.h"
+
+class Lexer;
+
+// Physical line breakdown of a file. Every line is exactly one of code, comment or blank.
+struct LineCounts
+{
+    unsigned long code{};
+    unsigned long comment{};
+    unsigned long blank{};
+    unsigned long total{};
 
+    LineCounts& operator+=(const LineCounts& other);
+    LineCounts& operator-=(const LineCounts& other);
+};
+
+// Counts the lines of one file at a time. Its buffers are kept from file to file, so once they have
+// grown to fit, counting a file makes no heap allocations.
 class LineCounter
 {
 public:
 
-    unsigned long CountLines(const std::filesystem::path& path, const std::string& inlineComment,
-        const std::string& startMultilineComment, const std::string& endMultilineComment);
+    // Lines of another language inside a file, such as the script of an HTML page
+    struct EmbeddedLines
+    {
+        FILE_LANGUAGE language;
+        LineCounts lines;
+    };
+
+    LineCounter() = default;
+
+    // With skip_unusual set, binary, minified and generated files are recognised from their
+    // first block and count as nothing; LastKind() tells what was skipped.
+    // tracer, when given, records the opens, reads and classification of each file.
+    // With physical set lines aren't lexed, only split into blank and code (see PhysicalLines).
+    explicit LineCounter(bool skip_unusual, Tracer* tracer = nullptr, bool physical = false);
+
+    // first_read_latency, when given, receives the time spent opening the file and waiting for its first block
+    LineCounts CountLines(const std::filesystem::path& path, FILE_LANGUAGE language,
+        std::chrono::nanoseconds* first_read_latency = nullptr);
+
+    // Count the lines of source that is already in memory
+    LineCounts CountText(std::string_view text, FILE_LANGUAGE language);
+
+    // The languages embedded in the file last counted. CountLines and CountText include their lines.
+    const std::vector<EmbeddedLines>& LastEmbedded() const;
+
+    // What the file last passed to CountLines turned out to be
+    FILE_KIND LastKind() const;
+
+    // Bytes read from the file last passed to CountLines
+    uint64_t LastSize() const;
+
+    // Why the file last passed to CountLines couldn't be opened or read, or no error. Nothing is printed.
+    std::error_code LastError() const;
 
 private:
 
-    bool StrContains(const std::string& str, const std::string& substr);
+    // read buffer, reused between files
+    std::vector<char> buffer{};
+
+    // code units of UTF-16 and UTF-32 files, in host byte order
+    std::vector<char16_t> wide16{};
+    std::vector<char32_t> wide32{};
+
+    // lines of each of the lexer's slots; slot 0 is the file's own language
+    std::vector<LineCounts> slot_counts{};
+    std::vector<EmbeddedLines> last_embedded{};
+
+    // Starts counting a file in slot_counts, and adds them up when it is done
+    void BeginSlots(const Lexer& lexer);
+    LineCounts EndSlots(const Lexer& lexer);
+
+    bool skip_unusual{};
+    bool physical{};
+    Tracer* tracer{};
+
+    // physical counting is cheap enough per byte that fewer, larger reads pay off
+    static constexpr size_t physical_block_size = 1024 * 1024;
+    FILE_KIND last_kind{ FILE_KIND::Source };
+    uint64_t last_size{};
+    std::error_code last_error{};
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+
+#include "Counter.h"
+#include "LanguageRegistry.h"
+
+// Per-language totals of one shard of a distributed run. Any number of partial
+// results can be merged into the totals a single run would have produced.
+//
+// The file is plain text: a "loc-partial <version>" header, then one line per
+// language of tab separated name, files, code, comment, blank and total lines,
+// then a "skipped" line of the binary, minified and generated files left out.
+class PartialResult
+{
+public:
+
+	static bool Save(const std::filesystem::path& path, const std::map<FILE_LANGUAGE, LanguageTotals>& counts,
+		const SkippedCounts& skipped = {});
+
+	// Adds the totals in the file to counts, and its skipped files to skipped when given. Files of version 1,
+	// from before skipped files were kept, are read as having skipped none.
+	static bool Load(const std::filesystem::path& path, std::map<FILE_LANGUAGE, LanguageTotals>& counts,
+		SkippedCounts* skipped = nullptr);
+
+	static constexpr int version = 2;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+// Bounded queue of paths between one producer reading a file list and the
+// workers counting them. The producer blocks when the queue is full, so memory
+// stays the same however long the list is.
+class PathQueue
+{
+public:
+
+	explicit PathQueue(size_t capacity);
+
+	// Blocks while the queue is full
+	void Push(std::filesystem::path path);
+
+	// No more paths will be pushed; wakes every waiting worker
+	void Close();
+
+	// Replaces out with up to max_paths paths, blocking while the queue is empty.
+	// Returns false once the queue is closed and drained.
+	bool PopBatch(std::vector<std::filesystem::path>& out, size_t max_paths);
+
+private:
+
+	size_t capacity{};
+	bool closed{ false };
+	std::deque<std::filesystem::path> items{};
+
+	std::mutex mutex{};
+	std::condition_variable not_full{};
+	std::condition_variable not_empty{};
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "LineCounter.h"
+
+// Counts physical lines without lexing, for when only the size of a code base matters:
+// a line with nothing but whitespace on it is blank and any other line is code, so
+// comments count as code. Newlines and whitespace are found 64 bytes at a time (with
+// SSE2 where it is available) and the lines are counted from the bit masks without a
+// branch per line.
+class PhysicalLines
+{
+public:
+
+	// Carries a line across calls to Feed
+	struct State
+	{
+		bool text{};		// the open line has something other than whitespace on it
+		bool line_open{};
+	};
+
+	static void Feed(State& state, const char* data, size_t size, LineCounts& counts);
+	static void Feed(State& state, const char16_t* data, size_t size, LineCounts& counts);
+	static void Feed(State& state, const char32_t* data, size_t size, LineCounts& counts);
+
+	// Counts a last line that has no newline, and resets state
+	static void Finish(State& state, LineCounts& counts);
+
+	// Code units are looked at this many at a time
+	static constexpr size_t chunk_size = 64;
+};
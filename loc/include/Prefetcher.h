@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+// Runs a window of files ahead of the workers asking the kernel to read them into
+// the page cache (posix_fadvise WILLNEED), so that a worker reaching a file finds
+// its data already in memory. The window grows while the workers are waiting on
+// reads and shrinks back when they aren't, damped so that one noisy sample doesn't
+// swing it. Linux only; elsewhere it does nothing.
+class Prefetcher
+{
+public:
+
+	// paths and next_index are the work queue of the workers; both must outlive the prefetcher.
+	// claimed is how far behind next_index the workers may still not have opened a file, a batch per worker,
+	// so those files are still prefetched. max_window of 0 lets the window grow to default_max_window.
+	Prefetcher(const std::vector<std::filesystem::path>& paths, const std::atomic<size_t>& next_index, size_t claimed,
+		size_t min_window, size_t max_window = 0);
+	~Prefetcher();
+
+	Prefetcher(const Prefetcher&) = delete;
+	Prefetcher& operator=(const Prefetcher&) = delete;
+
+	void Start();
+	void Stop();
+
+	// Called by the workers with the time they waited for the first block of a file
+	void RecordReadLatency(std::chrono::nanoseconds latency);
+
+	size_t Window() const;
+
+	// Number of files the kernel has been asked to read ahead
+	size_t Prefetched() const;
+
+	// Files that need to be in flight to hide latency at the rate the workers take files, with headroom
+	static size_t ComputeWindow(std::chrono::nanoseconds latency, double files_per_second, size_t min_window, size_t max_window);
+
+	// The window after a sample that wants wanted: changes within a quarter of the window are ignored,
+	// and one sample can at most double or halve it
+	static size_t DampWindow(size_t window, size_t wanted);
+
+	static constexpr size_t default_max_window = 512;
+
+private:
+
+	void Run(std::stop_token stop);
+
+	const std::vector<std::filesystem::path>& paths;
+	const std::atomic<size_t>& next_index;
+	size_t claimed{};
+	size_t min_window{};
+	size_t max_window{};
+
+	std::atomic<size_t> window{};
+	std::atomic<size_t> prefetched{};
+
+	// exponentially weighted moving average of the read latency
+	std::atomic<int64_t> latency_ns{};
+
+	std::jthread thread{};
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class PROGRESS_FORMAT
+{
+	None,
+	Text,	// one line, rewritten in place
+	Json	// one JSON object per line, for job runners
+};
+
+// What one worker has done so far. Only the worker writes it, with relaxed stores,
+// and each sits on its own cache line so workers never contend.
+struct alignas(64) WorkerProgress
+{
+	static constexpr size_t idle = SIZE_MAX;
+
+	// busy with a file that isn't in the reporter's list, e.g. one streamed from --files-from
+	static constexpr size_t unlisted = SIZE_MAX - 1;
+
+	std::atomic<uint64_t> files{};
+	std::atomic<uint64_t> bytes{};
+	std::atomic<size_t> current{ idle };
+
+	// Called by the worker before and after each file
+	void Begin(size_t index);
+	void Done(uint64_t file_bytes);
+};
+
+// Samples the workers' counters at a fixed interval from its own thread and
+// reports files and bytes done, throughput, ETA and what each worker is on.
+class ProgressReporter
+{
+public:
+
+	// paths is the work queue, indexed by WorkerProgress::current; it must outlive the reporter.
+	// When the files are streamed paths is empty, and the total and ETA are left out.
+	ProgressReporter(const std::vector<std::filesystem::path>& paths, unsigned int workers, PROGRESS_FORMAT format,
+		std::chrono::milliseconds interval, std::ostream& out);
+	~ProgressReporter();
+
+	ProgressReporter(const ProgressReporter&) = delete;
+	ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+	WorkerProgress& Worker(unsigned int index);
+
+	void Start();
+
+	// Stops sampling and writes a last report
+	void Stop();
+
+	// The report for the counters as they are now
+	std::string Report();
+
+private:
+
+	void Run(std::stop_token stop);
+
+	const std::vector<std::filesystem::path>& paths;
+	unsigned int worker_count{};
+	std::unique_ptr<WorkerProgress[]> workers{};
+	PROGRESS_FORMAT format{};
+	std::chrono::milliseconds interval{};
+	std::ostream& out;
+
+	std::chrono::steady_clock::time_point started{};
+	std::chrono::steady_clock::time_point last_sample{};
+	uint64_t last_files{};
+	uint64_t last_bytes{};
+
+	std::mutex mutex{};
+	std::condition_variable_any wake{};
+	std::jthread thread{};
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+enum class READ_ORDER
+{
+	None,
+	Inode,	// sort by inode number, a good proxy for on-disk placement on most file systems
+	Extent	// sort by the physical offset of the first extent (FIEMAP), falling back to the inode
+};
+
+// Reorders the work queue so that files are read in the order they are laid out
+// on disk. Only worth it on rotational and network storage, where reading in
+// directory order means a seek between every file. That is decided for each
+// device the files are on, so roots on different storage are each treated as
+// their own storage calls for.
+class ReadOrder
+{
+public:
+
+	// Sorts paths into on-disk order using jobs threads for the metadata lookups.
+	// Returns false, leaving paths untouched, when none of the storage would benefit (unless force is set).
+	static bool Sort(std::vector<std::filesystem::path>& paths, READ_ORDER order, unsigned int jobs, bool force = false);
+
+	// The same order as indexes into paths, for reordering other lists along with them. Empty when
+	// none of the storage would benefit.
+	static std::vector<size_t> Order(const std::vector<std::filesystem::path>& paths, READ_ORDER order, unsigned int jobs, bool force = false);
+
+	// As Order, asking benefits about each device, with one of the files on it, instead of looking at the storage.
+	// The files on devices that wouldn't benefit keep their order. Files are grouped by device.
+	static std::vector<size_t> OrderWhere(const std::vector<std::filesystem::path>& paths, READ_ORDER order, unsigned int jobs,
+		const std::function<bool(const std::filesystem::path&)>& benefits);
+
+	// True for rotational disks and network file systems; false for SSDs, tmpfs and unknown devices
+	static bool BenefitsFromOrdering(const std::filesystem::path& path);
+};
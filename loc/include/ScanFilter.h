@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+// Limits on the files a directory scan returns, judged from their metadata alone, so that a file
+// outside them is never opened and a directory below max_depth is never read. Only scanning is
+// filtered: files named directly or listed with --files-from are always counted.
+struct ScanFilter
+{
+	// in bytes, both inclusive
+	uintmax_t min_size{};
+	uintmax_t max_size{ std::numeric_limits<uintmax_t>::max() };
+
+	// last modified at or after newer_than and before older_than, in seconds since the Unix epoch
+	int64_t newer_than{ std::numeric_limits<int64_t>::min() };
+	int64_t older_than{ std::numeric_limits<int64_t>::max() };
+
+	// how many levels of directories below a root are scanned; 0 is only the root's own files
+	unsigned int max_depth{ std::numeric_limits<unsigned int>::max() };
+
+	// Whether files have to be stat'ed for their size or age
+	bool NeedsMetadata() const;
+
+	bool Admits(uintmax_t size, int64_t modified) const;
+
+	// The size and modification time of a file, from a single statx on Linux. False when it can't be stat'ed.
+	static bool Metadata(const std::filesystem::path& file, uintmax_t& size, int64_t& modified);
+
+	// A size such as 4096, 100K, 10M, 2G or 1T; the suffixes are powers of 1024
+	static std::optional<uintmax_t> ParseSize(std::string_view text);
+
+	// A time given as how long before now, such as 90s, 30m, 12h, 7d or 2w, or as a date, 2024-05-31,
+	// which is midnight UTC. now and the result are seconds since the Unix epoch.
+	static std::optional<int64_t> ParseTime(std::string_view text, int64_t now);
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DirectoryTree.h"
+#include "GitDiff.h"
+#include "LanguageRegistry.h"
+#include "LineCounter.h"
+
+// The counts of every file of a run, saved so that two runs can be compared later without
+// the source trees.
+//
+// The file is binary and laid out to be used where it lies: a 64 byte header, the names of
+// the languages, the directories sorted by path, the files sorted by directory and name, all
+// as fixed size records, then the strings they point into. Directory paths are stored once,
+// relative to the paths that were counted, so runs over checkouts in different places compare
+// file by file. Numbers are in the byte order of the machine that wrote the file.
+class Snapshot
+{
+public:
+
+	// One file's lines in one language, as a worker records it. A file with embedded languages,
+	// such as an HTML page with scripts, has a row for each of them too.
+	struct Entry
+	{
+		uint32_t directory{};	// in the DirectoryTree of the run
+		std::string name{};
+		FILE_LANGUAGE language{};
+		bool embedded{};
+		LineCounts lines{};
+		uint64_t size{};
+		int64_t modified{};		// seconds since the Unix epoch
+	};
+
+	// A row of a loaded snapshot; name points into the snapshot
+	struct File
+	{
+		uint32_t directory{};
+		std::string_view name{};
+		FILE_LANGUAGE language{};
+		bool embedded{};
+		LineCounts lines{};
+		uint64_t size{};
+		int64_t modified{};
+	};
+
+	// Net code lines, and the number of files added, removed or changed, in a directory and everything under it
+	struct DirectoryDelta
+	{
+		long long code{};
+		unsigned int files{};
+	};
+
+	struct Delta
+	{
+		std::map<FILE_LANGUAGE, LanguageDelta> languages{};
+		std::map<std::string, DirectoryDelta> directories{};	// "" is the paths that were counted
+	};
+
+	// Writes the entries, whose directories are numbered in tree
+	static bool Save(const std::filesystem::path& path, const DirectoryTree& tree, std::vector<Entry> entries);
+
+	// Reads and checks a whole snapshot. Prints an error and returns false if it isn't one.
+	bool Load(const std::filesystem::path& path);
+
+	size_t DirectoryCount() const;
+	std::string_view Directory(size_t directory) const;
+	size_t FileCount() const;
+	File GetFile(size_t file) const;
+
+	// The change from before to after, found by walking both in path order. Directories more than
+	// depth levels down are counted in their ancestor at that depth.
+	static Delta Compare(const Snapshot& before, const Snapshot& after, unsigned int depth);
+
+	static void PrintDirectories(std::ostream& out, const std::map<std::string, DirectoryDelta>& directories);
+
+	static constexpr uint32_t version = 1;
+
+private:
+
+	struct Range
+	{
+		size_t begin{};
+		size_t end{};
+	};
+
+	Range Files(size_t directory) const;
+	static void CompareFiles(const Snapshot& before, Range old_files, const Snapshot& after, Range new_files,
+		std::map<FILE_LANGUAGE, LanguageDelta>& languages, DirectoryDelta& directory);
+
+	// the whole file, 8 byte aligned so the records can be used in place
+	std::vector<uint64_t> data{};
+	size_t directory_count{};
+	size_t file_count{};
+	size_t directories_offset{};
+	size_t files_offset{};
+	size_t strings_offset{};
+	size_t string_bytes{};
+
+	// the languages by their number in the file; ones this version doesn't know are Other
+	std::vector<FILE_LANGUAGE> languages{};
+};
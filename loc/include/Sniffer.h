@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// What a file with a source extension turned out to contain
+enum class FILE_KIND
+{
+	Source,
+	Binary,		// contains NUL bytes
+	Minified,	// lines far longer than anyone writes by hand
+	Generated	// marked as generated in its leading comments, e.g. "DO NOT EDIT" or "@generated"
+};
+
+// Cheap look at the start of a file, so that bundles, binaries and generated
+// code can be skipped before the whole file is read and classified.
+class Sniffer
+{
+public:
+
+	// How much of the start of a file is looked at
+	static constexpr size_t sniff_size = 4096;
+
+	// A file is minified when most of its sniffed lines are at least minified_line_length long,
+	// or its sniffed lines are minified_average_length long on average
+	static constexpr size_t minified_line_length = 1000;
+	static constexpr size_t minified_average_length = 300;
+
+	// head is the start of the file; only the first sniff_size bytes are used
+	static FILE_KIND Sniff(std::string_view head);
+
+	// Plural name for reports, e.g. "generated files"
+	static std::string_view Describe(FILE_KIND kind);
+};
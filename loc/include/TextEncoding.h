@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+enum class TEXT_ENCODING
+{
+	Utf8,		// also ASCII and the 8 bit code pages, which lex the same
+	Utf16LE,
+	Utf16BE,
+	Utf32LE,
+	Utf32BE
+};
+
+// Recognises the encoding of a source file from its first bytes, so files
+// saved as UTF-16 or UTF-32 can be lexed a code unit at a time.
+class TextEncoding
+{
+public:
+
+	// Uses the byte order mark if there is one, otherwise the pattern of NUL bytes
+	// that ASCII text has when stored in wide code units. bom_length receives the
+	// number of bytes to skip.
+	static TEXT_ENCODING Detect(std::string_view head, size_t& bom_length);
+
+	// Bytes per code unit
+	static size_t UnitSize(TEXT_ENCODING encoding);
+
+	// True when the code units are stored in the opposite byte order to this machine's
+	static bool NeedsSwap(TEXT_ENCODING encoding);
+
+	// Copies the whole code units in bytes to out, in host byte order. Returns the number of units.
+	static size_t Decode(const char* bytes, size_t size, bool swap, char16_t* out);
+	static size_t Decode(const char* bytes, size_t size, bool swap, char32_t* out);
+};
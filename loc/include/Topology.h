@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+// The NUMA nodes of the machine and the CPUs of each that this process may run on, for placing
+// workers next to the memory they use. Read from sysfs on Linux; elsewhere, and on machines
+// without NUMA, every CPU is on one node.
+class Topology
+{
+public:
+
+	struct Node
+	{
+		unsigned int id{};
+		std::vector<unsigned int> cpus{};
+	};
+
+	// Where a worker runs: an index into Nodes(), and one of that node's CPUs
+	struct Placement
+	{
+		unsigned int node{};
+		unsigned int cpu{};
+	};
+
+	static Topology Detect();
+
+	// Nodes without CPUs are left out; with none left, there is one node with CPU 0
+	explicit Topology(std::vector<Node> nodes);
+
+	const std::vector<Node>& Nodes() const;
+
+	// Deals workers out to the nodes in turn, and to the CPUs of each node in turn, so any number
+	// of workers is spread evenly and neighbouring workers don't share a node
+	Placement Place(unsigned int worker) const;
+
+	// Pins the calling thread to a CPU. False when that isn't possible, and always off Linux.
+	static bool Pin(unsigned int cpu);
+
+	// The CPUs of a sysfs CPU list such as "0-3,8,10-11"
+	static std::vector<unsigned int> ParseCpuList(std::string_view list);
+
+private:
+
+	std::vector<Node> nodes{};
+};
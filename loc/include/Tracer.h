@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records timed spans of what each thread is doing and writes them as Chrome
+// trace-event JSON, for chrome://tracing and ui.perfetto.dev.
+//
+// Each thread records into a ring buffer of its own, so recording takes no lock
+// and never waits for another thread; once a buffer is full the oldest events
+// are overwritten. Nothing is formatted until Write().
+class Tracer
+{
+public:
+
+	static constexpr size_t default_capacity = 1 << 16;
+
+	// capacity is the most events kept per thread
+	explicit Tracer(size_t capacity = default_capacity);
+
+	Tracer(const Tracer&) = delete;
+	Tracer& operator=(const Tracer&) = delete;
+
+	// Names the calling thread in the trace
+	void NameThread(std::string name);
+
+	// Records a span on the calling thread from begin until now. path, if given, is shown with the span.
+	void Record(const char* name, const char* category, std::chrono::steady_clock::time_point begin,
+		const std::filesystem::path* path = nullptr);
+
+	// Events lost because a thread's buffer was full
+	size_t Dropped() const;
+
+	// Writes every recorded event. No thread may be recording while it runs.
+	void Write(std::ostream& out) const;
+	bool Write(const std::filesystem::path& path) const;
+
+private:
+
+	struct Event
+	{
+		const char* name{};
+		const char* category{};
+		int64_t begin_ns{};
+		int64_t duration_ns{};
+		std::string detail{};
+	};
+
+	// Written only by its own thread
+	struct Buffer
+	{
+		std::string name{};
+		unsigned int id{};
+		std::vector<Event> events{};
+		size_t recorded{};
+	};
+
+	Buffer& Local();
+
+	size_t capacity{};
+	uint64_t instance{};
+	std::chrono::steady_clock::time_point started{};
+
+	mutable std::mutex mutex{};
+	std::vector<std::unique_ptr<Buffer>> buffers{};
+};
+
+// Records a span on tracer from construction to destruction. Does nothing, not even read the clock, without a tracer.
+class TraceSpan
+{
+public:
+
+	TraceSpan(Tracer* tracer, const char* name, const char* category, const std::filesystem::path* path = nullptr);
+	~TraceSpan();
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+
+	Tracer* tracer{};
+	const char* name{};
+	const char* category{};
+	const std::filesystem::path* path{};
+	std::chrono::steady_clock::time_point begin{};
+};
@@ -1,11 +1,15 @@
 #include "Counter.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <future>
 #include <iostream>
 #include <queue>
 #include <iomanip>
+#include <optional>
+#include <unordered_set>
 
 Counter::Counter(unsigned int jobs, const std::vector<std::filesystem::path>& paths)
 {
@@ -14,17 +18,59 @@ Counter::Counter(unsigned int jobs, const std::vector<std::filesystem::path>& pa
 
 	// go through the paths and expand glob patterns
 	expandAllGlobsInPaths(this->paths);
+
+	// globs can match the same file more than once
+	std::vector<std::filesystem::path> roots{};
+	RemoveOverlaps(roots, this->paths);
+	for (const auto& path : this->paths) languages.push_back(GetFileLanguage(path));
 }
 
 Counter::Counter(unsigned int jobs, const std::vector<std::filesystem::path>& directoryPaths,
 	const std::vector<std::filesystem::path>& filePaths,
-	bool includeGenerated, const std::vector<std::filesystem::path>& ignoreDirs)
+	bool includeGenerated, const std::vector<std::filesystem::path>& ignoreDirs,
+	const CounterOptions& options)
 {
 	this->jobs = jobs;
+	this->options = options;
+	this->options.estimate = options.estimate || options.time_budget.count() > 0;
 	this->paths = filePaths;
 	expandAllGlobsInPaths(this->paths);
 
-	DirectoryScanner directorScanner{};
+	// Count every file once, however the roots, globs and files overlap
+	std::vector<std::filesystem::path> roots = directoryPaths;
+	RemoveOverlaps(roots, paths);
+
+	// Files given directly are assigned to a shard by the path they were given as
+	if (options.shard_count > 1)
+	{
+		std::erase_if(paths, [this](const std::filesystem::path& path) { return !InShard(path); });
+	}
+	for (const auto& path : paths) languages.push_back(GetFileLanguage(path));
+
+	// Sampling is stratified by file size
+	if (this->options.estimate)
+	{
+		for (const auto& path : paths)
+		{
+			std::error_code ec;
+			auto size = std::filesystem::file_size(path, ec);
+			sizes.push_back(ec ? 0 : size);
+		}
+	}
+
+	if (!options.trace.empty())
+	{
+		tracer = std::make_unique<Tracer>();
+		tracer->NameThread("main");
+	}
+
+	std::optional<DirectoryCache> listings{};
+	if (!options.dir_cache.empty())
+	{
+		listings.emplace();
+		listings->Load(options.dir_cache);
+	}
+	DirectoryScanner directorScanner{ tracer.get(), listings ? &*listings : nullptr, options.filter };
 
 	// Create a complete list of directories to ignore
 	std::vector<std::filesystem::path> ignore = ignoreDirs;
@@ -35,18 +81,70 @@ Counter::Counter(unsigned int jobs, const std::vector<std::filesystem::path>& di
 	}
 
 	// Get the paths to all the files that match the specified pattern, excluding files in ignored directories
-	for (const auto& directoryPath : directoryPaths)
-	{
-		auto collectedPaths = directorScanner.Scan(directoryPath, ignore);
+	size_t given_files = paths.size();
+	for (const auto& directoryPath : roots)
+	{
+		TraceSpan span{ tracer.get(), "scan", "scan", &directoryPath };
+		std::vector<uintmax_t> collectedSizes{};
+		std::vector<FILE_LANGUAGE> collectedLanguages{};
+		auto collectedPaths = directorScanner.Scan(directoryPath, ignore, true, false, 0,
+			this->options.estimate ? &collectedSizes : nullptr, options.by_project ? &project_markers : nullptr, &collectedLanguages);
+
+		// Scanned files are assigned to a shard by their path relative to the scanned directory,
+		// so every machine agrees regardless of where the tree is checked out
+		if (options.shard_count > 1 || !options.markdown)
+		{
+			size_t kept = 0;
+			for (size_t i = 0; i < collectedPaths.size(); ++i)
+			{
+				if (!options.markdown && collectedLanguages[i] == FILE_LANGUAGE::Markdown) continue;
+				if (options.shard_count > 1 && !InShard(collectedPaths[i].lexically_relative(directoryPath))) continue;
+
+				collectedPaths[kept] = std::move(collectedPaths[i]);
+				collectedLanguages[kept] = collectedLanguages[i];
+				if (!collectedSizes.empty()) collectedSizes[kept] = collectedSizes[i];
+				++kept;
+			}
+			collectedPaths.resize(kept);
+			collectedLanguages.resize(kept);
+			if (!collectedSizes.empty()) collectedSizes.resize(kept);
+		}
+
 		paths.insert(paths.end(), collectedPaths.begin(), collectedPaths.end());
+		languages.insert(languages.end(), collectedLanguages.begin(), collectedLanguages.end());
+		sizes.insert(sizes.end(), collectedSizes.begin(), collectedSizes.end());
+	}
+	if (listings) listings->Save(options.dir_cache);
+
+	// Number the directories up front, so the workers don't have to look theirs up
+	if (options.tree || options.by_project || options.snapshot)
+	{
+		TraceSpan span{ tracer.get(), "directory tree", "scan" };
+		tree = std::make_unique<DirectoryTree>();
+		for (const auto& root : roots) tree->AddRoot(root);
+		for (size_t i = 0; i < given_files; ++i) tree->AddRoot(paths[i].parent_path());
+		directories.reserve(paths.size());
+		for (const auto& path : paths) directories.push_back(tree->Add(path));
 	}
 }
 
 unsigned long Counter::Count()
 {
+	if (!options.files_from.empty())
+	{
+		return CountStream();
+	}
+
 	// Display the number of files that will be counted
 	std::cout << "Counting " << paths.size() << " files..." << std::endl;
 
+	// Optionally read the files in the order they are stored on disk. A sample is read in random order instead.
+	if (options.read_order != READ_ORDER::None && !options.estimate)
+	{
+		TraceSpan span{ tracer.get(), "read order", "scan" };
+		Reorder(ReadOrder::Order(paths, options.read_order, jobs, options.force_read_order));
+	}
+
 	std::vector<std::jthread> threads;
 
 	// jobs contains the number of threads to start, but we want each thread to count at least 10 files
@@ -59,15 +157,82 @@ unsigned long Counter::Count()
 		}
 	}
 
+	if (options.estimate)
+	{
+		TraceSpan span{ tracer.get(), "prepare sample", "scan" };
+		PrepareSample();
+	}
+
+	// Optionally warm the page cache ahead of the workers, at least a batch per worker, starting
+	// from the batches they have claimed
+	std::optional<Prefetcher> read_ahead{};
+	if (options.prefetch)
+	{
+		read_ahead.emplace(paths, next_index, size_t(jobs) * 10, size_t(jobs) * 10, options.prefetch_window);
+		read_ahead->Start();
+		prefetcher = &*read_ahead;
+	}
+
+	// Optionally report progress from a thread of its own
+	std::optional<ProgressReporter> reporter{};
+	if (options.progress != PROGRESS_FORMAT::None)
+	{
+		reporter.emplace(paths, jobs, options.progress, options.progress_interval, std::cerr);
+		reporter->Start();
+		progress = &*reporter;
+	}
+
+	if (options.tree || options.by_project) tree_partials.assign(jobs, {});
+	if (options.snapshot) snapshot_files.assign(jobs, {});
+	PrepareWorkers(jobs);
+
 	// Start threads
 	for (unsigned int i = 0; i < jobs; ++i) {
-		threads.emplace_back(&Counter::CounterWorker, this);
+		threads.emplace_back(estimator ? &Counter::EstimateWorker : &Counter::CounterWorker, this, i);
 	}
 
-	// Wait for threads to finish
-	for (auto& t : threads) {
-		if (t.joinable()) {
-			t.join();
+	{
+		TraceSpan span{ tracer.get(), "wait for workers", "wait" };
+		if (estimator)
+		{
+			WaitForSample();
+		}
+
+		// Wait for threads to finish
+		for (auto& t : threads) {
+			if (t.joinable()) {
+				t.join();
+			}
+		}
+	}
+	MergeWorkers();
+	prefetcher = nullptr;
+
+	if (options.tree || options.by_project)
+	{
+		TraceSpan span{ tracer.get(), "reduce directory tree", "merge" };
+		tree->Reduce(tree_partials, jobs);
+		tree_partials.clear();
+		if (options.by_project) projects = tree->Projects(project_markers);
+	}
+	WriteTrace();
+
+	if (reporter)
+	{
+		reporter->Stop();
+		progress = nullptr;
+	}
+
+	if (estimator)
+	{
+		// a sample of every file is the exact answer
+		if (estimator->Sampled() == paths.size())
+		{
+			estimator.reset();
+		}
+		else
+		{
+			return static_cast<unsigned long>(std::llround(estimator->TotalCode().value));
 		}
 	}
 
@@ -75,282 +240,761 @@ unsigned long Counter::Count()
 	return total_lines;
 }
 
+unsigned long Counter::CountStream()
+{
+	std::cout << "Counting " << paths.size() << " files and the files listed in " << options.files_from << "..." << std::endl;
+
+	// enough to keep the workers busy while the producer catches up, without holding a huge list
+	PathQueue queue{ 4096 };
+
+	std::optional<ProgressReporter> reporter{};
+	if (options.progress != PROGRESS_FORMAT::None)
+	{
+		static const std::vector<std::filesystem::path> unlisted{};
+		reporter.emplace(unlisted, jobs, options.progress, options.progress_interval, std::cerr);
+		reporter->Start();
+		progress = &*reporter;
+	}
+
+	PrepareWorkers(jobs);
+	std::vector<std::jthread> threads;
+	for (unsigned int i = 0; i < jobs; ++i) {
+		threads.emplace_back(&Counter::StreamWorker, this, std::ref(queue), i);
+	}
+
+	// The files found on the command line go first, then the list as it is read
+	for (auto& path : paths) queue.Push(std::move(path));
+	paths.clear();
+	bool listed = false;
+	{
+		TraceSpan span{ tracer.get(), "read list", "scan", &options.files_from };
+		listed = ReadFileList(queue);
+	}
+	queue.Close();
+
+	{
+		TraceSpan span{ tracer.get(), "wait for workers", "wait" };
+		for (auto& t : threads) {
+			if (t.joinable()) {
+				t.join();
+			}
+		}
+	}
+	MergeWorkers();
+	WriteTrace();
+
+	if (reporter)
+	{
+		reporter->Stop();
+		progress = nullptr;
+	}
+
+	failed = !listed;
+	return total_lines.load();
+}
+
+bool Counter::ReadFileList(PathQueue& queue)
+{
+	std::ifstream file{};
+	if (options.files_from != "-")
+	{
+		file.open(options.files_from, std::ios::binary);
+		if (!file.is_open())
+		{
+			std::cerr << "Error: unable to open file list: " << options.files_from << "\n";
+			return false;
+		}
+	}
+	std::istream& list = options.files_from == "-" ? std::cin : file;
+
+	std::string line{};
+	char separator = options.null_separated ? '\0' : '\n';
+	while (std::getline(list, line, separator))
+	{
+		if (!options.null_separated && !line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty()) continue;
+
+		// lists are UTF-8, like the output of git and find
+		std::filesystem::path path{ std::u8string(line.begin(), line.end()) };
+		if (options.shard_count > 1 && !InShard(path)) continue;
+
+		queue.Push(std::move(path));
+	}
+
+	if (list.bad())
+	{
+		std::cerr << "Error: unable to read file list: " << options.files_from << "\n";
+		return false;
+	}
+	return true;
+}
+
+void Counter::StreamWorker(PathQueue& queue, unsigned int index)
+{
+	Worker& worker = BeginWorker(index);
+	auto started = std::chrono::steady_clock::now();
+
+	// waits for the producer show up in the trace
+	std::vector<std::filesystem::path> batch{};
+	auto next_batch = [&] {
+		TraceSpan span{ tracer.get(), "queue wait", "wait" };
+		return queue.PopBatch(batch, 10);
+	};
+	while (next_batch())
+	{
+		for (const auto& path : batch)
+		{
+			// lists such as git ls-files include files loc doesn't understand; skip them
+			FILE_LANGUAGE language = GetFileLanguage(path);
+			if (language == FILE_LANGUAGE::Other) continue;
+			if (language == FILE_LANGUAGE::Markdown && !options.markdown) continue;
+
+			if (worker.published) worker.published->Begin(WorkerProgress::unlisted);
+			worker.code += CountFile(worker, path, language, DirectoryTree::none);
+		}
+	}
+	worker.stats.busy = std::chrono::steady_clock::now() - started;
+}
+
 void Counter::PrintLanguageBreakdown() const
 {
-	if (language_line_counts.size() == 0) return;
+	if (estimator)
+	{
+		PrintEstimateBreakdown(estimator->Estimate());
+		return;
+	}
+
+	PrintLanguageBreakdown(language_line_counts);
+}
+
+void Counter::PrintLanguageBreakdown(const std::map<FILE_LANGUAGE, LanguageTotals>& counts)
+{
+	if (counts.size() == 0) return;
 
 	// set up cout to print commas in large numbers
 	std::cout.imbue(std::locale(std::cout.getloc(), new comma_numpunct()));
 
-	std::cout << "+-----------------+----------------------+----------------------+\n";
+	const char* separator = "+-----------------+--------------+--------------+--------------+--------------+\n";
+
+	std::cout << separator;
 	std::cout
 		<< "| "
 		<< std::left
 		<< std::setw(15) << "Language" << " | "
-		<< std::right << std::setw(20) << "LoC" << " | "
-		<< std::right << std::setw(20) << "Files" << " |\n";
-	std::cout << "+-----------------+----------------------+----------------------+\n";
+		<< std::right << std::setw(12) << "Code" << " | "
+		<< std::right << std::setw(12) << "Comments" << " | "
+		<< std::right << std::setw(12) << "Blanks" << " | "
+		<< std::right << std::setw(12) << "Files" << " |\n";
+	std::cout << separator;
 
-	for (const auto& [language, count] : language_line_counts)
+	for (const auto& [language, count] : counts)
 	{
-		std::string language_name;
-		switch (language)
+		std::string_view language_name = LanguageRegistry::GetInfo(language).name;
+
+		std::cout
+			<< "| "
+			<< std::left
+			<< std::setw(15) << language_name << " | "
+			<< std::right << std::setw(12) << count.lines.code << " | "
+			<< std::right << std::setw(12) << count.lines.comment << " | "
+			<< std::right << std::setw(12) << count.lines.blank << " | "
+			<< std::right << std::setw(12) << count.files << " |\n";
+	}
+
+	std::cout << separator;
+}
+
+void Counter::PrintEstimateBreakdown(const std::map<FILE_LANGUAGE, LanguageEstimate>& estimates)
+{
+	if (estimates.size() == 0) return;
+
+	// "value +/-x.x%" with commas in the value
+	auto format = [](const EstimatedValue& estimate) {
+		std::ostringstream cell;
+		cell.imbue(std::locale(std::locale::classic(), new comma_numpunct()));
+		cell << std::llround(estimate.value);
+		if (estimate.margin > 0)
 		{
-		case FILE_LANGUAGE::Shell:
-			language_name = "Shell";
-			break;
-		case FILE_LANGUAGE::C:
-			language_name = "C";
-			break;
-		case FILE_LANGUAGE::CHeader:
-			language_name = "C Header";
-			break;
-		case FILE_LANGUAGE::Cpp:
-			language_name = "C++";
-			break;
-		case FILE_LANGUAGE::CS:
-			language_name = "C#";
-			break;
-		case FILE_LANGUAGE::Go:
-			language_name = "Go";
-			break;
-		case FILE_LANGUAGE::Html:
-			language_name = "HTML";
-			break;
-		case FILE_LANGUAGE::Java:
-			language_name = "Java";
-			break;
-		case FILE_LANGUAGE::JavaScript:
-			language_name = "JavaScript";
-			break;
-		case FILE_LANGUAGE::Kotlin:
-			language_name = "Kotlin";
-			break;
-		case FILE_LANGUAGE::Ruby:
-			language_name = "Ruby";
-			break;
-		case FILE_LANGUAGE::Rust:
-			language_name = "Rust";
-			break;
-		case FILE_LANGUAGE::TypeScript:
-			language_name = "TypeScript";
-			break;
-		case FILE_LANGUAGE::PowerShell:
-			language_name = "PowerShell";
-			break;
-		case FILE_LANGUAGE::Python:
-			language_name = "Python";
-			break;
-		case FILE_LANGUAGE::FSharp:
-			language_name = "F#";
-			break;
-		case FILE_LANGUAGE::Xaml:
-			language_name = "XAML";
-			break;
-		case FILE_LANGUAGE::Xml:
-			language_name = "XML";
-			break;
-		default:
-			language_name = "Other";
-			break;
+			cell << " +/-" << std::fixed << std::setprecision(1)
+				<< (estimate.value > 0 ? 100 * estimate.margin / estimate.value : 100.0) << '%';
 		}
+		return cell.str();
+	};
+
+	const char* separator = "+-----------------+--------------------+--------------------+--------------------+--------------------+\n";
+
+	std::cout << separator;
+	std::cout
+		<< "| "
+		<< std::left
+		<< std::setw(15) << "Language" << " | "
+		<< std::right << std::setw(18) << "Code" << " | "
+		<< std::right << std::setw(18) << "Comments" << " | "
+		<< std::right << std::setw(18) << "Blanks" << " | "
+		<< std::right << std::setw(18) << "Files sampled" << " |\n";
+	std::cout << separator;
 
-		std::ostringstream oss;
-		oss.imbue(std::cout.getloc());
-		oss << count.first;
-		std::string line_col = oss.str() + " lines";
+	for (const auto& [language, estimate] : estimates)
+	{
+		std::string_view language_name = LanguageRegistry::GetInfo(language).name;
 
-		oss.str("");
-		oss.clear();
-		oss << count.second;
-		std::string file_col = oss.str() + " files";
+		auto code = format(estimate.code);
+		auto comment = format(estimate.comment);
+		auto blank = format(estimate.blank);
+		std::ostringstream files;
+		files.imbue(std::locale(std::locale::classic(), new comma_numpunct()));
+		files << estimate.sampled << '/' << estimate.files;
 
 		std::cout
 			<< "| "
 			<< std::left
 			<< std::setw(15) << language_name << " | "
-			<< std::right << std::setw(20) << line_col << " | "
-			<< std::right << std::setw(20) << file_col << " |\n";
+			<< std::right << std::setw(18) << code << " | "
+			<< std::right << std::setw(18) << comment << " | "
+			<< std::right << std::setw(18) << blank << " | "
+			<< std::right << std::setw(18) << files.str() << " |\n";
 	}
 
-	std::cout << "+-----------------+----------------------+----------------------+\n";
+	std::cout << separator;
 }
 
-bool Counter::IsDirectory(const std::filesystem::path& path) const
+const std::map<FILE_LANGUAGE, LanguageTotals>& Counter::GetLanguageCounts() const
 {
-	// Check if the path is a directory
-	return std::filesystem::exists(path) && std::filesystem::is_directory(path);
+	return language_line_counts;
 }
 
-unsigned long Counter::CountFile(const std::filesystem::path& path)
+unsigned int Counter::GetSkippedCount(FILE_KIND kind) const
 {
-	// Get the file language
-	FILE_LANGUAGE language = GetFileLanguage(path);
-	unsigned long lines = 0;
+	return skipped[static_cast<size_t>(kind)];
+}
 
-	// use the correct line counting class to count the lines of code in the file
-	if (language == FILE_LANGUAGE::Python || language == FILE_LANGUAGE::Shell)
-	{
-		LineCounter counter;
-		lines = counter.CountLines(path, "#", "", "");
-	}
-	else if (language == FILE_LANGUAGE::PowerShell)
+SkippedCounts Counter::GetSkippedCounts() const
+{
+	SkippedCounts counts{};
+	for (size_t kind = 0; kind < counts.size(); ++kind) counts[kind] = skipped[kind];
+	return counts;
+}
+
+void Counter::PrintSkipped() const
+{
+	PrintSkipped(GetSkippedCounts());
+}
+
+void Counter::PrintSkipped(const SkippedCounts& skipped)
+{
+	std::string summary{};
+	for (auto kind : { FILE_KIND::Binary, FILE_KIND::Minified, FILE_KIND::Generated })
 	{
-		LineCounter counter;
-		lines = counter.CountLines(path, "#", "<#", "#>");
+		if (unsigned int count = skipped[static_cast<size_t>(kind)])
+		{
+			if (!summary.empty()) summary += ", ";
+			summary += std::to_string(count) + " " + std::string(Sniffer::Describe(kind));
+		}
 	}
-	else if (language == FILE_LANGUAGE::Ruby)
+
+	if (!summary.empty())
 	{
-		LineCounter counter;
-		lines = counter.CountLines(path, "#", "=begin", "=end");
+		std::cout << "Skipped " << summary << " (--include-unusual to count them)\n";
 	}
-	else if (language == FILE_LANGUAGE::FSharp)
+}
+
+bool Counter::Failed() const
+{
+	return failed;
+}
+
+bool Counter::Estimated() const
+{
+	return estimator != nullptr;
+}
+
+const Estimator* Counter::GetEstimator() const
+{
+	return estimator.get();
+}
+
+const std::vector<WorkerStats>& Counter::GetWorkerStats() const
+{
+	return worker_stats;
+}
+
+void Counter::PrintStats() const
+{
+	struct NodeTotals
 	{
-		LineCounter counter;
-		lines = counter.CountLines(path, "//", "(*", "*)");
-	}
-	else if (language == FILE_LANGUAGE::Html || language == FILE_LANGUAGE::Xaml || language == FILE_LANGUAGE::Xml)
+		unsigned int workers{};
+		unsigned int files{};
+		unsigned int stolen{};
+		uint64_t bytes{};
+		double busy{};
+	};
+	std::map<int, NodeTotals> nodes{};
+	for (const auto& stats : worker_stats)
 	{
-		LineCounter counter;
-		lines = counter.CountLines(path, "", "<!--", "-->");
+		auto& node = nodes[stats.node];
+		node.workers++;
+		node.files += stats.files;
+		node.stolen += stats.stolen;
+		node.bytes += stats.bytes;
+		node.busy += std::chrono::duration<double>(stats.busy).count();
 	}
-	else
-	{
-		LineCounter counter;
-		lines = counter.CountLines(path, "//", "/*", "*/");
+	if (nodes.empty()) return;
+
+	const char* separator = "+--------+----------+--------------+--------------+--------------+------------+--------------+\n";
+
+	std::cout << separator;
+	std::cout
+		<< "| "
+		<< std::left
+		<< std::setw(6) << "Node" << " | "
+		<< std::right << std::setw(8) << "Workers" << " | "
+		<< std::right << std::setw(12) << "Files" << " | "
+		<< std::right << std::setw(12) << "Stolen" << " | "
+		<< std::right << std::setw(12) << "MB read" << " | "
+		<< std::right << std::setw(10) << "Busy s" << " | "
+		<< std::right << std::setw(12) << "Files/s" << " |\n";
+	std::cout << separator;
+
+	for (const auto& [id, node] : nodes)
+	{
+		// busy is the average of the node's workers, so files/s is the node's throughput
+		double busy = node.busy / node.workers;
+		std::ostringstream seconds;
+		seconds << std::fixed << std::setprecision(2) << busy;
+		std::cout
+			<< "| "
+			<< std::left
+			<< std::setw(6) << (id < 0 ? std::string("all") : std::to_string(id)) << " | "
+			<< std::right << std::setw(8) << node.workers << " | "
+			<< std::right << std::setw(12) << node.files << " | "
+			<< std::right << std::setw(12) << node.stolen << " | "
+			<< std::right << std::setw(12) << std::llround(node.bytes / 1e6) << " | "
+			<< std::right << std::setw(10) << seconds.str() << " | "
+			<< std::right << std::setw(12) << std::llround(busy > 0 ? node.files / busy : 0.0) << " |\n";
 	}
 
-	std::scoped_lock lock(language_line_counts_mutex);
-	language_line_counts[language].first += lines;
-	language_line_counts[language].second++; // File count
+	std::cout << separator;
+}
 
-	return lines;
+const std::vector<FileError>& Counter::GetFileErrors() const
+{
+	return file_errors;
 }
 
-Counter::FILE_LANGUAGE Counter::GetFileLanguage(const std::filesystem::path& path) const
+const DirectoryTree* Counter::GetTree() const
 {
-	std::string extension = path.extension().string();
+	return options.tree ? tree.get() : nullptr;
+}
 
-	if (extension == ".py" || extension == ".pyw")
-	{
-		return FILE_LANGUAGE::Python;
-	}
-	else if (extension == ".fs" || extension == ".fsx")
-	{
-		return FILE_LANGUAGE::FSharp;
-	}
-	else if (extension == ".c")
+const std::vector<DirectoryTree::Project>& Counter::GetProjects() const
+{
+	return projects;
+}
+
+bool Counter::SaveSnapshot(const std::filesystem::path& path)
+{
+	if (!tree) return false;
+
+	std::vector<Snapshot::Entry> files{};
+	for (auto& worker : snapshot_files)
 	{
-		return FILE_LANGUAGE::C;
+		files.insert(files.end(), std::make_move_iterator(worker.begin()), std::make_move_iterator(worker.end()));
 	}
-	else if (extension == ".h")
+	snapshot_files.clear();
+
+	TraceSpan span{ tracer.get(), "save snapshot", "merge" };
+	return Snapshot::Save(path, *tree, std::move(files));
+}
+
+unsigned int Counter::ShardOf(const std::filesystem::path& key, unsigned int shard_count)
+{
+	// FNV-1a over the UTF-8, '/' separated form of the path, so the result is the same on every platform
+	uint64_t hash = 14695981039346656037ull;
+	for (char8_t c : key.lexically_normal().generic_u8string())
 	{
-		return FILE_LANGUAGE::CHeader;
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
 	}
-	else if (extension == ".cpp" || extension == ".hpp" || extension == ".cxx" || extension == ".ino" ||
-		extension == ".hxx" || extension == ".c++" || extension == ".cc" || extension == ".ixx" || extension == ".cppm")
+	return static_cast<unsigned int>(hash % shard_count) + 1;
+}
+
+bool Counter::InShard(const std::filesystem::path& key) const
+{
+	return ShardOf(key, options.shard_count) == options.shard_index;
+}
+
+bool Counter::IsDirectory(const std::filesystem::path& path) const
+{
+	// Check if the path is a directory
+	return std::filesystem::exists(path) && std::filesystem::is_directory(path);
+}
+
+unsigned long Counter::CountFile(Worker& worker, const std::filesystem::path& path, FILE_LANGUAGE language, uint32_t directory)
+{
+	TraceSpan span{ tracer.get(), "file", "file", &path };
+
+	// count the code, comment and blank lines using the lexical rules of the language
+	LineCounts lines = CountFileLines(worker, path, language);
+	if (worker.published) worker.published->Done(worker.counter.LastSize());
+	if (worker.counter.LastKind() != FILE_KIND::Source)
 	{
-		return FILE_LANGUAGE::Cpp;
+		skipped[static_cast<size_t>(worker.counter.LastKind())]++;
+		return 0;
 	}
-	else if (extension == ".cs")
+
+	TraceSpan merge{ tracer.get(), "merge", "merge" };
+	AddFileLines(worker, path, language, directory, lines);
+
+	return lines.code;
+}
+
+void Counter::AddFileLines(Worker& worker, const std::filesystem::path& path, FILE_LANGUAGE language, uint32_t directory, LineCounts lines)
+{
+	// lines of embedded languages, such as the script of an HTML page, count as their own language
+	const auto& embedded = worker.counter.LastEmbedded();
+	for (const auto& part : embedded) lines -= part.lines;
+
+	// the worker's own totals, partial and list, so no lock
+	auto* partial = worker.directories;
+	auto* files = worker.files;
+	if (partial)
 	{
-		return FILE_LANGUAGE::CS;
+		partial->Record(directory, language, lines, 1);
+		for (const auto& part : embedded) partial->Record(directory, part.language, part.lines, 0);
 	}
-	else if (extension == ".go")
+	if (files)
 	{
-		return FILE_LANGUAGE::Go;
+		std::error_code ec;
+		auto modified = std::filesystem::last_write_time(path, ec);
+		auto seconds = ec ? 0 : std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::file_clock::to_sys(modified).time_since_epoch()).count();
+
+		auto utf8 = path.filename().generic_u8string();
+		std::string name(utf8.begin(), utf8.end());
+		files->push_back({ directory, name, language, false, lines, worker.counter.LastSize(), seconds });
+		for (const auto& part : embedded) files->push_back({ directory, name, part.language, true, part.lines, 0, seconds });
 	}
-	else if (extension == ".java")
+
+	for (const auto& part : embedded) worker.languages[static_cast<size_t>(part.language)].lines += part.lines;
+	worker.languages[static_cast<size_t>(language)].lines += lines;
+	worker.languages[static_cast<size_t>(language)].files++;
+}
+
+LineCounts Counter::CountFileLines(Worker& worker, const std::filesystem::path& path, FILE_LANGUAGE language)
+{
+	LineCounts lines{};
+	if (!prefetcher)
 	{
-		return FILE_LANGUAGE::Java;
+		lines = worker.counter.CountLines(path, language);
 	}
-	else if (extension == ".js" || extension == ".jsx")
+	else
 	{
-		return FILE_LANGUAGE::JavaScript;
+		// the prefetcher sizes its window from how long the workers wait for data
+		std::chrono::nanoseconds latency{};
+		lines = worker.counter.CountLines(path, language, &latency);
+		prefetcher->RecordReadLatency(latency);
 	}
-	else if (extension == ".kt" || extension == ".kts")
+
+	worker.stats.files++;
+	worker.stats.bytes += worker.counter.LastSize();
+	if (auto error = worker.counter.LastError()) worker.errors.push_back({ path, error });
+	return lines;
+}
+
+void Counter::Reorder(const std::vector<size_t>& order)
+{
+	if (order.empty()) return;
+
+	// the languages and directories stay with their paths
+	std::vector<std::filesystem::path> ordered{};
+	std::vector<FILE_LANGUAGE> ordered_languages{};
+	std::vector<uint32_t> ordered_directories{};
+	ordered.reserve(order.size());
+	ordered_languages.reserve(order.size());
+	ordered_directories.reserve(directories.size());
+	for (size_t file : order)
+	{
+		ordered.push_back(std::move(paths[file]));
+		ordered_languages.push_back(languages[file]);
+		if (!directories.empty()) ordered_directories.push_back(directories[file]);
+	}
+	paths = std::move(ordered);
+	languages = std::move(ordered_languages);
+	directories = std::move(ordered_directories);
+}
+
+void Counter::PrepareSample()
+{
+	sizes.resize(paths.size());
+
+	// Put the files into sampling order
+	estimator = std::make_unique<Estimator>(languages, sizes, options.estimate_seed);
+	Reorder(estimator->Order());
+}
+
+void Counter::WaitForSample()
+{
+	// below this many files the variance estimates aren't worth trusting
+	constexpr size_t minimum_sample = 30;
+
+	auto started = std::chrono::steady_clock::now();
+	bool reported = false;
+	while (estimator->Sampled() < paths.size())
 	{
-		return FILE_LANGUAGE::Kotlin;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		// report the estimate as it tightens
+		size_t sampled = estimator->Sampled();
+		auto total = estimator->TotalCode();
+		std::cerr << "\rEstimated " << std::llround(total.value) << " +/- " << std::llround(total.margin)
+			<< " lines of code from " << sampled << " of " << paths.size() << " files   " << std::flush;
+		reported = true;
+
+		if (options.time_budget.count() > 0 && std::chrono::steady_clock::now() - started >= options.time_budget) break;
+		if (sampled >= minimum_sample && total.margin <= options.estimate_precision * total.value) break;
 	}
-	else if (extension == ".ps1" || extension == ".psd1" || extension == ".psm1")
+	if (reported) std::cerr << "\n";
+
+	stop_sampling = true;
+}
+
+void Counter::EstimateWorker(unsigned int index)
+{
+	Worker& worker = BeginWorker(index);
+	auto started = std::chrono::steady_clock::now();
+
+	while (!stop_sampling.load(std::memory_order_relaxed))
 	{
-		return FILE_LANGUAGE::PowerShell;
+		size_t next = next_index.fetch_add(1, std::memory_order_relaxed);
+		if (next >= paths.size())
+			break;
+
+		FILE_LANGUAGE language = languages[next];
+		TraceSpan span{ tracer.get(), "file", "file", &paths[next] };
+		if (worker.published) worker.published->Begin(next);
+		LineCounts lines = CountFileLines(worker, paths[next], language);
+		if (worker.published) worker.published->Done(worker.counter.LastSize());
+
+		TraceSpan merge{ tracer.get(), "merge", "merge" };
+		estimator->Record(next, lines);
+		if (worker.counter.LastKind() != FILE_KIND::Source)
+		{
+			skipped[static_cast<size_t>(worker.counter.LastKind())]++;
+			continue;
+		}
+
+		AddFileLines(worker, paths[next], language, directories.empty() ? DirectoryTree::none : directories[next], lines);
+		worker.code += lines.code;
 	}
-	else if (extension == ".rb")
+	worker.stats.busy = std::chrono::steady_clock::now() - started;
+}
+
+FILE_LANGUAGE Counter::GetFileLanguage(const std::filesystem::path& path) const
+{
+	// extensionless files are identified by their shebang
+	return LanguageRegistry::Detect(path);
+}
+
+void Counter::CounterWorker(unsigned int index)
+{
+	Worker& worker = BeginWorker(index);
+	auto started = std::chrono::steady_clock::now();
+
+	// Take 10 files at a time, from the worker's own node while it has any when they are shared out by node
+	size_t begin = 0;
+	size_t end = 0;
+	bool stolen = false;
+	while (node_queues.empty() ? GetNextBatch(begin, end, 10) : GetNodeBatch(worker.node, begin, end, 10, stolen))
 	{
-		return FILE_LANGUAGE::Ruby;
+		if (stolen) worker.stats.stolen += static_cast<unsigned int>(end - begin);
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (worker.published) worker.published->Begin(i);
+
+			// count the lines of code in the file
+			worker.code += CountFile(worker, paths[i], languages[i], directories.empty() ? DirectoryTree::none : directories[i]);
+		}
 	}
-	else if (extension == ".rs")
+	worker.stats.busy = std::chrono::steady_clock::now() - started;
+}
+
+void Counter::PrepareWorkers(unsigned int count)
+{
+	workers = std::vector<Worker>(count);
+	node_queues.clear();
+	if (!options.pin) return;
+
+	topology = Topology::Detect();
+	for (unsigned int i = 0; i < count; ++i) workers[i].node = topology->Place(i).node;
+
+	// the order of the files matters to the prefetcher and to sampling, so they keep one queue
+	if (!prefetcher && !estimator && options.files_from.empty()) ShareByNode();
+}
+
+Counter::Worker& Counter::BeginWorker(unsigned int index)
+{
+	NameWorkerThread(index);
+	Worker& worker = workers[index];
+	if (topology)
 	{
-		return FILE_LANGUAGE::Rust;
+		auto placement = topology->Place(index);
+		if (Topology::Pin(placement.cpu))
+		{
+			worker.stats.node = static_cast<int>(topology->Nodes()[placement.node].id);
+			worker.stats.cpu = static_cast<int>(placement.cpu);
+		}
 	}
-	else if (extension == ".sh" || extension == ".zsh")
+
+	// the counter's buffers are allocated on first use, by this thread and so on its node
+	worker.counter = LineCounter{ !options.include_unusual, tracer.get(), options.fast };
+	worker.published = progress ? &progress->Worker(index) : nullptr;
+	worker.directories = tree_partials.empty() ? nullptr : &tree_partials[index];
+	worker.files = snapshot_files.empty() ? nullptr : &snapshot_files[index];
+	return worker;
+}
+
+void Counter::MergeWorkers()
+{
+	worker_stats.clear();
+	for (const auto& worker : workers)
 	{
-		return FILE_LANGUAGE::Shell;
+		for (size_t i = 0; i < worker.languages.size(); ++i)
+		{
+			const auto& totals = worker.languages[i];
+			if (totals.files == 0 && totals.lines.total == 0) continue;
+
+			auto& merged = language_line_counts[static_cast<FILE_LANGUAGE>(i)];
+			merged.lines += totals.lines;
+			merged.files += totals.files;
+		}
+		total_lines += worker.code;
+		worker_stats.push_back(worker.stats);
+		file_errors.insert(file_errors.end(), worker.errors.begin(), worker.errors.end());
 	}
-	else if (extension == ".ts" || extension == ".tsx")
+	workers.clear();
+
+	// reported once the workers are done, in the same order whichever worker met them
+	std::sort(file_errors.begin(), file_errors.end(), [](const FileError& a, const FileError& b) { return a.path < b.path; });
+	for (const auto& failed : file_errors)
 	{
-		return FILE_LANGUAGE::TypeScript;
+		std::cerr << "Error: unable to read file: " << failed.path << " (" << failed.error.message() << ")\n";
 	}
-	else if (extension == ".xml")
-	{
-		return FILE_LANGUAGE::Xml;
+}
+
+void Counter::ShareByNode()
+{
+	// in proportion to the node's workers, and in one piece, so a node reads files that are near each other
+	size_t node_count = topology->Nodes().size();
+	std::vector<size_t> node_workers(node_count);
+	for (const auto& worker : workers) node_workers[worker.node]++;
+
+	node_queues = std::vector<NodeQueue>(node_count);
+	size_t begin = 0;
+	size_t placed = 0;
+	for (size_t node = 0; node < node_count; ++node)
+	{
+		placed += node_workers[node];
+		size_t end = paths.size() * placed / workers.size();
+		node_queues[node].next = begin;
+		node_queues[node].end = end;
+		begin = end;
 	}
-	else if (extension == ".html")
+}
+
+bool Counter::GetNodeBatch(unsigned int node, size_t& begin, size_t& end, size_t max_paths, bool& stolen)
+{
+	// the worker's own node first, then the others in turn. A node that has run out is only read, so its
+	// cache line isn't pulled from node to node by the workers that find it empty.
+	for (size_t i = 0; i < node_queues.size(); ++i)
 	{
-		return FILE_LANGUAGE::Html;
+		auto& queue = node_queues[(node + i) % node_queues.size()];
+		if (queue.next.load(std::memory_order_relaxed) >= queue.end) continue;
+
+		begin = queue.next.fetch_add(max_paths, std::memory_order_relaxed);
+		if (begin >= queue.end) continue;
+
+		end = std::min(begin + max_paths, queue.end);
+		stolen = i != 0;
+		return true;
 	}
-	else if (extension == ".xaml")
+	return false;
+}
+
+void Counter::NameWorkerThread(unsigned int worker)
+{
+	if (tracer) tracer->NameThread("worker " + std::to_string(worker));
+}
+
+void Counter::WriteTrace()
+{
+	if (!tracer) return;
+
+	if (!tracer->Write(options.trace))
 	{
-		return FILE_LANGUAGE::Xaml;
+		std::cerr << "Error: unable to write trace file: " << options.trace << "\n";
 	}
-	else
+	else if (size_t dropped = tracer->Dropped())
 	{
-		return FILE_LANGUAGE::Other;
+		std::cerr << "Warning: the trace lost its " << dropped << " oldest events; only the most recent "
+			<< Tracer::default_capacity << " per thread were kept\n";
 	}
 }
 
-void Counter::CounterWorker()
+void Counter::RemoveOverlaps(std::vector<std::filesystem::path>& directories, std::vector<std::filesystem::path>& files)
 {
-	std::string path{};
+	// a single root or file can't overlap anything, so the common case costs nothing
+	if (directories.size() + files.size() <= 1) return;
 
-	while (next_index < paths.size())
-	{
-		// Get 10 paths to process
-		std::vector<std::filesystem::path> paths_to_process{};
-		GetNextPaths(paths_to_process, 10);
+	auto canonical = [](const std::filesystem::path& path) {
+		std::error_code ec;
+		auto result = std::filesystem::weakly_canonical(path, ec);
+		return ec ? std::filesystem::absolute(path).lexically_normal() : result;
+	};
 
-		for (const auto& current_path : paths_to_process)
-		{
-			// count the lines of code in the file
-			unsigned long lines = CountFile(current_path);
+	// Sorted element by element, a directory comes right before everything inside it,
+	// so a root nested in another (or repeated) always follows a root that is kept
+	struct Root
+	{
+		std::filesystem::path canonical;
+		size_t index;
+	};
+	std::vector<Root> roots{};
+	for (size_t i = 0; i < directories.size(); ++i) roots.push_back({ canonical(directories[i]), i });
+	std::stable_sort(roots.begin(), roots.end(), [](const Root& a, const Root& b) { return a.canonical < b.canonical; });
 
-			// add to total
-			total_lines += lines;
-		}
+	std::vector<Root> kept{};
+	for (auto& root : roots)
+	{
+		if (kept.empty() || !IsWithin(kept.back().canonical, root.canonical)) kept.push_back(std::move(root));
 	}
-}
 
-bool Counter::isFileInDirectory(const std::filesystem::path& parentDir, const std::filesystem::path& filePath) const
-{
-	if (!std::filesystem::exists(parentDir) || !std::filesystem::is_directory(parentDir))
+	// keep the roots as they were given, in the order they were given
+	std::vector<bool> keep(directories.size());
+	for (const auto& root : kept) keep[root.index] = true;
+	size_t next = 0;
+	for (size_t i = 0; i < directories.size(); ++i)
 	{
-		return false;
+		if (keep[i]) directories[next++] = std::move(directories[i]);
 	}
+	directories.resize(next);
 
-	auto parentAbs = std::filesystem::absolute(parentDir);
-	auto fileAbs = std::filesystem::absolute(filePath);
+	// Files inside a root will be found by the scan, and files given twice only count once
+	std::unordered_set<std::filesystem::path::string_type> seen{};
+	std::erase_if(files, [&](const std::filesystem::path& file) {
+		auto path = canonical(file);
 
-	// Check if file exists
-	if (!std::filesystem::exists(fileAbs))
-	{
-		return false;
-	}
+		// the only root that can contain the file is the last one that sorts before it
+		auto after = std::upper_bound(kept.begin(), kept.end(), path, [](const std::filesystem::path& p, const Root& root) { return p < root.canonical; });
+		if (after != kept.begin() && IsWithin(std::prev(after)->canonical, path)) return true;
 
-	// Check if file is within the parent directory or any of its subdirectories
-	auto relativePath = fileAbs.lexically_relative(parentAbs);
+		return !seen.insert(path.native()).second;
+	});
+}
 
-	return !relativePath.empty() && relativePath.string()[0] != '.';
+bool Counter::IsWithin(const std::filesystem::path& parent, const std::filesystem::path& child)
+{
+	// compares whole path elements, so "src" doesn't contain "src2"
+	return std::mismatch(parent.begin(), parent.end(), child.begin(), child.end()).first == parent.end();
 }
 
 void Counter::expandAllGlobsInPaths(const std::vector<std::filesystem::path>& paths_to_expand)
@@ -366,13 +1010,12 @@ void Counter::expandAllGlobsInPaths(const std::vector<std::filesystem::path>& pa
 	}
 }
 
-void Counter::GetNextPaths(std::vector<std::filesystem::path>& out_paths, int max_paths)
+bool Counter::GetNextBatch(size_t& begin, size_t& end, size_t max_paths)
 {
-	for (int i = 0; i < max_paths; i++)
-	{
-		size_t next = next_index.fetch_add(1, std::memory_order_relaxed);
-		if (next >= paths.size())
-			return;
-		out_paths.push_back(paths[next]);
-	}
+	begin = next_index.fetch_add(max_paths, std::memory_order_relaxed);
+	if (begin >= paths.size())
+		return false;
+
+	end = std::min(begin + max_paths, paths.size());
+	return true;
 }
@@ -0,0 +1,257 @@
+#include "DirectoryCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	constexpr char magic[8] = { 'L', 'O', 'C', 'D', 'I', 'R', 'S', '\0' };
+
+	// reads back as something else on a machine of the other byte order
+	constexpr uint64_t byte_order = 0x0102030405060708;
+
+	// no name or settings comes near this; a larger length means a corrupt file
+	constexpr uint64_t longest_string = 1 << 20;
+
+	// how long after a change a directory is still left out of the cache
+	constexpr std::chrono::seconds settle_time{ 2 };
+
+	void WriteNumber(std::ostream& out, uint64_t value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	void WriteString(std::ostream& out, const std::string& text)
+	{
+		WriteNumber(out, text.size());
+		out.write(text.data(), static_cast<std::streamsize>(text.size()));
+	}
+
+	void WritePath(std::ostream& out, const std::filesystem::path& path)
+	{
+		auto text = path.u8string();
+		WriteString(out, std::string(text.begin(), text.end()));
+	}
+
+	bool ReadNumber(std::istream& in, uint64_t& value)
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+	}
+
+	bool ReadString(std::istream& in, std::string& text)
+	{
+		uint64_t length = 0;
+		if (!ReadNumber(in, length) || length > longest_string) return false;
+		text.resize(static_cast<size_t>(length));
+		return static_cast<bool>(in.read(text.data(), static_cast<std::streamsize>(length)));
+	}
+
+	bool ReadPath(std::istream& in, std::filesystem::path& path)
+	{
+		std::string text{};
+		if (!ReadString(in, text)) return false;
+		path = std::u8string(text.begin(), text.end());
+		return true;
+	}
+
+	bool ReadPaths(std::istream& in, std::vector<std::filesystem::path>& paths)
+	{
+		uint64_t count = 0;
+		if (!ReadNumber(in, count) || count > longest_string) return false;
+		paths.resize(static_cast<size_t>(count));
+		for (auto& path : paths)
+		{
+			if (!ReadPath(in, path)) return false;
+		}
+		return true;
+	}
+}
+
+void DirectoryCache::Load(const std::filesystem::path& file)
+{
+	entries.clear();
+	settings.clear();
+
+	std::ifstream in{ file, std::ios::binary };
+	if (!in.is_open()) return;
+
+	// read everything first, so a bad file leaves the cache empty rather than half filled
+	char header[sizeof(magic)]{};
+	uint64_t file_version = 0;
+	uint64_t file_byte_order = 0;
+	uint64_t count = 0;
+	std::string file_settings{};
+	decltype(entries) loaded{};
+	bool valid = in.read(header, sizeof(header)) && std::memcmp(header, magic, sizeof(magic)) == 0 &&
+		ReadNumber(in, file_version) && file_version == version &&
+		ReadNumber(in, file_byte_order) && file_byte_order == byte_order &&
+		ReadString(in, file_settings) && ReadNumber(in, count);
+	for (uint64_t i = 0; valid && i < count; ++i)
+	{
+		std::filesystem::path directory{};
+		Entry entry{};
+		auto& stamp = entry.listing.stamp;
+		uint64_t modified = 0;
+		uint64_t changed = 0;
+		uint64_t sized = 0;
+		uint64_t marked = 0;
+		uint64_t project = 0;
+		valid = ReadPath(in, directory) &&
+			ReadNumber(in, stamp.device) && ReadNumber(in, stamp.inode) && ReadNumber(in, modified) && ReadNumber(in, changed) &&
+			ReadPaths(in, entry.listing.subdirectories) && ReadPaths(in, entry.listing.files) &&
+			ReadNumber(in, project) && ReadNumber(in, marked) && ReadNumber(in, sized);
+		stamp.modified = static_cast<int64_t>(modified);
+		stamp.changed = static_cast<int64_t>(changed);
+		entry.listing.project = project != 0;
+		entry.listing.marked = marked != 0;
+		entry.listing.sized = sized != 0;
+		if (valid)
+		{
+			entry.listing.languages.resize(entry.listing.files.size());
+			for (auto& language : entry.listing.languages)
+			{
+				uint64_t value = 0;
+				valid = valid && ReadNumber(in, value) && value < LanguageRegistry::language_count;
+				language = static_cast<FILE_LANGUAGE>(value);
+			}
+		}
+		if (valid && entry.listing.sized)
+		{
+			entry.listing.sizes.resize(entry.listing.files.size());
+			for (auto& size : entry.listing.sizes)
+			{
+				uint64_t value = 0;
+				valid = valid && ReadNumber(in, value);
+				size = static_cast<uintmax_t>(value);
+			}
+		}
+		if (valid) loaded.emplace(directory.native(), std::move(entry));
+	}
+
+	if (!valid)
+	{
+		std::cerr << "Warning: ignoring unreadable directory cache (version " << version << "): " << file << "\n";
+		return;
+	}
+
+	settings = std::move(file_settings);
+	entries = std::move(loaded);
+}
+
+bool DirectoryCache::Save(const std::filesystem::path& file) const
+{
+	std::ofstream out{ file, std::ios::binary | std::ios::trunc };
+	if (!out.is_open())
+	{
+		std::cerr << "Error: unable to write directory cache: " << file << "\n";
+		return false;
+	}
+
+	uint64_t count = 0;
+	for (const auto& [directory, entry] : entries) count += entry.used;
+
+	out.write(magic, sizeof(magic));
+	WriteNumber(out, version);
+	WriteNumber(out, byte_order);
+	WriteString(out, settings);
+	WriteNumber(out, count);
+	for (const auto& [directory, entry] : entries)
+	{
+		if (!entry.used) continue;
+
+		const auto& listing = entry.listing;
+		WritePath(out, std::filesystem::path(directory));
+		WriteNumber(out, listing.stamp.device);
+		WriteNumber(out, listing.stamp.inode);
+		WriteNumber(out, static_cast<uint64_t>(listing.stamp.modified));
+		WriteNumber(out, static_cast<uint64_t>(listing.stamp.changed));
+		WriteNumber(out, listing.subdirectories.size());
+		for (const auto& subdirectory : listing.subdirectories) WritePath(out, subdirectory);
+		WriteNumber(out, listing.files.size());
+		for (const auto& name : listing.files) WritePath(out, name);
+		WriteNumber(out, listing.project);
+		WriteNumber(out, listing.marked);
+		WriteNumber(out, listing.sized);
+		for (auto language : listing.languages) WriteNumber(out, static_cast<uint64_t>(language));
+		if (listing.sized)
+		{
+			for (auto size : listing.sizes) WriteNumber(out, size);
+		}
+	}
+
+	if (!out)
+	{
+		std::cerr << "Error: unable to write directory cache: " << file << "\n";
+		return false;
+	}
+	return true;
+}
+
+void DirectoryCache::UseSettings(const std::string& settings)
+{
+	if (settings == this->settings) return;
+
+	entries.clear();
+	this->settings = settings;
+}
+
+bool DirectoryCache::StampOf(const std::filesystem::path& directory, Stamp& stamp)
+{
+#ifdef __linux__
+	struct stat status{};
+	if (::stat(directory.c_str(), &status) != 0) return false;
+
+	stamp.device = status.st_dev;
+	stamp.inode = status.st_ino;
+	stamp.modified = int64_t{ status.st_mtim.tv_sec } * 1'000'000'000 + status.st_mtim.tv_nsec;
+	stamp.changed = int64_t{ status.st_ctim.tv_sec } * 1'000'000'000 + status.st_ctim.tv_nsec;
+	return true;
+#else
+	(void)directory;
+	(void)stamp;
+	return false;
+#endif
+}
+
+const DirectoryCache::Listing* DirectoryCache::Find(const std::filesystem::path& directory, const Stamp& stamp, bool sized, bool marked)
+{
+	auto found = entries.find(directory.native());
+	if (found == entries.end() || found->second.listing.stamp != stamp || (sized && !found->second.listing.sized) ||
+		(marked && !found->second.listing.marked))
+	{
+		misses++;
+		return nullptr;
+	}
+
+	hits++;
+	found->second.used = true;
+	return &found->second.listing;
+}
+
+void DirectoryCache::Store(const std::filesystem::path& directory, Listing listing)
+{
+	auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch());
+	if (now - std::chrono::nanoseconds(listing.stamp.modified) < settle_time)
+	{
+		entries.erase(directory.native());
+		return;
+	}
+
+	entries[directory.native()] = { std::move(listing), true };
+}
+
+size_t DirectoryCache::Hits() const
+{
+	return hits;
+}
+
+size_t DirectoryCache::Misses() const
+{
+	return misses;
+}
@@ -1,30 +1,61 @@
 #include "DirectoryScanner.h"
+#include "LanguageRegistry.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cctype>
+#include <fstream>
 #include <string_view>
 #include <system_error>
 #include <unordered_set>
+#include <utility>
+
+namespace
+{
+    // Most directories of a CMake project have a CMakeLists.txt; only one that calls project() starts a project
+    bool DeclaresCMakeProject(const std::filesystem::path& file)
+    {
+        std::ifstream in{ file, std::ios::binary };
+        std::string text(64 * 1024, '\0');
+        in.read(text.data(), static_cast<std::streamsize>(text.size()));
+        text.resize(static_cast<size_t>(in.gcount()));
+        for (auto& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+        auto is_name = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+        constexpr std::string_view command = "project";
+        for (size_t at = text.find(command); at != std::string::npos; at = text.find(command, at + 1)) {
+            if (at > 0 && is_name(text[at - 1])) continue;
+            size_t open = text.find_first_not_of(" \t", at + command.size());
+            if (open != std::string::npos && text[open] == '(') return true;
+        }
+        return false;
+    }
+
+    // The directory a path names, without a trailing separator, the same as a scanned file's parent_path()
+    std::filesystem::path DirectoryKey(const std::filesystem::path& directory)
+    {
+        return directory.has_filename() || !directory.has_relative_path() ? directory : directory.parent_path();
+    }
+}
+
+DirectoryScanner::DirectoryScanner(Tracer* tracer, DirectoryCache* cache, const ScanFilter& filter)
+    : tracer(tracer), cache(cache), filter(filter)
+{
+}
 
 std::vector<std::filesystem::path> DirectoryScanner::Scan(
     const std::filesystem::path& root,
     const std::vector<std::filesystem::path>& ignore_dir_names,
     bool case_insensitive,
     bool follow_directory_symlinks,
-    size_t reserve_result)
+    size_t reserve_result,
+    std::vector<uintmax_t>* sizes,
+    std::vector<std::filesystem::path>* projects,
+    std::vector<FILE_LANGUAGE>* languages)
 {
     std::vector<std::filesystem::path> result;
     if (reserve_result) result.reserve(reserve_result);
 
-    // Build normalized extension set
-    std::unordered_set<std::string> ext_set;
-    ext_set.reserve(24);
-    for (const auto& e : supported_extensions) {
-        auto ne = normalize_ext(e, case_insensitive);
-        if (!ne.empty()) ext_set.insert(std::move(ne));
-    }
-    if (ext_set.empty()) return result; // nothing to match
-
     // Build ignore dir set (normalized per case setting)
     std::unordered_set<std::string> ignore_set;
     ignore_set.reserve(ignore_dir_names.size() * 2 + 4);
@@ -34,6 +65,18 @@ std::vector<std::filesystem::path> DirectoryScanner::Scan(
         else ignore_set.insert(d.string());
     }
 
+    if (cache) {
+        // the listings depend on what is ignored and how
+        std::vector<std::string> ignored(ignore_set.begin(), ignore_set.end());
+        std::sort(ignored.begin(), ignored.end());
+        std::string settings = std::string(case_insensitive ? "i" : "c") + (follow_directory_symlinks ? "f" : "n");
+        for (const auto& name : ignored) settings += '\0' + name;
+        cache->UseSettings(settings);
+
+        ScanWithCache(root, ignore_set, case_insensitive, follow_directory_symlinks, result, sizes, projects, languages);
+        return result;
+    }
+
     std::error_code ec; // avoid exceptions from filesystem
     std::filesystem::directory_options opts = std::filesystem::directory_options::skip_permission_denied;
 
@@ -48,12 +91,25 @@ std::vector<std::filesystem::path> DirectoryScanner::Scan(
     }
     const std::filesystem::recursive_directory_iterator end_it;
 
+    // When tracing, each run of entries from one directory is a span. The walk is depth first,
+    // so a directory's entries can be split into several spans around its subdirectories.
+    int traced_depth = -1;
+    std::filesystem::path traced_directory;
+    std::chrono::steady_clock::time_point traced_since;
+
     for (; it != end_it; ++it) {
         // Protect against filesystem errors per-entry
         std::error_code entry_ec;
 
         const std::filesystem::directory_entry& de = *it;
 
+        if (tracer && it.depth() != traced_depth) {
+            if (traced_depth >= 0) tracer->Record("directory", "scan", traced_since, &traced_directory);
+            traced_depth = it.depth();
+            traced_directory = de.path().parent_path();
+            traced_since = std::chrono::steady_clock::now();
+        }
+
         // If it's a directory and matches ignore list, skip recursion into it.
         if (de.is_directory(entry_ec)) {
             if (entry_ec) { /* skip problematic entry */ continue; }
@@ -75,6 +131,11 @@ std::vector<std::filesystem::path> DirectoryScanner::Scan(
                 continue;
             }
 
+            // its files would be a level deeper than this entry
+            if (static_cast<unsigned int>(it.depth()) >= filter.max_depth) {
+                it.disable_recursion_pending();
+            }
+
             // not a file -> continue
             continue;
         }
@@ -84,18 +145,167 @@ std::vector<std::filesystem::path> DirectoryScanner::Scan(
             continue;
         }
 
-        // get extension and test
-        std::string ext = de.path().extension().string();
-        if (case_insensitive) ext = to_lower_ascii(ext);
-        if (ext_set.find(ext) != ext_set.end()) {
-            // matched; append path (store as std::filesystem::path to avoid forcing string encoding prematurely)
-            result.emplace_back(de.path());
+        // match on extension, or look for a shebang if the file has no extension
+        const auto& path = de.path();
+        if (projects && IsProjectMarker(path)) projects->push_back(path.parent_path());
+        bool has_extension = LanguageRegistry::HasExtension(path);
+        FILE_LANGUAGE language = has_extension ? LanguageRegistry::FromPath(path, case_insensitive) : FILE_LANGUAGE::Other;
+        if (has_extension && language == FILE_LANGUAGE::Other) {
+            continue;
+        }
+
+        // the filter goes by metadata, before a shebang is looked for, so the files it leaves out aren't opened
+        uintmax_t size = 0;
+        int64_t modified = 0;
+        bool stated = filter.NeedsMetadata();
+        if (stated && (!ScanFilter::Metadata(path, size, modified) || !filter.Admits(size, modified))) {
+            continue;
+        }
+        if (!has_extension) language = LanguageRegistry::FromShebang(path);
+        if (language == FILE_LANGUAGE::Other) {
+            continue;
+        }
+
+        // matched; append path (store as std::filesystem::path to avoid forcing string encoding prematurely)
+        result.emplace_back(path);
+        if (languages) languages->push_back(language);
+        if (sizes) {
+            if (!stated) {
+                size = de.file_size(entry_ec);
+                if (entry_ec) size = 0;
+            }
+            sizes->push_back(size);
         }
     }
+    if (tracer && traced_depth >= 0) tracer->Record("directory", "scan", traced_since, &traced_directory);
 
     return result;
 }
 
+void DirectoryScanner::ScanWithCache(
+    const std::filesystem::path& root,
+    const std::unordered_set<std::string>& ignore_set,
+    bool case_insensitive,
+    bool follow_directory_symlinks,
+    std::vector<std::filesystem::path>& result,
+    std::vector<uintmax_t>* sizes,
+    std::vector<std::filesystem::path>* projects,
+    std::vector<FILE_LANGUAGE>* languages)
+{
+    // Depth first, like the walk without a cache: one stat per directory, and a read only of those that changed.
+    // Listings are kept unfiltered, as a file's size and age can change without its directory changing, so
+    // the filter is applied to them as they are replayed; each directory is queued with its depth.
+    bool stated = filter.NeedsMetadata();
+    std::vector<std::pair<std::filesystem::path, unsigned int>> pending{ { root, 0 } };
+    while (!pending.empty()) {
+        auto [directory, depth] = std::move(pending.back());
+        pending.pop_back();
+        auto since = tracer ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+
+        DirectoryCache::Stamp stamp{};
+        bool stamped = DirectoryCache::StampOf(directory, stamp);
+        const DirectoryCache::Listing* cached = stamped ? cache->Find(directory, stamp, sizes != nullptr, projects != nullptr) : nullptr;
+
+        DirectoryCache::Listing fresh{};
+        if (!cached) {
+            fresh = List(directory, ignore_set, case_insensitive, follow_directory_symlinks, sizes != nullptr, projects != nullptr);
+            fresh.stamp = stamp;
+        }
+        const auto& listing = cached ? *cached : fresh;
+
+        if (projects && listing.project) projects->push_back(DirectoryKey(directory));
+        for (size_t i = 0; i < listing.files.size(); ++i) {
+            auto path = directory / listing.files[i];
+            uintmax_t size = 0;
+            int64_t modified = 0;
+            if (stated && (!ScanFilter::Metadata(path, size, modified) || !filter.Admits(size, modified))) continue;
+
+            result.push_back(std::move(path));
+            if (sizes) sizes->push_back(stated ? size : listing.sizes[i]);
+            if (languages) languages->push_back(listing.languages[i]);
+        }
+        if (depth < filter.max_depth) {
+            for (auto subdirectory = listing.subdirectories.rbegin(); subdirectory != listing.subdirectories.rend(); ++subdirectory) {
+                pending.push_back({ directory / *subdirectory, depth + 1 });
+            }
+        }
+
+        if (tracer) tracer->Record(cached ? "cached directory" : "directory", "scan", since, &directory);
+        if (!cached && stamped) cache->Store(directory, std::move(fresh));
+    }
+}
+
+DirectoryCache::Listing DirectoryScanner::List(
+    const std::filesystem::path& directory,
+    const std::unordered_set<std::string>& ignore_set,
+    bool case_insensitive,
+    bool follow_directory_symlinks,
+    bool sized,
+    bool marked)
+{
+    DirectoryCache::Listing listing{};
+    listing.sized = sized;
+    listing.marked = marked;
+
+    // the same choices as the walk without a cache, for the entries of one directory
+    std::error_code ec;
+    std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (const std::filesystem::directory_iterator end_it; !ec && it != end_it; it.increment(ec)) {
+        std::error_code entry_ec;
+        const std::filesystem::directory_entry& de = *it;
+        auto name = de.path().filename();
+
+        if (de.is_directory(entry_ec)) {
+            if (entry_ec) continue;
+            if (!follow_directory_symlinks && de.is_symlink(entry_ec)) continue;
+
+            auto dirname = name.string();
+            if (!ignore_set.empty()) {
+                auto key = case_insensitive ? to_lower_ascii(dirname) : dirname;
+                if (ignore_set.find(key) != ignore_set.end()) continue;
+            }
+            if (!dirname.empty() && dirname[0] == '.') continue;
+
+            listing.subdirectories.push_back(std::move(name));
+            continue;
+        }
+
+        if (!de.is_regular_file(entry_ec)) {
+            continue;
+        }
+
+        const auto& path = de.path();
+        // a CMakeLists.txt is read to tell, so only when projects are asked for
+        if (marked && !listing.project && IsProjectMarker(path)) listing.project = true;
+
+        FILE_LANGUAGE language = LanguageRegistry::HasExtension(path)
+            ? LanguageRegistry::FromPath(path, case_insensitive)
+            : LanguageRegistry::FromShebang(path);
+        if (language != FILE_LANGUAGE::Other) {
+            listing.files.push_back(std::move(name));
+            listing.languages.push_back(language);
+            if (sized) {
+                auto size = de.file_size(entry_ec);
+                listing.sizes.push_back(entry_ec ? 0 : size);
+            }
+        }
+    }
+
+    return listing;
+}
+
+bool DirectoryScanner::IsProjectMarker(const std::filesystem::path& file)
+{
+    static const std::unordered_set<std::string> names{
+        "package.json", "Cargo.toml", "go.mod", "pyproject.toml", "setup.py", "pom.xml", "build.gradle",
+        "build.gradle.kts", "meson.build", "composer.json", "Gemfile", "Package.swift", "mix.exs", "pubspec.yaml" };
+    static const std::unordered_set<std::string> extensions{ ".csproj", ".fsproj", ".vbproj", ".vcxproj" };
+
+    auto name = file.filename().string();
+    if (name == "CMakeLists.txt") return DeclaresCMakeProject(file);
+    return names.contains(name) || extensions.contains(file.extension().string());
+}
+
 std::string DirectoryScanner::to_lower_ascii(std::string_view s)
 {
     std::string out;
@@ -103,19 +313,3 @@ std::string DirectoryScanner::to_lower_ascii(std::string_view s)
     for (unsigned char c : s) out.push_back(static_cast<char>(std::tolower(c)));
     return out;
 }
-
-std::string DirectoryScanner::normalize_ext(std::string_view ext, bool case_insensitive)
-{
-    if (ext.empty()) return std::string{};
-    // if user passed "txt" convert to ".txt"
-    if (ext.front() != '.') {
-        std::string tmp;
-        tmp.reserve(ext.size() + 1);
-        tmp.push_back('.');
-        tmp.append(ext);
-        if (case_insensitive) return to_lower_ascii(tmp);
-        return tmp;
-    }
-    if (case_insensitive) return to_lower_ascii(ext);
-    return std::string(ext);
-}
@@ -0,0 +1,320 @@
+#include "DirectoryTree.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <thread>
+#include <unordered_set>
+
+namespace
+{
+	// Below this many directories a level isn't worth starting threads for
+	constexpr size_t parallel_threshold = 4096;
+
+	// Calls work(begin, end) over [0, count) split between up to jobs threads
+	template <typename Work>
+	void ParallelFor(size_t count, unsigned int jobs, const Work& work)
+	{
+		if (count < parallel_threshold || jobs <= 1)
+		{
+			work(size_t{ 0 }, count);
+			return;
+		}
+
+		std::vector<std::jthread> threads{};
+		size_t step = (count + jobs - 1) / jobs;
+		for (size_t begin = 0; begin < count; begin += step)
+		{
+			threads.emplace_back([&work, begin, end = std::min(count, begin + step)] { work(begin, end); });
+		}
+	}
+
+	// The directory a path names, without a trailing separator, so "src/" and "src" are the same directory
+	std::filesystem::path DirectoryKey(const std::filesystem::path& directory)
+	{
+		if (!directory.has_filename() && directory.has_relative_path()) return directory.parent_path();
+		return directory;
+	}
+}
+
+void DirectoryTree::Partial::Record(uint32_t directory, FILE_LANGUAGE language, const LineCounts& lines, unsigned int files)
+{
+	if (directory == none) return;
+
+	auto& totals = this->totals[uint64_t{ directory } << 8 | static_cast<uint64_t>(language)];
+	totals.language = language;
+	totals.lines += lines;
+	totals.files += files;
+}
+
+uint32_t DirectoryTree::AddRoot(const std::filesystem::path& directory)
+{
+	return Insert(DirectoryKey(directory), true);
+}
+
+uint32_t DirectoryTree::Add(const std::filesystem::path& file)
+{
+	return Insert(file.parent_path(), false);
+}
+
+uint32_t DirectoryTree::Insert(const std::filesystem::path& directory, bool root)
+{
+	auto found = ids.find(directory.native());
+	if (found != ids.end()) return found->second;
+
+	// parents are numbered before their children
+	uint32_t parent = none;
+	uint32_t depth = 0;
+	auto above = directory.parent_path();
+	if (!root && !directory.empty() && above != directory)
+	{
+		parent = Insert(above, false);
+		depth = nodes[parent].depth + 1;
+	}
+
+	auto id = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({ parent, depth, directory, {} });
+	ids.emplace(directory.native(), id);
+	return id;
+}
+
+uint32_t DirectoryTree::DirectoryOf(const std::filesystem::path& file) const
+{
+	auto found = ids.find(file.parent_path().native());
+	return found == ids.end() ? none : found->second;
+}
+
+size_t DirectoryTree::Size() const
+{
+	return nodes.size();
+}
+
+uint32_t DirectoryTree::Parent(uint32_t directory) const
+{
+	return nodes[directory].parent;
+}
+
+const std::filesystem::path& DirectoryTree::Path(uint32_t directory) const
+{
+	return nodes[directory].path;
+}
+
+void DirectoryTree::Merge(std::vector<LanguageLines>& into, const LanguageLines& lines)
+{
+	for (auto& existing : into)
+	{
+		if (existing.language == lines.language)
+		{
+			existing.lines += lines.lines;
+			existing.files += lines.files;
+			return;
+		}
+	}
+	into.push_back(lines);
+}
+
+void DirectoryTree::Subtract(std::vector<LanguageLines>& from, const LanguageLines& lines)
+{
+	for (auto& existing : from)
+	{
+		if (existing.language == lines.language)
+		{
+			existing.lines -= lines.lines;
+			existing.files -= lines.files;
+			return;
+		}
+	}
+}
+
+void DirectoryTree::Reduce(const std::vector<Partial>& partials, unsigned int jobs)
+{
+	// Each thread takes the directories whose number it owns from every partial, so no two write the same one
+	unsigned int owners = nodes.size() < parallel_threshold ? 1 : std::max(jobs, 1u);
+	auto collect = [&](unsigned int owner) {
+		for (const auto& partial : partials)
+		{
+			for (const auto& [key, lines] : partial.totals)
+			{
+				auto directory = static_cast<uint32_t>(key >> 8);
+				if (directory % owners == owner) Merge(nodes[directory].languages, lines);
+			}
+		}
+	};
+	if (owners == 1)
+	{
+		collect(0);
+	}
+	else
+	{
+		std::vector<std::jthread> threads{};
+		for (unsigned int owner = 0; owner < owners; ++owner) threads.emplace_back(collect, owner);
+	}
+
+	// Children of each directory, and the directories at each depth
+	uint32_t max_depth = 0;
+	for (const auto& node : nodes) max_depth = std::max(max_depth, node.depth);
+	std::vector<std::vector<uint32_t>> levels(max_depth + 1);
+	std::vector<uint32_t> child_begin(nodes.size() + 1, 0);
+	for (uint32_t id = 0; id < nodes.size(); ++id)
+	{
+		levels[nodes[id].depth].push_back(id);
+		if (nodes[id].parent != none) child_begin[nodes[id].parent + 1]++;
+	}
+	for (size_t i = 1; i < child_begin.size(); ++i) child_begin[i] += child_begin[i - 1];
+	std::vector<uint32_t> children(child_begin.back());
+	std::vector<uint32_t> filled(child_begin.begin(), child_begin.end() - 1);
+	for (uint32_t id = 0; id < nodes.size(); ++id)
+	{
+		if (nodes[id].parent != none) children[filled[nodes[id].parent]++] = id;
+	}
+
+	// Bottom up: every directory of a level pulls in its children, which are all complete
+	for (uint32_t depth = max_depth; depth-- > 0;)
+	{
+		const auto& level = levels[depth];
+		ParallelFor(level.size(), jobs, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				auto& node = nodes[level[i]];
+				for (uint32_t c = child_begin[level[i]]; c < child_begin[level[i] + 1]; ++c)
+				{
+					for (const auto& lines : nodes[children[c]].languages) Merge(node.languages, lines);
+				}
+			}
+		});
+	}
+}
+
+LineCounts DirectoryTree::Lines(uint32_t directory) const
+{
+	LineCounts lines{};
+	for (const auto& language : nodes[directory].languages) lines += language.lines;
+	return lines;
+}
+
+unsigned int DirectoryTree::Files(uint32_t directory) const
+{
+	unsigned int files = 0;
+	for (const auto& language : nodes[directory].languages) files += language.files;
+	return files;
+}
+
+const std::vector<DirectoryTree::LanguageLines>& DirectoryTree::Languages(uint32_t directory) const
+{
+	return nodes[directory].languages;
+}
+
+void DirectoryTree::Print(std::ostream& out, unsigned int depth) const
+{
+	std::vector<std::vector<uint32_t>> children(nodes.size());
+	std::vector<uint32_t> roots{};
+	for (uint32_t id = 0; id < nodes.size(); ++id)
+	{
+		if (Files(id) == 0) continue; // only skipped files under it
+		if (nodes[id].parent == none) roots.push_back(id);
+		else children[nodes[id].parent].push_back(id);
+	}
+
+	std::vector<unsigned long> code(nodes.size());
+	for (uint32_t id = 0; id < nodes.size(); ++id) code[id] = Lines(id).code;
+	auto largest_first = [&code](uint32_t a, uint32_t b) { return code[a] > code[b]; };
+	std::sort(roots.begin(), roots.end(), largest_first);
+	for (auto& list : children) std::sort(list.begin(), list.end(), largest_first);
+
+	out << std::right << std::setw(12) << "Code" << "  " << std::setw(10) << "Files" << "  Directory\n";
+	for (uint32_t root : roots) PrintNode(out, root, depth, children);
+}
+
+void DirectoryTree::PrintNode(std::ostream& out, uint32_t directory, unsigned int depth, const std::vector<std::vector<uint32_t>>& children) const
+{
+	const auto& node = nodes[directory];
+	LineCounts lines = Lines(directory);
+
+	// roots by the path they were given as, the rest by name under their parent
+	std::string name = node.parent == none
+		? (node.path.empty() ? std::string(".") : node.path.string())
+		: node.path.filename().string();
+	out << std::right << std::setw(12) << lines.code << "  " << std::setw(10) << Files(directory) << "  "
+		<< std::string(2 * node.depth, ' ') << name;
+
+	// the main languages, by share of the code
+	auto languages = node.languages;
+	std::sort(languages.begin(), languages.end(), [](const LanguageLines& a, const LanguageLines& b) { return a.lines.code > b.lines.code; });
+	std::erase_if(languages, [](const LanguageLines& language) { return language.lines.code == 0; });
+	languages.resize(std::min<size_t>(languages.size(), 3));
+	for (size_t i = 0; i < languages.size(); ++i)
+	{
+		out << (i == 0 ? "  (" : ", ") << LanguageRegistry::GetInfo(languages[i].language).name << ' '
+			<< (100 * languages[i].lines.code + lines.code / 2) / lines.code << '%';
+	}
+	out << (languages.empty() ? "\n" : ")\n");
+
+	if (node.depth >= depth) return;
+	for (uint32_t child : children[directory]) PrintNode(out, child, depth, children);
+}
+
+std::vector<DirectoryTree::Project> DirectoryTree::Projects(const std::vector<std::filesystem::path>& marked) const
+{
+	std::unordered_set<std::filesystem::path::string_type> marks{};
+	for (const auto& directory : marked) marks.insert(DirectoryKey(directory).native());
+
+	// A directory belongs to the nearest project above it, and parents are numbered first. A project
+	// starts with everything under it and is taken out of the project it is nested in.
+	std::vector<Project> projects{};
+	std::vector<size_t> project_of(nodes.size());
+	for (uint32_t id = 0; id < nodes.size(); ++id)
+	{
+		const auto& node = nodes[id];
+		if (node.parent != none && !marks.contains(node.path.native()))
+		{
+			project_of[id] = project_of[node.parent];
+			continue;
+		}
+
+		project_of[id] = projects.size();
+		projects.push_back({ node.path, node.languages });
+		if (node.parent != none)
+		{
+			auto& outer = projects[project_of[node.parent]].languages;
+			for (const auto& lines : node.languages) Subtract(outer, lines);
+		}
+	}
+
+	auto code = [](const Project& project) {
+		unsigned long lines = 0;
+		for (const auto& language : project.languages) lines += language.lines.code;
+		return lines;
+	};
+	for (auto& project : projects)
+	{
+		std::erase_if(project.languages, [](const LanguageLines& language) { return language.files == 0 && language.lines.total == 0; });
+		std::sort(project.languages.begin(), project.languages.end(),
+			[](const LanguageLines& a, const LanguageLines& b) { return a.lines.code > b.lines.code; });
+	}
+	std::erase_if(projects, [](const Project& project) { return project.languages.empty(); });
+	std::stable_sort(projects.begin(), projects.end(), [&code](const Project& a, const Project& b) { return code(a) > code(b); });
+	return projects;
+}
+
+void DirectoryTree::PrintProjects(std::ostream& out, const std::vector<Project>& projects)
+{
+	out << std::right << std::setw(12) << "Code" << "  " << std::setw(10) << "Files" << "  Project\n";
+	for (const auto& project : projects)
+	{
+		LineCounts lines{};
+		unsigned int files = 0;
+		for (const auto& language : project.languages)
+		{
+			lines += language.lines;
+			files += language.files;
+		}
+
+		out << std::right << std::setw(12) << lines.code << "  " << std::setw(10) << files << "  "
+			<< (project.path.empty() ? std::string(".") : project.path.string()) << '\n';
+		for (const auto& language : project.languages)
+		{
+			out << std::right << std::setw(12) << language.lines.code << "  " << std::setw(10) << language.files << "    "
+				<< LanguageRegistry::GetInfo(language.language).name << '\n';
+		}
+	}
+}
@@ -0,0 +1,195 @@
+#include "Estimator.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	// z score of a two sided 95% confidence interval
+	constexpr double z_95 = 1.96;
+
+	// sizes are bucketed by bit width, 0 to 64
+	constexpr size_t size_buckets = 65;
+}
+
+Estimator::Estimator(const std::vector<FILE_LANGUAGE>& languages, const std::vector<uintmax_t>& sizes, uint64_t seed)
+{
+	// Group the files into strata by language and size bucket
+	std::vector<int> stratum_of_key(LanguageRegistry::language_count * size_buckets, -1);
+	std::vector<std::vector<size_t>> members{};
+	for (size_t i = 0; i < languages.size(); ++i)
+	{
+		size_t key = static_cast<size_t>(languages[i]) * size_buckets + std::bit_width(sizes[i]);
+		if (stratum_of_key[key] < 0)
+		{
+			stratum_of_key[key] = static_cast<int>(strata.size());
+			strata.push_back({ languages[i] });
+			members.emplace_back();
+		}
+
+		auto& stratum = strata[stratum_of_key[key]];
+		stratum.files++;
+		stratum.bytes += static_cast<double>(sizes[i]);
+		members[stratum_of_key[key]].push_back(i);
+	}
+
+	// The k-th file of a stratum of n files gets the key (k + offset) / n, with a random offset per stratum.
+	// Sorting by key spreads each stratum evenly over the order, in a random order within the stratum.
+	std::mt19937_64 random{ seed };
+	std::uniform_real_distribution<double> unit{ 0.0, 1.0 };
+
+	struct Keyed
+	{
+		double key;
+		size_t file;
+		uint32_t stratum;
+	};
+	std::vector<Keyed> keyed{};
+	keyed.reserve(languages.size());
+	for (size_t h = 0; h < members.size(); ++h)
+	{
+		auto& files = members[h];
+		std::shuffle(files.begin(), files.end(), random);
+
+		double offset = unit(random);
+		for (size_t k = 0; k < files.size(); ++k)
+		{
+			keyed.push_back({ (static_cast<double>(k) + offset) / static_cast<double>(files.size()), files[k], static_cast<uint32_t>(h) });
+		}
+	}
+	std::stable_sort(keyed.begin(), keyed.end(), [](const Keyed& a, const Keyed& b) { return a.key < b.key; });
+
+	order.reserve(keyed.size());
+	sample_stratum.reserve(keyed.size());
+	sample_size.reserve(keyed.size());
+	for (const auto& k : keyed)
+	{
+		order.push_back(k.file);
+		sample_stratum.push_back(k.stratum);
+		sample_size.push_back(sizes[k.file]);
+	}
+}
+
+const std::vector<size_t>& Estimator::Order() const
+{
+	return order;
+}
+
+void Estimator::Record(size_t sample_index, const LineCounts& counts)
+{
+	const double values[3]{ static_cast<double>(counts.code), static_cast<double>(counts.comment), static_cast<double>(counts.blank) };
+
+	std::scoped_lock lock(mutex);
+	auto& stratum = strata[sample_stratum[sample_index]];
+	stratum.sampled++;
+	stratum.sampled_bytes += static_cast<double>(sample_size[sample_index]);
+	for (int m = 0; m < 3; ++m)
+	{
+		stratum.sum[m] += values[m];
+		stratum.sum_squares[m] += values[m] * values[m];
+	}
+	sampled++;
+}
+
+size_t Estimator::Sampled() const
+{
+	std::scoped_lock lock(mutex);
+	return sampled;
+}
+
+size_t Estimator::FileCount() const
+{
+	return order.size();
+}
+
+std::map<FILE_LANGUAGE, LanguageEstimate> Estimator::Estimate() const
+{
+	std::scoped_lock lock(mutex);
+
+	// Lines per byte of the sampled files, used for strata that haven't been sampled yet
+	struct Ratio
+	{
+		double lines[3]{};
+		double bytes{};
+	};
+	std::array<Ratio, LanguageRegistry::language_count + 1> ratios{};
+	auto& overall = ratios.back();
+	for (const auto& stratum : strata)
+	{
+		for (auto* ratio : { &ratios[static_cast<size_t>(stratum.language)], &overall })
+		{
+			for (int m = 0; m < 3; ++m) ratio->lines[m] += stratum.sum[m];
+			ratio->bytes += stratum.sampled_bytes;
+		}
+	}
+
+	std::map<FILE_LANGUAGE, LanguageEstimate> result{};
+	std::map<FILE_LANGUAGE, std::array<double, 3>> variances{};
+	for (const auto& stratum : strata)
+	{
+		auto& estimate = result[stratum.language];
+		auto& variance = variances[stratum.language];
+		estimate.files += stratum.files;
+		estimate.sampled += stratum.sampled;
+
+		EstimatedValue* values[3]{ &estimate.code, &estimate.comment, &estimate.blank };
+		double N = static_cast<double>(stratum.files);
+		double n = static_cast<double>(stratum.sampled);
+
+		for (int m = 0; m < 3; ++m)
+		{
+			if (stratum.sampled == stratum.files)
+			{
+				// every file counted: exact
+				values[m]->value += stratum.sum[m];
+			}
+			else if (stratum.sampled == 0)
+			{
+				// no sample yet: extrapolate from the size, and assume it could be out by 100%
+				const auto& language = ratios[static_cast<size_t>(stratum.language)];
+				const auto& ratio = language.bytes > 0 ? language : overall;
+				double guess = ratio.bytes > 0 ? stratum.bytes * ratio.lines[m] / ratio.bytes : 0.0;
+				values[m]->value += guess;
+				variance[m] += guess * guess / (z_95 * z_95);
+			}
+			else
+			{
+				// mean per file times the number of files, with the finite population correction.
+				// A single sample has no spread of its own, so it is taken to vary as much as its mean.
+				double mean = stratum.sum[m] / n;
+				double s2 = stratum.sampled > 1
+					? std::max(0.0, (stratum.sum_squares[m] - n * mean * mean) / (n - 1))
+					: mean * mean;
+				values[m]->value += N * mean;
+				variance[m] += N * N * (1 - n / N) * s2 / n;
+			}
+		}
+	}
+
+	for (auto& [language, estimate] : result)
+	{
+		const auto& variance = variances[language];
+		estimate.code.margin = z_95 * std::sqrt(variance[0]);
+		estimate.comment.margin = z_95 * std::sqrt(variance[1]);
+		estimate.blank.margin = z_95 * std::sqrt(variance[2]);
+	}
+
+	return result;
+}
+
+EstimatedValue Estimator::TotalCode() const
+{
+	// strata are sampled independently, so the variances add
+	EstimatedValue total{};
+	double variance = 0;
+	for (const auto& [language, estimate] : Estimate())
+	{
+		total.value += estimate.code.value;
+		variance += estimate.code.margin * estimate.code.margin;
+	}
+	total.margin = std::sqrt(variance);
+	return total;
+}
@@ -1,47 +1,76 @@
 #include "FileReader.h"
 
-#include <fstream>
-#include <iostream>
+#include <cerrno>
 
-void FileReader::ReadFile(const std::filesystem::path& path, std::vector<std::string>& output)
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FileReader::~FileReader()
 {
-    std::ifstream file{ path };
-    if (!file.is_open()) {
-        std::cerr << "Error: unable to open file: " << path << "\n";
-        return;
-    }
+    Close();
+}
 
-    output.reserve(1000);  // Reserve space for typical file line count
+bool FileReader::Open(const std::filesystem::path& path)
+{
+    Close();
+    bytes_read = 0;
+    error = 0;
 
-    std::string line;
-    line.reserve(256);  // Reserve space for typical line length
+#ifdef _WIN32
+    fd = _wopen(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
 
-    while (std::getline(file, line))
-    {
-        auto trimmed = trim(line);
-        if (!trimmed.empty()) {  // Skip empty lines if desired
-            output.emplace_back(trimmed);
-        }
+    if (fd < 0) {
+        error = errno;
+        return false;
     }
+    return true;
 }
 
-std::string_view FileReader::trim(const std::string& s)
+size_t FileReader::Read(char* buffer, size_t size)
 {
-    if (s.empty()) return std::string_view(s);
+    if (fd < 0) return 0;
 
-    const char* data = s.data();
-    size_t size = s.size();
-    size_t start = 0;
+    for (;;) {
+#ifdef _WIN32
+        auto n = _read(fd, buffer, static_cast<unsigned int>(size));
+#else
+        auto n = read(fd, buffer, size);
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n < 0) error = errno;
+        if (n <= 0) return 0;
 
-    // Find first non-whitespace
-    while (start < size && is_whitespace[static_cast<unsigned char>(data[start])]) {
-        ++start;
+        bytes_read += static_cast<uint64_t>(n);
+        return static_cast<size_t>(n);
     }
+}
 
-    // Find last non-whitespace
-    while (size > start && is_whitespace[static_cast<unsigned char>(data[size - 1])]) {
-        --size;
-    }
+uint64_t FileReader::BytesRead() const
+{
+    return bytes_read;
+}
+
+std::error_code FileReader::Error() const
+{
+    return { error, std::generic_category() };
+}
+
+void FileReader::Close()
+{
+    if (fd < 0) return;
 
-    return std::string_view(data + start, size - start);
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+    fd = -1;
 }
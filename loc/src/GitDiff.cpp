@@ -0,0 +1,577 @@
+#include "GitDiff.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <locale>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "Sniffer.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace
+{
+	struct comma_numpunct : std::numpunct<char>
+	{
+	protected:
+		std::string do_grouping() const override { return "\3"; }
+		char do_thousands_sep() const override { return ','; }
+	};
+
+	std::string Quote(std::string_view argument)
+	{
+#ifdef _WIN32
+		std::string quoted{ "\"" };
+		for (char c : argument)
+		{
+			if (c == '"') quoted += '\\';
+			quoted += c;
+		}
+		return quoted + "\"";
+#else
+		std::string quoted{ "'" };
+		for (char c : argument)
+		{
+			if (c == '\'') quoted += "'\\''";
+			else quoted += c;
+		}
+		return quoted + "'";
+#endif
+	}
+
+	std::string Utf8(const std::filesystem::path& path)
+	{
+		auto text = path.generic_u8string();
+		return { text.begin(), text.end() };
+	}
+
+	// Runs git with the (already quoted) arguments and captures what it writes to stdout
+	bool RunGit(const std::string& arguments, std::string& output)
+	{
+		output.clear();
+		std::string command = "git " + arguments;
+#ifdef _WIN32
+		// cmd.exe strips the outer quotes of a command line that starts with one
+		command = "\"" + command + "\"";
+		FILE* pipe = popen(command.c_str(), "rb");
+#else
+		FILE* pipe = popen(command.c_str(), "r");
+#endif
+		if (!pipe) return false;
+
+		char block[64 * 1024];
+		size_t n = 0;
+		while ((n = std::fread(block, 1, sizeof(block), pipe)) > 0) output.append(block, n);
+		return pclose(pipe) == 0;
+	}
+
+	// The commit a revision names, as a hash, so both sides stay fixed while the files are read
+	bool ResolveCommit(const std::string& git, const std::string& revision, std::string& commit)
+	{
+		if (!RunGit(git + " rev-parse --verify --quiet " + Quote(revision + "^{commit}"), commit)) return false;
+		while (!commit.empty() && (commit.back() == '\n' || commit.back() == '\r')) commit.pop_back();
+		return !commit.empty();
+	}
+
+	// A side can only count if its path could be source: either a known extension, or none (which could be a script)
+	bool MaybeSource(const std::filesystem::path& path)
+	{
+		return !LanguageRegistry::HasExtension(path) || LanguageRegistry::FromPath(path) != FILE_LANGUAGE::Other;
+	}
+
+	std::string Signed(long long value)
+	{
+		std::ostringstream cell;
+		cell.imbue(std::locale(std::locale::classic(), new comma_numpunct()));
+		cell << std::showpos << value;
+		return cell.str();
+	}
+}
+
+// Asks one git cat-file --batch for blobs one at a time, instead of starting a git for every blob.
+// git flushes each object as it writes it, so a request is answered before the next is sent.
+// Without fork, on Windows, each blob is still read by a git of its own.
+class GitDiff::BlobReader
+{
+public:
+
+	explicit BlobReader(const std::filesystem::path& top) : top(top) {}
+
+	BlobReader(const BlobReader&) = delete;
+	BlobReader& operator=(const BlobReader&) = delete;
+
+	~BlobReader()
+	{
+#ifndef _WIN32
+		// end of input makes git exit
+		if (to_git) std::fclose(to_git);
+		if (from_git) std::fclose(from_git);
+		if (pid > 0) waitpid(pid, nullptr, 0);
+#endif
+	}
+
+	// The blob named object ("revision:path") as stored, without filters or text conversion.
+	// False if there is no such blob or git can't be run.
+	bool Read(const std::string& object, std::string& text)
+	{
+#ifdef _WIN32
+		return RunGit("-C " + Quote(Utf8(top)) + " cat-file blob " + Quote(object), text);
+#else
+		// the requests are one per line
+		if (object.find('\n') != std::string::npos) return false;
+		if (!started && !Start()) return false;
+		if (!to_git || !from_git) return false;
+
+		if (std::fputs(object.c_str(), to_git) == EOF || std::fputc('\n', to_git) == EOF || std::fflush(to_git) == EOF)
+		{
+			return Fail();
+		}
+
+		// "<hash> <type> <size>" and the object, or "<object> missing" (or "ambiguous") alone
+		std::string header{};
+		for (int c = std::fgetc(from_git); c != '\n'; c = std::fgetc(from_git))
+		{
+			if (c == EOF) return Fail();
+			header += static_cast<char>(c);
+		}
+		if (header.ends_with(" missing") || header.ends_with(" ambiguous")) return false;
+
+		auto type_at = header.find(' ');
+		auto size_at = header.rfind(' ');
+		size_t size = 0;
+		auto [end, error] = std::from_chars(header.data() + size_at + 1, header.data() + header.size(), size);
+		if (type_at == std::string::npos || type_at == size_at || error != std::errc{} || end != header.data() + header.size())
+		{
+			return Fail();
+		}
+
+		// anything that isn't a blob, such as a directory's tree, is read past so the next reply lines up
+		text.resize(size);
+		if (std::fread(text.data(), 1, size, from_git) != size || std::fgetc(from_git) != '\n') return Fail();
+		return std::string_view(header).substr(type_at, size_at - type_at) == " blob";
+#endif
+	}
+
+private:
+
+#ifndef _WIN32
+	bool Start()
+	{
+		started = true;
+
+		// git going away must fail the read, not kill the process
+		sigset_t pipe_signal{};
+		sigemptyset(&pipe_signal);
+		sigaddset(&pipe_signal, SIGPIPE);
+		pthread_sigmask(SIG_BLOCK, &pipe_signal, nullptr);
+
+		// Another worker's git must not inherit these pipes, or it would hold this git's input open
+		// and this one would never see its end. They are close-on-exec before any other git starts.
+		static std::mutex spawning{};
+		std::lock_guard lock{ spawning };
+
+		int requests[2]{ -1, -1 };
+		int replies[2]{ -1, -1 };
+		if (pipe(requests) != 0) return false;
+		if (pipe(replies) != 0)
+		{
+			close(requests[0]);
+			close(requests[1]);
+			return false;
+		}
+		for (int fd : { requests[0], requests[1], replies[0], replies[1] }) fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		posix_spawn_file_actions_t actions{};
+		posix_spawn_file_actions_init(&actions);
+		posix_spawn_file_actions_adddup2(&actions, requests[0], STDIN_FILENO);
+		posix_spawn_file_actions_adddup2(&actions, replies[1], STDOUT_FILENO);
+		posix_spawn_file_actions_addclose(&actions, requests[1]);
+		posix_spawn_file_actions_addclose(&actions, replies[0]);
+
+		std::string directory = top.string();
+		char* arguments[]{ const_cast<char*>("git"), const_cast<char*>("-C"), directory.data(),
+			const_cast<char*>("cat-file"), const_cast<char*>("--batch"), nullptr };
+		bool spawned = posix_spawnp(&pid, "git", &actions, nullptr, arguments, environ) == 0;
+		posix_spawn_file_actions_destroy(&actions);
+
+		close(requests[0]);
+		close(replies[1]);
+		if (!spawned)
+		{
+			pid = -1;
+			close(requests[1]);
+			close(replies[0]);
+			return false;
+		}
+
+		to_git = fdopen(requests[1], "w");
+		from_git = fdopen(replies[0], "r");
+		return to_git && from_git;
+	}
+
+	// After a broken exchange the stream can't be trusted, so nothing more is read from it
+	bool Fail()
+	{
+		if (to_git) std::fclose(to_git);
+		to_git = nullptr;
+		return false;
+	}
+
+	pid_t pid{ -1 };
+	FILE* to_git{};
+	FILE* from_git{};
+	bool started{};
+#endif
+
+	std::filesystem::path top{};
+};
+
+GitDiff::GitDiff(std::string_view range, const std::vector<std::filesystem::path>& pathspecs, bool skip_unusual, bool markdown)
+	: pathspecs(pathspecs), skip_unusual(skip_unusual), markdown(markdown)
+{
+	auto dots = range.find("..");
+	if (dots == range.npos)
+	{
+		base = range;
+		return;
+	}
+
+	// base...head compares head with where it branched off base, as git diff does
+	from_merge_base = range.substr(dots).starts_with("...");
+	base = range.substr(0, dots);
+	head = range.substr(dots + (from_merge_base ? 3 : 2));
+
+	// an empty side of a range means HEAD
+	if (base.empty()) base = "HEAD";
+	if (head.empty()) head = "HEAD";
+}
+
+bool GitDiff::Load()
+{
+	// the repository is the one holding the first path, or the current directory
+	std::filesystem::path where{ "." };
+	if (!pathspecs.empty())
+	{
+		where = std::filesystem::is_directory(pathspecs.front()) ? pathspecs.front() : pathspecs.front().parent_path();
+		if (where.empty()) where = ".";
+	}
+
+	std::string output{};
+	if (!RunGit("-C " + Quote(Utf8(where)) + " rev-parse --show-toplevel", output))
+	{
+		std::cerr << "Error: --diff needs to be run inside a git repository\n";
+		return false;
+	}
+	while (!output.empty() && (output.back() == '\n' || output.back() == '\r')) output.pop_back();
+	top = std::filesystem::path(std::u8string(output.begin(), output.end()));
+	std::string git = "-C " + Quote(Utf8(top));
+
+	if (from_merge_base)
+	{
+		std::string merge_base{};
+		if (!RunGit(git + " merge-base " + Quote(base) + " " + Quote(head), merge_base))
+		{
+			std::cerr << "Error: " << base << " and " << head << " have no common ancestor\n";
+			return false;
+		}
+		base = merge_base.substr(0, merge_base.find_first_of("\r\n"));
+	}
+
+	for (auto* revision : { &base, &head })
+	{
+		if (revision->empty()) continue;
+		std::string commit{};
+		if (!ResolveCommit(git, *revision, commit))
+		{
+			std::cerr << "Error: unknown revision " << *revision << "\n";
+			return false;
+		}
+		*revision = commit;
+	}
+
+	// renames are followed so a moved file shows as one change, and the modes tell submodules from files
+	std::string arguments = git + " diff --raw -z -M --no-ext-diff " + Quote(base);
+	if (!head.empty()) arguments += " " + Quote(head);
+	arguments += " --";
+	for (const auto& pathspec : pathspecs)
+	{
+		arguments += " " + Quote(Utf8(std::filesystem::absolute(pathspec)));
+	}
+
+	if (!RunGit(arguments, output))
+	{
+		std::cerr << "Error: git diff failed\n";
+		return false;
+	}
+
+	files = ParseRaw(output);
+	return true;
+}
+
+std::vector<FileDelta> GitDiff::ParseRaw(std::string_view output)
+{
+	// the mode of a submodule's entry, which names a commit of another repository rather than a file
+	constexpr std::string_view gitlink = "160000";
+
+	std::vector<FileDelta> deltas{};
+
+	auto next = [&output]() {
+		auto end = output.find('\0');
+		auto field = output.substr(0, end);
+		output.remove_prefix(end == output.npos ? output.size() : end + 1);
+		return field;
+	};
+	auto path_of = [](std::string_view field) {
+		return std::filesystem::path(std::u8string(field.begin(), field.end()));
+	};
+
+	while (!output.empty())
+	{
+		// ":<old mode> <new mode> <old hash> <new hash> <status>", then its path, or both for a rename or copy
+		auto header = next();
+		auto new_mode_at = header.find(' ');
+		auto status_at = header.rfind(' ');
+		if (!header.starts_with(':') || new_mode_at == header.npos || status_at + 1 >= header.size()) break;
+		auto old_mode = header.substr(1, new_mode_at - 1);
+		auto new_mode = header.substr(new_mode_at + 1, header.find(' ', new_mode_at + 1) - new_mode_at - 1);
+		auto status = header.substr(status_at + 1);
+
+		FileDelta delta{};
+		delta.old_path = delta.path = path_of(next());
+		switch (status.front())
+		{
+		case 'A': delta.status = DIFF_STATUS::Added; break;
+		case 'D': delta.status = DIFF_STATUS::Deleted; break;
+		case 'R':
+			delta.status = DIFF_STATUS::Renamed;
+			delta.path = path_of(next());
+			break;
+		case 'C':
+			// a copy leaves its source as it was, so only the new file counts
+			delta.status = DIFF_STATUS::Added;
+			delta.old_path = delta.path = path_of(next());
+			break;
+		default: delta.status = DIFF_STATUS::Modified; break;
+		}
+
+		// a side that is a submodule has no lines to count, and its commit usually isn't in this repository
+		bool before = delta.status != DIFF_STATUS::Added && old_mode != gitlink;
+		bool after = delta.status != DIFF_STATUS::Deleted && new_mode != gitlink;
+		if (!before && !after) continue;
+		if (!before)
+		{
+			delta.status = DIFF_STATUS::Added;
+			delta.old_path = delta.path;
+		}
+		if (!after)
+		{
+			delta.status = DIFF_STATUS::Deleted;
+			delta.path = delta.old_path;
+		}
+		deltas.push_back(std::move(delta));
+	}
+
+	return deltas;
+}
+
+bool GitDiff::Count(unsigned int jobs)
+{
+	// each worker reads its blobs through a git of its own; they run in parallel
+	std::atomic<size_t> next{ 0 };
+	std::atomic<bool> ok{ true };
+	{
+		std::vector<std::jthread> threads{};
+		size_t thread_count = std::clamp<size_t>(files.size(), 1, std::max(jobs, 1u));
+		for (size_t i = 0; i < thread_count; ++i)
+		{
+			threads.emplace_back([&] {
+				LineCounter counter{ skip_unusual };
+				BlobReader blobs{ top };
+				for (size_t index = next++; index < files.size(); index = next++)
+				{
+					if (!CountDelta(counter, blobs, files[index])) ok = false;
+				}
+			});
+		}
+	}
+	return ok;
+}
+
+bool GitDiff::CountDelta(LineCounter& counter, BlobReader& blobs, FileDelta& delta) const
+{
+	std::string text{};
+	if (delta.status != DIFF_STATUS::Added && MaybeSource(delta.old_path))
+	{
+		if (!ReadSide(blobs, base, delta.old_path, text)) return false;
+		delta.before = CountSide(counter, delta.old_path, text, delta.old_language, delta.before_embedded);
+	}
+	if (delta.status != DIFF_STATUS::Deleted && MaybeSource(delta.path))
+	{
+		if (!ReadSide(blobs, head, delta.path, text)) return false;
+		delta.after = CountSide(counter, delta.path, text, delta.language, delta.after_embedded);
+	}
+	return true;
+}
+
+bool GitDiff::ReadSide(BlobReader& blobs, const std::string& revision, const std::filesystem::path& path, std::string& text) const
+{
+	if (revision.empty())
+	{
+		std::ifstream file{ top / path, std::ios::binary };
+		if (!file.is_open())
+		{
+			std::cerr << "Error: unable to open " << (top / path) << "\n";
+			return false;
+		}
+		text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	if (!blobs.Read(revision + ":" + Utf8(path), text))
+	{
+		std::cerr << "Error: unable to read " << path << " at " << revision << "\n";
+		return false;
+	}
+	return true;
+}
+
+LineCounts GitDiff::CountSide(LineCounter& counter, const std::filesystem::path& path, const std::string& text, FILE_LANGUAGE& language,
+	std::vector<LineCounter::EmbeddedLines>& embedded) const
+{
+	language = LanguageRegistry::HasExtension(path)
+		? LanguageRegistry::FromPath(path)
+		: LanguageRegistry::FromShebangText(std::string_view(text).substr(0, Sniffer::sniff_size));
+	if (language == FILE_LANGUAGE::Markdown && !markdown) language = FILE_LANGUAGE::Other;
+
+	// binary, minified and generated files are left out, as they are from a full count
+	if (language == FILE_LANGUAGE::Other) return {};
+	if (skip_unusual && Sniffer::Sniff(std::string_view(text).substr(0, Sniffer::sniff_size)) != FILE_KIND::Source)
+	{
+		language = FILE_LANGUAGE::Other;
+		return {};
+	}
+
+	LineCounts lines = counter.CountText(text, language);
+	embedded = counter.LastEmbedded();
+	return lines;
+}
+
+const std::vector<FileDelta>& GitDiff::Files() const
+{
+	return files;
+}
+
+std::map<FILE_LANGUAGE, LanguageDelta> GitDiff::ByLanguage() const
+{
+	std::map<FILE_LANGUAGE, LanguageDelta> deltas{};
+	for (const auto& file : files)
+	{
+		// a file whose language changed moves its lines from one language to the other
+		// and embedded lines, such as the script of an HTML page, count as their own language
+		auto add = [&deltas](FILE_LANGUAGE language, const LineCounts& lines, long long sign) {
+			auto& delta = deltas[language];
+			delta.code += sign * static_cast<long long>(lines.code);
+			delta.comment += sign * static_cast<long long>(lines.comment);
+			delta.blank += sign * static_cast<long long>(lines.blank);
+		};
+		if (file.old_language != FILE_LANGUAGE::Other)
+		{
+			add(file.old_language, file.before, -1);
+			for (const auto& embedded : file.before_embedded)
+			{
+				add(file.old_language, embedded.lines, +1);
+				add(embedded.language, embedded.lines, -1);
+			}
+			if (file.language != file.old_language) deltas[file.old_language].files++;
+		}
+		if (file.language != FILE_LANGUAGE::Other)
+		{
+			add(file.language, file.after, +1);
+			for (const auto& embedded : file.after_embedded)
+			{
+				add(file.language, embedded.lines, -1);
+				add(embedded.language, embedded.lines, +1);
+			}
+			deltas[file.language].files++;
+		}
+	}
+	return deltas;
+}
+
+long long GitDiff::NetCode() const
+{
+	long long net = 0;
+	for (const auto& [language, delta] : ByLanguage()) net += delta.code;
+	return net;
+}
+
+void GitDiff::PrintLanguageBreakdown(const std::map<FILE_LANGUAGE, LanguageDelta>& deltas)
+{
+	if (deltas.size() == 0) return;
+
+	const char* separator = "+-----------------+--------------+--------------+--------------+--------------+\n";
+
+	std::cout << separator;
+	std::cout
+		<< "| "
+		<< std::left
+		<< std::setw(15) << "Language" << " | "
+		<< std::right << std::setw(12) << "Code" << " | "
+		<< std::right << std::setw(12) << "Comments" << " | "
+		<< std::right << std::setw(12) << "Blanks" << " | "
+		<< std::right << std::setw(12) << "Files" << " |\n";
+	std::cout << separator;
+
+	for (const auto& [language, delta] : deltas)
+	{
+		std::string_view language_name = LanguageRegistry::GetInfo(language).name;
+
+		std::cout
+			<< "| "
+			<< std::left
+			<< std::setw(15) << language_name << " | "
+			<< std::right << std::setw(12) << Signed(delta.code) << " | "
+			<< std::right << std::setw(12) << Signed(delta.comment) << " | "
+			<< std::right << std::setw(12) << Signed(delta.blank) << " | "
+			<< std::right << std::setw(12) << delta.files << " |\n";
+	}
+
+	std::cout << separator;
+}
+
+void GitDiff::PrintFiles() const
+{
+	for (const auto& file : files)
+	{
+		if (file.old_language == FILE_LANGUAGE::Other && file.language == FILE_LANGUAGE::Other) continue;
+
+		const char* status = file.status == DIFF_STATUS::Added ? "A"
+			: file.status == DIFF_STATUS::Deleted ? "D"
+			: file.status == DIFF_STATUS::Renamed ? "R"
+			: "M";
+		long long net = static_cast<long long>(file.after.code) - static_cast<long long>(file.before.code);
+
+		std::cout << status << ' ' << std::right << std::setw(10) << Signed(net) << "  ";
+		if (file.status == DIFF_STATUS::Renamed) std::cout << Utf8(file.old_path) << " -> ";
+		std::cout << Utf8(file.path) << '\n';
+	}
+}
@@ -0,0 +1,342 @@
+#include "LanguageRegistry.h"
+
+#include "FileReader.h"
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <type_traits>
+
+namespace
+{
+    constexpr LanguageRegistry::LanguageInfo languages[] = {
+        { FILE_LANGUAGE::C,          "C",          LEXICAL_SYNTAX::CFamily },
+        { FILE_LANGUAGE::CHeader,    "C Header",   LEXICAL_SYNTAX::CFamily },
+        { FILE_LANGUAGE::Cpp,        "C++",        LEXICAL_SYNTAX::CFamily },
+        { FILE_LANGUAGE::CS,         "C#",         LEXICAL_SYNTAX::CSharp },
+        { FILE_LANGUAGE::Css,        "CSS",        LEXICAL_SYNTAX::Css },
+        { FILE_LANGUAGE::Go,         "Go",         LEXICAL_SYNTAX::Go },
+        { FILE_LANGUAGE::Html,       "HTML",       LEXICAL_SYNTAX::Html },
+        { FILE_LANGUAGE::Java,       "Java",       LEXICAL_SYNTAX::Java },
+        { FILE_LANGUAGE::JavaScript, "JavaScript", LEXICAL_SYNTAX::JavaScript },
+        { FILE_LANGUAGE::TypeScript, "TypeScript", LEXICAL_SYNTAX::JavaScript },
+        { FILE_LANGUAGE::Kotlin,     "Kotlin",     LEXICAL_SYNTAX::Kotlin },
+        { FILE_LANGUAGE::Markdown,   "Markdown",   LEXICAL_SYNTAX::Markdown },
+        { FILE_LANGUAGE::Ruby,       "Ruby",       LEXICAL_SYNTAX::Ruby },
+        { FILE_LANGUAGE::Rust,       "Rust",       LEXICAL_SYNTAX::Rust },
+        { FILE_LANGUAGE::Shell,      "Shell",      LEXICAL_SYNTAX::Shell },
+        { FILE_LANGUAGE::PowerShell, "PowerShell", LEXICAL_SYNTAX::PowerShell },
+        { FILE_LANGUAGE::Python,     "Python",     LEXICAL_SYNTAX::Python },
+        { FILE_LANGUAGE::FSharp,     "F#",         LEXICAL_SYNTAX::FSharp },
+        { FILE_LANGUAGE::Xaml,       "XAML",       LEXICAL_SYNTAX::Markup },
+        { FILE_LANGUAGE::Xml,        "XML",        LEXICAL_SYNTAX::Markup },
+        { FILE_LANGUAGE::Other,      "Other",      LEXICAL_SYNTAX::CFamily },
+    };
+
+    static_assert(std::size(languages) == LanguageRegistry::language_count);
+
+    constexpr bool LanguagesInEnumOrder()
+    {
+        for (size_t i = 0; i < std::size(languages); ++i) {
+            if (static_cast<size_t>(languages[i].language) != i) return false;
+        }
+        return true;
+    }
+
+    static_assert(LanguagesInEnumOrder(), "languages[] must be indexed by FILE_LANGUAGE");
+
+    struct ExtensionEntry
+    {
+        std::string_view extension;
+        FILE_LANGUAGE language;
+    };
+
+    // Extensions are stored lower case, with the leading '.'
+    constexpr ExtensionEntry extensions[] = {
+        { ".c",    FILE_LANGUAGE::C },
+        { ".h",    FILE_LANGUAGE::CHeader },
+        { ".py",   FILE_LANGUAGE::Python },     { ".pyw",  FILE_LANGUAGE::Python },
+        { ".fs",   FILE_LANGUAGE::FSharp },     { ".fsx",  FILE_LANGUAGE::FSharp },
+        { ".cpp",  FILE_LANGUAGE::Cpp },        { ".hpp",  FILE_LANGUAGE::Cpp },
+        { ".cxx",  FILE_LANGUAGE::Cpp },        { ".ino",  FILE_LANGUAGE::Cpp },
+        { ".hxx",  FILE_LANGUAGE::Cpp },        { ".c++",  FILE_LANGUAGE::Cpp },
+        { ".cc",   FILE_LANGUAGE::Cpp },        { ".ixx",  FILE_LANGUAGE::Cpp },
+        { ".cppm", FILE_LANGUAGE::Cpp },
+        { ".cs",   FILE_LANGUAGE::CS },
+        { ".css",  FILE_LANGUAGE::Css },
+        { ".rs",   FILE_LANGUAGE::Rust },
+        { ".go",   FILE_LANGUAGE::Go },
+        { ".xml",  FILE_LANGUAGE::Xml },
+        { ".xaml", FILE_LANGUAGE::Xaml },
+        { ".html", FILE_LANGUAGE::Html },       { ".htm",  FILE_LANGUAGE::Html },
+        { ".md",   FILE_LANGUAGE::Markdown },   { ".markdown", FILE_LANGUAGE::Markdown },
+        { ".java", FILE_LANGUAGE::Java },
+        { ".kt",   FILE_LANGUAGE::Kotlin },     { ".kts",  FILE_LANGUAGE::Kotlin },
+        { ".js",   FILE_LANGUAGE::JavaScript }, { ".jsx",  FILE_LANGUAGE::JavaScript },
+        { ".ts",   FILE_LANGUAGE::TypeScript }, { ".tsx",  FILE_LANGUAGE::TypeScript },
+        { ".rb",   FILE_LANGUAGE::Ruby },
+        { ".sh",   FILE_LANGUAGE::Shell },      { ".zsh",  FILE_LANGUAGE::Shell },
+        { ".ps1",  FILE_LANGUAGE::PowerShell }, { ".psd1", FILE_LANGUAGE::PowerShell },
+        { ".psm1", FILE_LANGUAGE::PowerShell },
+    };
+
+    constexpr size_t max_extension_length = 9;
+    constexpr size_t hash_table_size = 128;
+
+    static_assert(std::size(extensions) < 255);
+
+    constexpr uint32_t HashExtension(std::string_view extension, uint32_t seed)
+    {
+        // FNV-1a, seeded so that a collision free seed can be searched for
+        uint32_t h = 2166136261u ^ seed;
+        for (char c : extension) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 16777619u;
+        }
+        h ^= h >> 15;
+        return h & (hash_table_size - 1);
+    }
+
+    struct PerfectHashTable
+    {
+        uint32_t seed;
+        std::array<uint8_t, hash_table_size> slots; // index into extensions[] + 1, 0 = empty
+    };
+
+    constexpr uint32_t no_seed = 0xFFFFFFFFu;
+
+    // Find a seed for which every extension lands in its own slot
+    constexpr PerfectHashTable BuildExtensionTable()
+    {
+        for (uint32_t seed = 0; seed < 4096; ++seed) {
+            PerfectHashTable table{ seed, {} };
+            bool collision = false;
+            for (size_t i = 0; i < std::size(extensions) && !collision; ++i) {
+                auto& slot = table.slots[HashExtension(extensions[i].extension, seed)];
+                if (slot != 0) collision = true;
+                else slot = static_cast<uint8_t>(i + 1);
+            }
+            if (!collision) return table;
+        }
+        return PerfectHashTable{ no_seed, {} };
+    }
+
+    constexpr PerfectHashTable extension_table = BuildExtensionTable();
+
+    static_assert(extension_table.seed != no_seed, "no perfect hash seed found for the extension table");
+
+    struct InterpreterEntry
+    {
+        std::string_view interpreter;
+        FILE_LANGUAGE language;
+    };
+
+    // Interpreter names have their version suffix removed before lookup (python3.12 -> python)
+    constexpr InterpreterEntry interpreters[] = {
+        { "sh",         FILE_LANGUAGE::Shell },
+        { "bash",       FILE_LANGUAGE::Shell },
+        { "zsh",        FILE_LANGUAGE::Shell },
+        { "ksh",        FILE_LANGUAGE::Shell },
+        { "dash",       FILE_LANGUAGE::Shell },
+        { "ash",        FILE_LANGUAGE::Shell },
+        { "python",     FILE_LANGUAGE::Python },
+        { "pypy",       FILE_LANGUAGE::Python },
+        { "ruby",       FILE_LANGUAGE::Ruby },
+        { "pwsh",       FILE_LANGUAGE::PowerShell },
+        { "powershell", FILE_LANGUAGE::PowerShell },
+        { "node",       FILE_LANGUAGE::JavaScript },
+        { "nodejs",     FILE_LANGUAGE::JavaScript },
+    };
+
+    // Info strings are matched exactly, as GitHub does for the common spellings
+    constexpr LanguageRegistry::FenceTag fence_tags[] = {
+        { "c",          FILE_LANGUAGE::C },
+        { "cpp",        FILE_LANGUAGE::Cpp },        { "c++",        FILE_LANGUAGE::Cpp },
+        { "cc",         FILE_LANGUAGE::Cpp },        { "cxx",        FILE_LANGUAGE::Cpp },
+        { "cs",         FILE_LANGUAGE::CS },         { "csharp",     FILE_LANGUAGE::CS },
+        { "c#",         FILE_LANGUAGE::CS },
+        { "css",        FILE_LANGUAGE::Css },
+        { "go",         FILE_LANGUAGE::Go },         { "golang",     FILE_LANGUAGE::Go },
+        { "html",       FILE_LANGUAGE::Html },
+        { "java",       FILE_LANGUAGE::Java },
+        { "js",         FILE_LANGUAGE::JavaScript }, { "javascript", FILE_LANGUAGE::JavaScript },
+        { "jsx",        FILE_LANGUAGE::JavaScript },
+        { "ts",         FILE_LANGUAGE::TypeScript }, { "typescript", FILE_LANGUAGE::TypeScript },
+        { "tsx",        FILE_LANGUAGE::TypeScript },
+        { "kotlin",     FILE_LANGUAGE::Kotlin },     { "kt",         FILE_LANGUAGE::Kotlin },
+        { "ruby",       FILE_LANGUAGE::Ruby },       { "rb",         FILE_LANGUAGE::Ruby },
+        { "rust",       FILE_LANGUAGE::Rust },       { "rs",         FILE_LANGUAGE::Rust },
+        { "sh",         FILE_LANGUAGE::Shell },      { "bash",       FILE_LANGUAGE::Shell },
+        { "shell",      FILE_LANGUAGE::Shell },      { "zsh",        FILE_LANGUAGE::Shell },
+        { "powershell", FILE_LANGUAGE::PowerShell }, { "ps1",        FILE_LANGUAGE::PowerShell },
+        { "pwsh",       FILE_LANGUAGE::PowerShell },
+        { "python",     FILE_LANGUAGE::Python },     { "py",         FILE_LANGUAGE::Python },
+        { "python3",    FILE_LANGUAGE::Python },
+        { "fsharp",     FILE_LANGUAGE::FSharp },     { "fs",         FILE_LANGUAGE::FSharp },
+        { "f#",         FILE_LANGUAGE::FSharp },
+        { "xml",        FILE_LANGUAGE::Xml },
+        { "xaml",       FILE_LANGUAGE::Xaml },
+    };
+
+    // Number of bytes read from an extensionless file when looking for a shebang
+    constexpr size_t shebang_read_size = 128;
+
+    template <typename CharT>
+    constexpr bool IsSeparator(CharT c)
+    {
+#ifdef _WIN32
+        return c == CharT('/') || c == CharT('\\');
+#else
+        return c == CharT('/');
+#endif
+    }
+
+    // Same rules as std::filesystem::path::extension(), without building a path
+    template <typename CharT>
+    std::basic_string_view<CharT> ExtensionOf(std::basic_string_view<CharT> native)
+    {
+        size_t start = native.size();
+        while (start > 0 && !IsSeparator(native[start - 1])) --start;
+        auto filename = native.substr(start);
+
+        if (filename.empty() || (filename[0] == CharT('.') && filename.find_first_not_of(CharT('.')) == filename.npos))
+            return {};
+
+        auto dot = filename.rfind(CharT('.'));
+        if (dot == filename.npos || dot == 0) return {};
+        return filename.substr(dot);
+    }
+
+    template <typename CharT>
+    FILE_LANGUAGE LookupExtension(std::basic_string_view<CharT> extension, bool case_insensitive)
+    {
+        if (extension.size() < 2 || extension.size() > max_extension_length) return FILE_LANGUAGE::Other;
+
+        char buffer[max_extension_length];
+        for (size_t i = 0; i < extension.size(); ++i) {
+            auto c = static_cast<std::make_unsigned_t<CharT>>(extension[i]);
+            if (c > 0x7F) return FILE_LANGUAGE::Other;
+            char lower = static_cast<char>(c);
+            if (lower >= 'A' && lower <= 'Z') {
+                if (!case_insensitive) return FILE_LANGUAGE::Other; // table is lower case only
+                lower = static_cast<char>(lower - 'A' + 'a');
+            }
+            buffer[i] = lower;
+        }
+
+        std::string_view key{ buffer, extension.size() };
+        auto slot = extension_table.slots[HashExtension(key, extension_table.seed)];
+        if (slot == 0) return FILE_LANGUAGE::Other;
+
+        const auto& entry = extensions[slot - 1];
+        return entry.extension == key ? entry.language : FILE_LANGUAGE::Other;
+    }
+}
+
+FILE_LANGUAGE LanguageRegistry::FromExtension(std::string_view extension, bool case_insensitive)
+{
+    return LookupExtension(extension, case_insensitive);
+}
+
+FILE_LANGUAGE LanguageRegistry::FromPath(const std::filesystem::path& path, bool case_insensitive)
+{
+    using CharT = std::filesystem::path::value_type;
+    return LookupExtension(ExtensionOf(std::basic_string_view<CharT>(path.native())), case_insensitive);
+}
+
+bool LanguageRegistry::HasExtension(const std::filesystem::path& path)
+{
+    using CharT = std::filesystem::path::value_type;
+    return !ExtensionOf(std::basic_string_view<CharT>(path.native())).empty();
+}
+
+FILE_LANGUAGE LanguageRegistry::Detect(const std::filesystem::path& path)
+{
+    if (HasExtension(path)) return FromPath(path);
+    return FromShebang(path);
+}
+
+FILE_LANGUAGE LanguageRegistry::FromShebang(const std::filesystem::path& path)
+{
+    // unbuffered into the stack, as a stream would allocate a buffer for every script
+    char buffer[shebang_read_size];
+
+    FileReader file;
+    if (!file.Open(path)) return FILE_LANGUAGE::Other;
+    size_t size = 0;
+    while (size < sizeof(buffer)) {
+        size_t n = file.Read(buffer + size, sizeof(buffer) - size);
+        if (n == 0) break;
+        size += n;
+    }
+
+    return FromShebangText({ buffer, size });
+}
+
+FILE_LANGUAGE LanguageRegistry::FromShebangText(std::string_view head)
+{
+    if (!head.starts_with("#!")) return FILE_LANGUAGE::Other;
+
+    head.remove_prefix(2);
+    head = head.substr(0, head.find_first_of("\r\n"));
+
+    // Split the interpreter line into words
+    auto next_word = [&head]() {
+        auto start = head.find_first_not_of(" \t");
+        if (start == head.npos) { head = {}; return std::string_view{}; }
+        head.remove_prefix(start);
+        auto end = head.find_first_of(" \t");
+        auto word = head.substr(0, end);
+        head.remove_prefix(word.size());
+        return word;
+    };
+
+    auto basename = [](std::string_view word) {
+        auto slash = word.rfind('/');
+        return slash == word.npos ? word : word.substr(slash + 1);
+    };
+
+    auto interpreter = basename(next_word());
+
+    // "#!/usr/bin/env [-S] [NAME=value] python3"
+    if (interpreter == "env") {
+        for (auto word = next_word(); !word.empty(); word = next_word()) {
+            if (word.front() == '-' || word.find('=') != word.npos) continue;
+            interpreter = basename(word);
+            break;
+        }
+    }
+
+    return FromInterpreter(interpreter);
+}
+
+FILE_LANGUAGE LanguageRegistry::FromInterpreter(std::string_view interpreter)
+{
+    // strip version suffixes such as "3", "3.12" or "-5.1"
+    auto end = interpreter.find_last_not_of("0123456789.-");
+    interpreter = interpreter.substr(0, end == interpreter.npos ? 0 : end + 1);
+
+    for (const auto& entry : interpreters) {
+        if (entry.interpreter == interpreter) return entry.language;
+    }
+    return FILE_LANGUAGE::Other;
+}
+
+std::optional<FILE_LANGUAGE> LanguageRegistry::FromName(std::string_view name)
+{
+    for (const auto& info : languages) {
+        if (info.name == name) return info.language;
+    }
+    return std::nullopt;
+}
+
+const LanguageRegistry::LanguageInfo& LanguageRegistry::GetInfo(FILE_LANGUAGE language)
+{
+    return languages[static_cast<size_t>(language)];
+}
+
+std::span<const LanguageRegistry::FenceTag> LanguageRegistry::FenceTags()
+{
+    return fence_tags;
+}
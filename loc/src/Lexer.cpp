@@ -0,0 +1,725 @@
+#include "Lexer.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace
+{
+    using ModeSpec = Lexer::ModeSpec;
+    using TokenSpec = Lexer::TokenSpec;
+
+    class RuleBuilder
+    {
+    public:
+
+        uint8_t AddMode(MODE_KIND kind, int fallback = -1)
+        {
+            modes.push_back({ kind, {}, fallback });
+            return static_cast<uint8_t>(modes.size() - 1);
+        }
+
+        void AddToken(uint8_t mode, std::string_view text, uint8_t target)
+        {
+            modes[mode].tokens.push_back({ std::string(text), target });
+        }
+
+        uint8_t AddComment(uint8_t from, std::string_view open, std::string_view close)
+        {
+            auto comment = AddMode(MODE_KIND::Comment);
+            AddToken(from, open, comment);
+            AddToken(comment, close, from);
+            return comment;
+        }
+
+        // escape is a character that escapes the byte after it, e.g. '\\'
+        uint8_t AddString(uint8_t from, std::string_view open, std::string_view close,
+            std::string_view escape, bool ends_at_newline)
+        {
+            auto str = AddMode(MODE_KIND::String);
+            AddToken(from, open, str);
+            AddToken(str, close, from);
+            if (!escape.empty()) {
+                auto escaped = AddMode(MODE_KIND::String, str);
+                AddToken(str, escape, escaped);
+            }
+            if (ends_at_newline) AddToken(str, "\n", from);
+            return str;
+        }
+
+        // Appends the rules of another language, embedded as language. Any of the tokens in close
+        // returns from it to the mode back. Returns the embedded language's code mode.
+        uint8_t Embed(const std::vector<ModeSpec>& rules, FILE_LANGUAGE language,
+            const std::vector<std::string_view>& close, uint8_t back)
+        {
+            auto offset = static_cast<uint8_t>(modes.size());
+            for (auto mode : rules) {
+                for (auto& token : mode.tokens) token.target = static_cast<uint8_t>(token.target + offset);
+                if (mode.fallback >= 0) mode.fallback += offset;
+                if (mode.embedded == FILE_LANGUAGE::Other) mode.embedded = language; // nested ones keep theirs
+                for (auto text : close) mode.tokens.push_back({ std::string(text), back });
+                modes.push_back(std::move(mode));
+            }
+            return offset;
+        }
+
+        std::vector<ModeSpec> modes{};
+    };
+
+    std::vector<ModeSpec> CFamilyRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        auto line = b.AddComment(code, "//", "\n");
+        b.AddToken(line, "\\\n", line); // line continuation
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        auto raw = b.AddMode(MODE_KIND::CppRawString, code);
+        b.AddToken(code, "R\"", raw);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> CSharpRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "//", "\n");
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        b.AddString(code, "\"\"\"", "\"\"\"", "", false);
+        auto verbatim = b.AddString(code, "@\"", "\"", "", false);
+        b.AddToken(verbatim, "\"\"", verbatim);
+        b.AddToken(code, "$@\"", verbatim);
+        b.AddToken(code, "@$\"", verbatim);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> JavaRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "//", "\n");
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        b.AddString(code, "\"\"\"", "\"\"\"", "\\", false);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> KotlinRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "//", "\n");
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        b.AddString(code, "\"\"\"", "\"\"\"", "", false);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> JavaScriptRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "//", "\n");
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        b.AddString(code, "`", "`", "\\", false); // template literal
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> GoRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "//", "\n");
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        b.AddString(code, "`", "`", "", false); // raw string
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> RustRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "//", "\n");
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", false);
+        b.AddString(code, "r\"", "\"", "", false);
+        b.AddString(code, "r#\"", "\"#", "", false);
+        b.AddString(code, "r##\"", "\"##", "", false);
+        // ' also starts lifetimes, so only the char literals that matter are tokens
+        b.AddToken(code, "'\"'", code);
+        b.AddToken(code, "'\\\"'", code);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> PythonRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "#", "\n");
+        b.AddString(code, "\"\"\"", "\"\"\"", "\\", false);
+        b.AddString(code, "'''", "'''", "\\", false);
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> RubyRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        auto line = b.AddComment(code, "#", "\n");
+        // =begin/=end must start a line; the rest of the =end line is still comment
+        auto block = b.AddComment(code, "\n=begin", "\n=end");
+        b.AddToken(line, "\n=begin", block);
+        auto end_line = b.AddMode(MODE_KIND::Comment);
+        b.modes[block].tokens.back().target = end_line;
+        b.AddToken(end_line, "\n", code);
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> ShellRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "#", "\n");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "", true);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> PowerShellRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "#", "\n");
+        b.AddComment(code, "<#", "#>");
+        b.AddString(code, "\"", "\"", "`", true);
+        auto single = b.AddString(code, "'", "'", "", true);
+        b.AddToken(single, "''", single);
+        b.AddString(code, "@\"", "\"@", "", false); // here-strings
+        b.AddString(code, "@'", "'@", "", false);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> FSharpRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "//", "\n");
+        b.AddComment(code, "(*", "*)");
+        b.AddToken(code, "(*)", code); // the multiplication operator
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "\"\"\"", "\"\"\"", "", false);
+        auto verbatim = b.AddString(code, "@\"", "\"", "", false);
+        b.AddToken(verbatim, "\"\"", verbatim);
+        // ' also starts generic type parameters, so only match the char literals that matter
+        b.AddToken(code, "'\"'", code);
+        b.AddToken(code, "'\\\"'", code);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> MarkupRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "<!--", "-->");
+        b.AddString(code, "\"", "\"", "", true);
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> CssRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "/*", "*/");
+        b.AddString(code, "\"", "\"", "\\", true);
+        b.AddString(code, "'", "'", "\\", true);
+        return b.modes;
+    }
+
+    // Markup, with the contents of <script> and <style> elements counted as JavaScript and CSS
+    std::vector<ModeSpec> HtmlRules()
+    {
+        RuleBuilder b;
+        auto code = b.AddMode(MODE_KIND::Code);
+        b.AddComment(code, "<!--", "-->");
+        b.AddString(code, "\"", "\"", "", true);
+
+        struct Element
+        {
+            std::string_view open;
+            std::string_view open_upper;
+            std::vector<std::string_view> close;
+            std::vector<ModeSpec> rules;
+            FILE_LANGUAGE language;
+        };
+        Element elements[]{
+            { "<script", "<SCRIPT", { "</script", "</SCRIPT" }, JavaScriptRules(), FILE_LANGUAGE::JavaScript },
+            { "<style", "<STYLE", { "</style", "</STYLE" }, CssRules(), FILE_LANGUAGE::Css },
+        };
+        for (const auto& element : elements) {
+            // the start tag is still markup; its attributes can hold a '>' in quotes
+            auto tag = b.AddMode(MODE_KIND::Code);
+            b.AddToken(code, element.open, tag);
+            b.AddToken(code, element.open_upper, tag);
+            b.AddString(tag, "\"", "\"", "", false);
+            b.AddString(tag, "'", "'", "", false);
+
+            // browsers end the element at its end tag wherever it appears, even inside a string
+            auto content = b.Embed(element.rules, element.language, element.close, code);
+            b.AddToken(tag, ">", content);
+        }
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> RulesFor(LEXICAL_SYNTAX syntax);
+
+    // Prose counts as comment. A fenced code block whose info string names a language is counted as
+    // that language; other fenced blocks are Markdown code.
+    std::vector<ModeSpec> MarkdownRules()
+    {
+        RuleBuilder b;
+        auto prose = b.AddMode(MODE_KIND::Comment);
+        auto fence = b.AddMode(MODE_KIND::Code);
+        b.AddToken(prose, "\n```", fence);
+        b.AddToken(fence, "\n```", prose);
+
+        std::map<FILE_LANGUAGE, uint8_t> embedded{};
+        for (const auto& [tag, language] : LanguageRegistry::FenceTags()) {
+            auto [it, inserted] = embedded.try_emplace(language, uint8_t{});
+            if (inserted) {
+                it->second = b.Embed(RulesFor(LanguageRegistry::GetInfo(language).syntax), language, { "\n```" }, prose);
+            }
+
+            // the info string must be just the tag; anything after it makes a plain fenced block
+            for (std::string_view end : { "\n", "\r\n" }) {
+                b.AddToken(prose, "\n```" + std::string(tag) + std::string(end), it->second);
+            }
+        }
+        return b.modes;
+    }
+
+    std::vector<ModeSpec> RulesFor(LEXICAL_SYNTAX syntax)
+    {
+        switch (syntax) {
+        case LEXICAL_SYNTAX::CFamily: return CFamilyRules();
+        case LEXICAL_SYNTAX::CSharp: return CSharpRules();
+        case LEXICAL_SYNTAX::Java: return JavaRules();
+        case LEXICAL_SYNTAX::Kotlin: return KotlinRules();
+        case LEXICAL_SYNTAX::JavaScript: return JavaScriptRules();
+        case LEXICAL_SYNTAX::Go: return GoRules();
+        case LEXICAL_SYNTAX::Rust: return RustRules();
+        case LEXICAL_SYNTAX::Python: return PythonRules();
+        case LEXICAL_SYNTAX::Ruby: return RubyRules();
+        case LEXICAL_SYNTAX::Shell: return ShellRules();
+        case LEXICAL_SYNTAX::PowerShell: return PowerShellRules();
+        case LEXICAL_SYNTAX::FSharp: return FSharpRules();
+        case LEXICAL_SYNTAX::Markup: return MarkupRules();
+        case LEXICAL_SYNTAX::Css: return CssRules();
+        case LEXICAL_SYNTAX::Html: return HtmlRules();
+        case LEXICAL_SYNTAX::Markdown: return MarkdownRules();
+        }
+        return CFamilyRules();
+    }
+
+    constexpr bool IsWhitespace(unsigned char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    struct Resolved
+    {
+        uint8_t mode;
+        std::string pending;
+        uint8_t marks;
+    };
+
+    uint8_t TokenMarks(const std::vector<ModeSpec>& modes, uint8_t from, const TokenSpec& token)
+    {
+        bool blank = true;
+        for (unsigned char c : token.text) blank = blank && IsWhitespace(c);
+        if (blank) return 0;
+
+        bool comment = modes[from].kind == MODE_KIND::Comment || modes[token.target].kind == MODE_KIND::Comment;
+        uint8_t marks = comment ? Lexer::mark_comment : Lexer::mark_code;
+
+        // tokens that enter or leave an embedded language, such as <script> or a code fence, belong to the host
+        bool embedded = modes[from].embedded != FILE_LANGUAGE::Other && modes[token.target].embedded != FILE_LANGUAGE::Other;
+        return embedded ? static_cast<uint8_t>(marks << Lexer::embedded_shift) : marks;
+    }
+
+    // Slot 0 counts the file's own language, and each embedded language gets a slot of its own.
+    // Returns the slot of each mode; languages receives the language of each slot.
+    std::vector<uint8_t> ModeSlots(const std::vector<ModeSpec>& modes, std::vector<FILE_LANGUAGE>& languages)
+    {
+        std::vector<uint8_t> mode_slots(modes.size());
+        languages.assign(1, FILE_LANGUAGE::Other);
+        for (size_t m = 0; m < modes.size(); ++m) {
+            if (modes[m].embedded == FILE_LANGUAGE::Other) continue;
+            auto found = std::find(languages.begin(), languages.end(), modes[m].embedded);
+            mode_slots[m] = static_cast<uint8_t>(found - languages.begin());
+            if (found == languages.end()) languages.push_back(modes[m].embedded);
+        }
+        return mode_slots;
+    }
+
+    // Reference semantics of the lexer, used to build the transition table: consume
+    // input greedily with the longest matching token, keeping any suffix that could
+    // still grow into a token as pending. With flush set nothing is kept pending.
+    Resolved Resolve(const std::vector<ModeSpec>& modes, uint8_t mode, std::string_view input, bool flush)
+    {
+        uint8_t marks = 0;
+        while (!input.empty() && modes[mode].kind != MODE_KIND::CppRawString) {
+            const auto& spec = modes[mode];
+
+            if (!flush) {
+                for (const auto& token : spec.tokens) {
+                    if (token.text.size() > input.size() && token.text.starts_with(input))
+                        return { mode, std::string(input), marks };
+                }
+            }
+
+            const TokenSpec* best = nullptr;
+            for (const auto& token : spec.tokens) {
+                if (input.starts_with(token.text) && (!best || token.text.size() > best->text.size()))
+                    best = &token;
+            }
+
+            if (best) {
+                marks |= TokenMarks(modes, mode, *best);
+                mode = best->target;
+                input.remove_prefix(best->text.size());
+                continue;
+            }
+
+            if (!IsWhitespace(static_cast<unsigned char>(input.front()))) {
+                uint8_t mark = spec.kind == MODE_KIND::Comment ? Lexer::mark_comment : Lexer::mark_code;
+                marks |= spec.embedded != FILE_LANGUAGE::Other ? static_cast<uint8_t>(mark << Lexer::embedded_shift) : mark;
+            }
+            if (spec.fallback >= 0) mode = static_cast<uint8_t>(spec.fallback);
+            input.remove_prefix(1);
+        }
+        return { mode, std::string{}, marks };
+    }
+}
+
+Lexer::Lexer(const std::vector<ModeSpec>& modes)
+{
+    // Byte classes: other, whitespace, newline, then one class per byte used in a token
+    constexpr uint8_t whitespace_class = 1, newline_class = 2;
+    std::vector<unsigned char> representative{ 'x', ' ', '\n' };
+
+    classes.fill(other_class);
+    for (unsigned c = 0; c < 256; ++c) {
+        if (IsWhitespace(static_cast<unsigned char>(c))) classes[c] = whitespace_class;
+    }
+    classes['\n'] = newline_class;
+
+    for (const auto& mode : modes) {
+        for (const auto& token : mode.tokens) {
+            for (unsigned char c : token.text) {
+                if (classes[c] == other_class || classes[c] == whitespace_class) {
+                    classes[c] = static_cast<uint8_t>(representative.size());
+                    representative.push_back(c);
+                }
+            }
+        }
+    }
+    // the first guesses at the other and whitespace classes may have become token bytes themselves
+    for (unsigned c = 0; c < 256; ++c) {
+        if (classes[c] == other_class) representative[other_class] = static_cast<unsigned char>(c);
+        if (classes[c] == whitespace_class) representative[whitespace_class] = static_cast<unsigned char>(c);
+    }
+    class_count = representative.size();
+
+    std::vector<uint8_t> mode_slots = ModeSlots(modes, slot_languages);
+
+    // Breadth first construction of the (mode, pending input) states
+    std::map<std::pair<uint8_t, std::string>, uint16_t> ids;
+    std::vector<std::pair<uint8_t, std::string>> states;
+    auto intern = [&](uint8_t mode, const std::string& pending) {
+        auto [it, inserted] = ids.try_emplace({ mode, pending }, static_cast<uint16_t>(states.size()));
+        if (inserted) states.emplace_back(mode, pending);
+        return it->second;
+    };
+
+    // Start as if after a newline so tokens anchored to a line start match on the first line
+    auto start = Resolve(modes, 0, "\n", false);
+    start_state = intern(start.mode, start.pending);
+    auto code_state = intern(0, "");
+
+    for (size_t s = 0; s < states.size(); ++s) {
+        auto [mode, pending] = states[s];
+
+        table.resize((s + 1) * class_count);
+        eof_marks.push_back(Resolve(modes, mode, pending, true).marks);
+
+        bool raw = modes[mode].kind == MODE_KIND::CppRawString;
+        special.push_back(raw ? 1 : 0);
+        special_return.push_back(raw ? intern(static_cast<uint8_t>(modes[mode].fallback), "") : code_state);
+        slots.push_back(mode_slots[mode]);
+
+        for (size_t cls = 0; cls < class_count; ++cls) {
+            uint32_t entry;
+            if (raw) {
+                entry = static_cast<uint32_t>(s) | special_bit; // bytes are handled by FeedRawString
+            }
+            else {
+                auto next = Resolve(modes, mode, pending + static_cast<char>(representative[cls]), false);
+                entry = intern(next.mode, next.pending) | (uint32_t{ next.marks } << mark_shift);
+                if (modes[next.mode].kind == MODE_KIND::CppRawString) entry |= special_bit;
+
+                // entering or leaving an embedded language is rare, so it is handled outside the inner loop
+                if (mode_slots[next.mode] != mode_slots[mode]) entry |= special_bit;
+            }
+            table[s * class_count + cls] = entry;
+        }
+    }
+}
+
+std::vector<Lexer::ModeSpec> Lexer::Rules(LEXICAL_SYNTAX syntax)
+{
+    return RulesFor(syntax);
+}
+
+const Lexer& Lexer::ForSyntax(LEXICAL_SYNTAX syntax)
+{
+    // each is built on first use, so a run only pays for the syntaxes it meets; the Markdown
+    // lexer, which embeds most of the others, is by far the largest
+    constexpr size_t syntax_count = static_cast<size_t>(LEXICAL_SYNTAX::Markdown) + 1;
+    static std::array<std::once_flag, syntax_count> built{};
+    static std::array<std::unique_ptr<const Lexer>, syntax_count> lexers{};
+
+    auto index = static_cast<size_t>(syntax);
+    std::call_once(built[index], [syntax, index] { lexers[index].reset(new Lexer(RulesFor(syntax))); });
+    return *lexers[index];
+}
+
+Lexer::State Lexer::Start() const
+{
+    State state{};
+    state.state = start_state;
+    return state;
+}
+
+size_t Lexer::StateCount() const
+{
+    return special.size();
+}
+
+size_t Lexer::SlotCount() const
+{
+    return slot_languages.size();
+}
+
+FILE_LANGUAGE Lexer::SlotLanguage(size_t slot) const
+{
+    return slot_languages[slot];
+}
+
+namespace
+{
+    // A line with any embedded code or comment on it belongs to the embedded language, a line with only
+    // the host's to the host, and a blank line to whichever language it is in. With Slots unset every
+    // line goes to counts[0].
+    template <bool Slots>
+    inline void EndLine(uint32_t marks, uint32_t slot, uint32_t embedded, LineCounts* counts)
+    {
+        uint32_t owner = 0;
+        if constexpr (Slots) {
+            owner = (marks >> Lexer::embedded_shift) ? embedded : marks ? 0 : slot;
+            if (owner) marks >>= Lexer::embedded_shift;
+        }
+        else {
+            marks |= marks >> Lexer::embedded_shift;
+        }
+
+        LineCounts& line = counts[owner];
+        line.total++;
+        line.code += marks & Lexer::mark_code;
+        line.comment += (marks >> 1) & ~marks & 1;
+        line.blank += (marks & (Lexer::mark_code | Lexer::mark_comment)) == 0;
+    }
+}
+
+void Lexer::Feed(State& state, const char* data, size_t size, LineCounts& counts) const
+{
+    FeedUnits<char, false>(state, data, size, &counts);
+}
+
+void Lexer::Feed(State& state, const char16_t* data, size_t size, LineCounts& counts) const
+{
+    FeedUnits<char16_t, false>(state, data, size, &counts);
+}
+
+void Lexer::Feed(State& state, const char32_t* data, size_t size, LineCounts& counts) const
+{
+    FeedUnits<char32_t, false>(state, data, size, &counts);
+}
+
+void Lexer::FeedSlots(State& state, const char* data, size_t size, LineCounts* counts) const
+{
+    FeedUnits<char, true>(state, data, size, counts);
+}
+
+void Lexer::FeedSlots(State& state, const char16_t* data, size_t size, LineCounts* counts) const
+{
+    FeedUnits<char16_t, true>(state, data, size, counts);
+}
+
+void Lexer::FeedSlots(State& state, const char32_t* data, size_t size, LineCounts* counts) const
+{
+    FeedUnits<char32_t, true>(state, data, size, counts);
+}
+
+template <typename Unit>
+uint8_t Lexer::ClassOf(Unit unit) const
+{
+    auto value = static_cast<std::make_unsigned_t<Unit>>(unit);
+    if constexpr (sizeof(Unit) == 1) {
+        return classes[value];
+    }
+    else {
+        return value < classes.size() ? classes[value] : other_class;
+    }
+}
+
+template <typename Unit, bool Slots>
+void Lexer::FeedUnits(State& state, const Unit* data, size_t size, LineCounts* counts) const
+{
+    if (size == 0) return;
+
+    const Unit* p = data;
+    const Unit* end = data + size;
+    uint32_t current = state.state;
+    uint32_t marks = state.marks;
+    uint32_t slot = state.slot;
+    uint32_t embedded = state.embedded;
+    const uint32_t* transitions = table.data();
+
+    while (p != end) {
+        if (special[current]) {
+            state.embedded = static_cast<uint8_t>(embedded);
+            p = FeedRawString<Unit, Slots>(state, p, end, marks, counts);
+            if (special[state.state]) break; // ran out of input inside the literal
+            current = state.state;
+            continue;
+        }
+
+        uint32_t entry = 0;
+        do {
+            Unit c = *p++;
+            entry = transitions[current * class_count + ClassOf(c)];
+            current = entry & state_mask;
+            marks |= (entry >> mark_shift) & mark_mask;
+            if (c == Unit('\n')) {
+                EndLine<Slots>(marks, slot, embedded, counts);
+                marks = 0;
+            }
+        } while (p != end && !(entry & special_bit));
+
+        if (entry & special_bit) {
+            state.raw_phase = 0;
+            state.raw_length = 0;
+            state.raw_match = 0;
+            slot = slots[current];
+            if (slot) embedded = slot;
+        }
+        state.state = static_cast<uint16_t>(current);
+    }
+
+    state.state = static_cast<uint16_t>(current);
+    state.marks = static_cast<uint8_t>(marks);
+    state.slot = static_cast<uint8_t>(slot);
+    state.embedded = static_cast<uint8_t>(embedded);
+    state.line_open = end[-1] != Unit('\n');
+}
+
+template <typename Unit, bool Slots>
+const Unit* Lexer::FeedRawString(State& state, const Unit* p, const Unit* end, uint32_t& marks, LineCounts* counts) const
+{
+    uint16_t raw_state = state.state;
+
+    while (p != end) {
+        auto unit = static_cast<std::make_unsigned_t<Unit>>(*p++);
+
+        // delimiters are basic source characters, so anything wider can't match one
+        char c = unit < 0x80 ? static_cast<char>(unit) : '\x80';
+        bool whitespace = unit < 0x80 && IsWhitespace(static_cast<unsigned char>(unit));
+        uint32_t slot = slots[raw_state];
+        if (!whitespace) marks |= slot ? mark_code << embedded_shift : mark_code;
+        if (c == '\n') {
+            EndLine<Slots>(marks, slot, slot ? slot : state.embedded, counts);
+            marks = 0;
+        }
+
+        if (state.raw_phase == 0) {
+            // reading the delimiter: R"delim(
+            if (c == '(') {
+                state.raw_phase = 1;
+            }
+            else if (state.raw_length < sizeof(state.raw_delimiter) && c != ')' && c != '\\' && c != '"' && !whitespace && unit < 0x80) {
+                state.raw_delimiter[state.raw_length++] = c;
+            }
+            else {
+                // not a valid raw string, carry on as code
+                state.state = special_return[raw_state];
+                return p;
+            }
+            continue;
+        }
+
+        // looking for )delim"
+        char expected = state.raw_match == 0 ? ')'
+            : state.raw_match <= state.raw_length ? state.raw_delimiter[state.raw_match - 1]
+            : '"';
+        if (c == expected) {
+            if (++state.raw_match == state.raw_length + 2) {
+                state.state = special_return[raw_state];
+                return p;
+            }
+        }
+        else {
+            state.raw_match = c == ')' ? 1 : 0;
+        }
+    }
+
+    return p;
+}
+
+void Lexer::Finish(State& state, LineCounts& counts) const
+{
+    FinishLine<false>(state, &counts);
+}
+
+void Lexer::FinishSlots(State& state, LineCounts* counts) const
+{
+    FinishLine<true>(state, counts);
+}
+
+template <bool Slots>
+void Lexer::FinishLine(State& state, LineCounts* counts) const
+{
+    uint32_t marks = state.marks;
+    if (!special[state.state]) marks |= eof_marks[state.state];
+
+    if (state.line_open) EndLine<Slots>(marks, state.slot, state.embedded, counts);
+
+    state = Start();
+}
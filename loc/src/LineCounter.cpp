@@ -1,90 +1,247 @@
 #include "LineCounter.h"
 
-unsigned long LineCounter::CountLines(const std::filesystem::path& path, const std::string& inlineComment,
-    const std::string& startMultilineComment, const std::string& endMultilineComment)
-{
-    unsigned long totalLines{};
+#include "FileReader.h"
+#include "Lexer.h"
+#include "PhysicalLines.h"
+#include "TextEncoding.h"
 
-    // Read file and get a vector of lines
-    std::vector<std::string> lines{};
-    FileReader::ReadFile(path, lines);
+#include <algorithm>
+#include <cstring>
 
-    bool InMultiLineComment{ false };
+namespace
+{
+    // ASCII view of the start of wide text, for the sniffer, in narrow which holds sniff_size bytes
+    template <typename Unit>
+    std::string_view Narrow(const Unit* units, size_t count, char* narrow)
+    {
+        count = std::min(count, Sniffer::sniff_size);
+        for (size_t i = 0; i < count; ++i) {
+            narrow[i] = units[i] < 0x80 ? static_cast<char>(units[i]) : '?';
+        }
+        return { narrow, count };
+    }
 
-    // count the lines
-    for (const auto& line : lines)
+    // Where the text of a file goes: the lexer, or only the physical line kernel. Every line goes
+    // to counts[0] unless the lexer has embedded languages, which have a slot each.
+    struct Sink
     {
-        // check for whitespace
-        if (line == "")
-            continue;
+        const Lexer& lexer;
+        bool physical;
+        LineCounts* counts;
+        Lexer::State state{ lexer.Start() };
+        PhysicalLines::State physical_state{};
 
-        bool InString{ false };
-        bool countLine{ true };
+        template <typename Unit>
+        void Feed(const Unit* data, size_t size)
+        {
+            if (physical) PhysicalLines::Feed(physical_state, data, size, counts[0]);
+            else if (lexer.SlotCount() == 1) lexer.Feed(state, data, size, counts[0]);
+            else lexer.FeedSlots(state, data, size, counts);
+        }
 
-        // check for multiline comments
-        for (size_t i = 0; i < line.size(); ++i)
+        void Finish()
         {
-            char c = line[i];
+            if (physical) PhysicalLines::Finish(physical_state, counts[0]);
+            else if (lexer.SlotCount() == 1) lexer.Finish(state, counts[0]);
+            else lexer.FinishSlots(state, counts);
+        }
+    };
 
-            // Toggle string state on encountering a double quote, ignoring escaped quotes
-            if (c == '\"' && (i == 0 || line[i - 1] != '\\'))
+    // Counts wide text a block at a time, returning what the sniffer made of it. The first size bytes are
+    // at data, inside buffer. Each block is converted to host order code units; a unit split across blocks
+    // is carried over to the next.
+    template <typename Unit>
+    FILE_KIND CountWide(FileReader& reader, std::vector<char>& buffer, std::vector<Unit>& units, const char* data, size_t size,
+        bool swap, bool skip_unusual, Tracer* tracer, Sink& sink)
+    {
+        units.resize(buffer.size() / sizeof(Unit));
+
+        if (skip_unusual) {
+            TraceSpan span{ tracer, "sniff", "classify" };
+            size_t count = TextEncoding::Decode(data, std::min(size, Sniffer::sniff_size * sizeof(Unit)), swap, units.data());
+            char narrow[Sniffer::sniff_size];
+            FILE_KIND kind = Sniffer::Sniff(Narrow(units.data(), count, narrow));
+            if (kind != FILE_KIND::Source) return kind;
+        }
+
+        while (size) {
+            size_t count = 0;
             {
-                InString = !InString;
+                TraceSpan span{ tracer, "lex", "classify" };
+                count = TextEncoding::Decode(data, size, swap, units.data());
+                sink.Feed(units.data(), count);
             }
 
-            if (!InString)
+            size_t rest = size - count * sizeof(Unit);
+            std::memmove(buffer.data(), data + count * sizeof(Unit), rest);
+            size_t n = 0;
             {
-                if (!InMultiLineComment && !startMultilineComment.empty())
-                {
-                    auto sLen = startMultilineComment.size();
-                    if (i + sLen <= line.size() && line.substr(i, sLen) == startMultilineComment)
-                    {
-                        InMultiLineComment = true;
-                        i += static_cast<int>(sLen) - 1; // Skip over the start marker
-                        continue;
-                    }
-                }
-
-                if (InMultiLineComment && !endMultilineComment.empty())
-                {
-                    auto eLen = endMultilineComment.size();
-                    if (i + eLen <= line.size() && line.substr(i, eLen) == endMultilineComment)
-                    {
-                        InMultiLineComment = false;
-                        i += static_cast<int>(eLen) - 1; // Skip over the end marker
-                        if (!startMultilineComment.empty() && line.ends_with(endMultilineComment) && StrContains(line, startMultilineComment) && !line.starts_with(startMultilineComment))
-                        {
-                            countLine = true;
-                        }
-                        else if (!endMultilineComment.empty() && StrContains(line, endMultilineComment) && !line.ends_with(endMultilineComment))
-                        {
-                            countLine = true;
-                        }
-                        else
-                        {
-                            // full line was commented
-                            countLine = false;
-                        }
-                        continue;
-                    }
-                }
+                TraceSpan span{ tracer, "read", "io" };
+                n = reader.Read(buffer.data() + rest, buffer.size() - rest);
             }
+            if (n == 0) break; // a trailing partial unit is ignored
+
+            data = buffer.data();
+            size = rest + n;
         }
 
-        // check for 1 line comments
-        if (!inlineComment.empty() && line.starts_with(inlineComment))
-            continue;
+        sink.Finish();
+        return FILE_KIND::Source;
+    }
+}
 
-        if (!InMultiLineComment && !InString && countLine)
-        {
-            totalLines++;
+LineCounts& LineCounts::operator+=(const LineCounts& other)
+{
+    code += other.code;
+    comment += other.comment;
+    blank += other.blank;
+    total += other.total;
+    return *this;
+}
+
+LineCounts& LineCounts::operator-=(const LineCounts& other)
+{
+    code -= other.code;
+    comment -= other.comment;
+    blank -= other.blank;
+    total -= other.total;
+    return *this;
+}
+
+LineCounter::LineCounter(bool skip_unusual, Tracer* tracer, bool physical)
+    : skip_unusual(skip_unusual), physical(physical), tracer(tracer)
+{
+}
+
+LineCounts LineCounter::CountLines(const std::filesystem::path& path, FILE_LANGUAGE language,
+    std::chrono::nanoseconds* first_read_latency)
+{
+    LineCounts counts{};
+    last_kind = FILE_KIND::Source;
+    last_size = 0;
+    last_error.clear();
+    last_embedded.clear();
+
+    auto opened_at = first_read_latency ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    FileReader reader;
+    {
+        TraceSpan span{ tracer, "open", "io" };
+        if (!reader.Open(path)) {
+            last_error = reader.Error();
+            return counts;
         }
     }
+    auto read = [&] {
+        TraceSpan span{ tracer, "read", "io" };
+        return reader.Read(buffer.data(), buffer.size());
+    };
+
+    const Lexer& lexer = Lexer::ForSyntax(LanguageRegistry::GetInfo(language).syntax);
+    BeginSlots(lexer);
+    Sink sink{ lexer, physical, slot_counts.data() };
+
+    // classify each block as it is read; the lexer state carries across blocks
+    buffer.resize(physical ? physical_block_size : FileReader::block_size);
+    size_t n = read();
+    if (first_read_latency) *first_read_latency = std::chrono::steady_clock::now() - opened_at;
+
+    // the first block tells the encoding; the byte order mark isn't part of the first line
+    size_t bom_length = 0;
+    TEXT_ENCODING encoding = TextEncoding::Detect({ buffer.data(), n }, bom_length);
+    const char* data = buffer.data() + bom_length;
+    size_t size = n - bom_length;
+    bool swap = TextEncoding::NeedsSwap(encoding);
 
-    return totalLines;
+    if (TextEncoding::UnitSize(encoding) == 2) {
+        last_kind = CountWide(reader, buffer, wide16, data, size, swap, skip_unusual, tracer, sink);
+        last_size = reader.BytesRead();
+        last_error = reader.Error();
+        return EndSlots(lexer);
+    }
+    if (TextEncoding::UnitSize(encoding) == 4) {
+        last_kind = CountWide(reader, buffer, wide32, data, size, swap, skip_unusual, tracer, sink);
+        last_size = reader.BytesRead();
+        last_error = reader.Error();
+        return EndSlots(lexer);
+    }
+
+    // the first block is enough to spot files that aren't worth classifying
+    if (skip_unusual) {
+        TraceSpan span{ tracer, "sniff", "classify" };
+        last_kind = Sniffer::Sniff({ data, size });
+        if (last_kind != FILE_KIND::Source) {
+            last_size = reader.BytesRead();
+            return counts;
+        }
+    }
+
+    auto feed = [&](const char* block, size_t length) {
+        TraceSpan span{ tracer, "lex", "classify" };
+        sink.Feed(block, length);
+    };
+    if (size) feed(data, size);
+    n = read();
+    while (n) {
+        feed(buffer.data(), n);
+        n = read();
+    }
+    sink.Finish();
+    last_size = reader.BytesRead();
+    last_error = reader.Error();
+
+    return EndSlots(lexer);
+}
+
+LineCounts LineCounter::CountText(std::string_view text, FILE_LANGUAGE language)
+{
+    const Lexer& lexer = Lexer::ForSyntax(LanguageRegistry::GetInfo(language).syntax);
+    BeginSlots(lexer);
+    Sink sink{ lexer, physical, slot_counts.data() };
+
+    // in memory text is UTF-8; skip its byte order mark
+    size_t bom_length = 0;
+    if (TextEncoding::Detect(text, bom_length) == TEXT_ENCODING::Utf8) text.remove_prefix(bom_length);
+
+    sink.Feed(text.data(), text.size());
+    sink.Finish();
+
+    return EndSlots(lexer);
+}
+
+const std::vector<LineCounter::EmbeddedLines>& LineCounter::LastEmbedded() const
+{
+    return last_embedded;
+}
+
+void LineCounter::BeginSlots(const Lexer& lexer)
+{
+    slot_counts.assign(lexer.SlotCount(), LineCounts{});
+    last_embedded.clear();
+}
+
+LineCounts LineCounter::EndSlots(const Lexer& lexer)
+{
+    // the total includes the embedded languages; only those that had lines are listed
+    LineCounts counts = slot_counts[0];
+    for (size_t slot = 1; slot < slot_counts.size(); ++slot) {
+        if (slot_counts[slot].total == 0) continue;
+        counts += slot_counts[slot];
+        last_embedded.push_back({ lexer.SlotLanguage(slot), slot_counts[slot] });
+    }
+    return counts;
+}
+
+FILE_KIND LineCounter::LastKind() const
+{
+    return last_kind;
+}
+
+uint64_t LineCounter::LastSize() const
+{
+    return last_size;
 }
 
-bool LineCounter::StrContains(const std::string& str, const std::string& substr)
+std::error_code LineCounter::LastError() const
 {
-    return str.find(substr) != std::string::npos;
+    return last_error;
 }
@@ -0,0 +1,111 @@
+#include "PartialResult.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace
+{
+	// the first field of the line of skipped files; no language has this name
+	constexpr std::string_view skipped_name = "skipped";
+
+	constexpr FILE_KIND skipped_kinds[] = { FILE_KIND::Binary, FILE_KIND::Minified, FILE_KIND::Generated };
+}
+
+bool PartialResult::Save(const std::filesystem::path& path, const std::map<FILE_LANGUAGE, LanguageTotals>& counts,
+	const SkippedCounts& skipped)
+{
+	std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+	if (!file.is_open())
+	{
+		std::cerr << "Error: unable to write partial result: " << path << "\n";
+		return false;
+	}
+
+	file << "loc-partial " << version << "\n";
+	for (const auto& [language, totals] : counts)
+	{
+		file << LanguageRegistry::GetInfo(language).name << '\t'
+			<< totals.files << '\t'
+			<< totals.lines.code << '\t'
+			<< totals.lines.comment << '\t'
+			<< totals.lines.blank << '\t'
+			<< totals.lines.total << '\n';
+	}
+
+	file << skipped_name;
+	for (auto kind : skipped_kinds) file << '\t' << skipped[static_cast<size_t>(kind)];
+	file << '\n';
+
+	return static_cast<bool>(file);
+}
+
+bool PartialResult::Load(const std::filesystem::path& path, std::map<FILE_LANGUAGE, LanguageTotals>& counts,
+	SkippedCounts* skipped)
+{
+	std::ifstream file{ path, std::ios::binary };
+	if (!file.is_open())
+	{
+		std::cerr << "Error: unable to open partial result: " << path << "\n";
+		return false;
+	}
+
+	std::string line;
+	int file_version = 0;
+	if (!std::getline(file, line) || std::sscanf(line.c_str(), "loc-partial %d", &file_version) != 1 || file_version < 1 || file_version > version)
+	{
+		std::cerr << "Error: not a loc partial result (version " << version << "): " << path << "\n";
+		return false;
+	}
+
+	// parse everything before touching counts, so a bad file doesn't leave a half merged total
+	std::map<FILE_LANGUAGE, LanguageTotals> loaded;
+	SkippedCounts loaded_skipped{};
+	while (std::getline(file, line))
+	{
+		if (line.empty()) continue;
+
+		auto tab = line.find('\t');
+		if (std::string_view(line).substr(0, tab) == skipped_name)
+		{
+			std::istringstream fields{ tab == std::string::npos ? std::string{} : line.substr(tab + 1) };
+			for (auto kind : skipped_kinds) fields >> loaded_skipped[static_cast<size_t>(kind)];
+			if (fields.fail())
+			{
+				std::cerr << "Error: malformed line in partial result " << path << ": " << line << "\n";
+				return false;
+			}
+			continue;
+		}
+
+		auto language = LanguageRegistry::FromName(std::string_view(line).substr(0, tab));
+
+		LanguageTotals totals{};
+		std::istringstream fields{ tab == std::string::npos ? std::string{} : line.substr(tab + 1) };
+		fields >> totals.files >> totals.lines.code >> totals.lines.comment >> totals.lines.blank >> totals.lines.total;
+
+		if (!language || fields.fail())
+		{
+			std::cerr << "Error: malformed line in partial result " << path << ": " << line << "\n";
+			return false;
+		}
+
+		loaded[*language].files += totals.files;
+		loaded[*language].lines += totals.lines;
+	}
+
+	for (const auto& [language, totals] : loaded)
+	{
+		counts[language].files += totals.files;
+		counts[language].lines += totals.lines;
+	}
+	if (skipped)
+	{
+		for (size_t kind = 0; kind < skipped->size(); ++kind) (*skipped)[kind] += loaded_skipped[kind];
+	}
+
+	return true;
+}
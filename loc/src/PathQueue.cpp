@@ -0,0 +1,43 @@
+#include "PathQueue.h"
+
+#include <algorithm>
+
+PathQueue::PathQueue(size_t capacity)
+	: capacity(std::max<size_t>(capacity, 1))
+{
+}
+
+void PathQueue::Push(std::filesystem::path path)
+{
+	{
+		std::unique_lock lock(mutex);
+		not_full.wait(lock, [this] { return items.size() < capacity; });
+		items.push_back(std::move(path));
+	}
+	not_empty.notify_one();
+}
+
+void PathQueue::Close()
+{
+	{
+		std::scoped_lock lock(mutex);
+		closed = true;
+	}
+	not_empty.notify_all();
+}
+
+bool PathQueue::PopBatch(std::vector<std::filesystem::path>& out, size_t max_paths)
+{
+	out.clear();
+	{
+		std::unique_lock lock(mutex);
+		not_empty.wait(lock, [this] { return !items.empty() || closed; });
+		if (items.empty()) return false;
+
+		size_t count = std::min(max_paths, items.size());
+		std::move(items.begin(), items.begin() + count, std::back_inserter(out));
+		items.erase(items.begin(), items.begin() + count);
+	}
+	not_full.notify_one();
+	return true;
+}
@@ -0,0 +1,136 @@
+#include "PhysicalLines.h"
+
+#include <bit>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Same whitespace as the lexer: space, \t, \n, \v, \f and \r
+	template <typename Unit>
+	constexpr bool IsWhitespace(Unit c)
+	{
+		auto unit = static_cast<std::make_unsigned_t<Unit>>(c);
+		return unit == ' ' || (unit >= '\t' && unit <= '\r');
+	}
+
+	// Bit i of newlines is set when unit i is a newline, and bit i of text when it isn't whitespace
+	template <typename Unit>
+	void Masks(const Unit* units, size_t count, uint64_t& newlines, uint64_t& text)
+	{
+		newlines = 0;
+		text = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			newlines |= uint64_t{ units[i] == Unit('\n') } << i;
+			text |= uint64_t{ !IsWhitespace(units[i]) } << i;
+		}
+	}
+
+#ifdef LOC_SSE2
+	void Masks64(const char* bytes, uint64_t& newlines, uint64_t& text)
+	{
+		const __m128i newline = _mm_set1_epi8('\n');
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i tab = _mm_set1_epi8('\t');
+		const __m128i four = _mm_set1_epi8(4);
+		const __m128i zero = _mm_setzero_si128();
+
+		newlines = 0;
+		uint64_t whitespace = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 16 * i));
+
+			// \t to \r are the bytes that are at most 4 above \t, compared without sign by saturating
+			__m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, tab), four), zero);
+			__m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, space), control);
+
+			newlines |= uint64_t{ static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline))) } << (16 * i);
+			whitespace |= uint64_t{ static_cast<uint16_t>(_mm_movemask_epi8(blank)) } << (16 * i);
+		}
+		text = ~whitespace;
+	}
+#else
+	void Masks64(const char* bytes, uint64_t& newlines, uint64_t& text)
+	{
+		Masks(bytes, PhysicalLines::chunk_size, newlines, text);
+	}
+#endif
+
+	// Counts the lines ended in a chunk, and the lines of them that have text. Adding the text bits to
+	// the bits that aren't newlines carries out of every line with text into the newline that ends it;
+	// the carry out of the top of the chunk is whether the open line has text. No branch per line.
+	void CountChunk(uint64_t newlines, uint64_t text_bits, bool& text, unsigned long& lines, unsigned long& code)
+	{
+		uint64_t sum = ~newlines + text_bits;
+		bool carry = sum < text_bits;
+		uint64_t carried = sum + text;
+		carry = carry || carried < sum;
+
+		lines += static_cast<unsigned long>(std::popcount(newlines));
+		code += static_cast<unsigned long>(std::popcount(carried & newlines));
+		text = carry;
+	}
+
+	template <typename Unit>
+	void FeedUnits(PhysicalLines::State& state, const Unit* data, size_t size, LineCounts& counts)
+	{
+		if (size == 0) return;
+
+		unsigned long lines = 0;
+		unsigned long code = 0;
+		bool text = state.text;
+		uint64_t newlines = 0;
+		uint64_t text_bits = 0;
+
+		size_t i = 0;
+		for (; i + PhysicalLines::chunk_size <= size; i += PhysicalLines::chunk_size)
+		{
+			if constexpr (std::is_same_v<Unit, char>) Masks64(data + i, newlines, text_bits);
+			else Masks(data + i, PhysicalLines::chunk_size, newlines, text_bits);
+			CountChunk(newlines, text_bits, text, lines, code);
+		}
+		if (i < size)
+		{
+			Masks(data + i, size - i, newlines, text_bits);
+			CountChunk(newlines, text_bits, text, lines, code);
+		}
+
+		counts.total += lines;
+		counts.code += code;
+		counts.blank += lines - code;
+		state.text = text;
+		state.line_open = data[size - 1] != Unit('\n');
+	}
+}
+
+void PhysicalLines::Feed(State& state, const char* data, size_t size, LineCounts& counts)
+{
+	FeedUnits(state, data, size, counts);
+}
+
+void PhysicalLines::Feed(State& state, const char16_t* data, size_t size, LineCounts& counts)
+{
+	FeedUnits(state, data, size, counts);
+}
+
+void PhysicalLines::Feed(State& state, const char32_t* data, size_t size, LineCounts& counts)
+{
+	FeedUnits(state, data, size, counts);
+}
+
+void PhysicalLines::Finish(State& state, LineCounts& counts)
+{
+	if (state.line_open)
+	{
+		counts.total++;
+		if (state.text) counts.code++;
+		else counts.blank++;
+	}
+	state = {};
+}
@@ -0,0 +1,148 @@
+#include "Prefetcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+	// Only the start of a file is requested; once a worker is reading sequentially the kernel's own readahead takes over
+	constexpr off_t prefetch_bytes = 1 << 20;
+
+	// How often the window is re-sized from the workers' progress
+	constexpr auto sample_interval = std::chrono::milliseconds(10);
+
+	// How long to wait when the prefetcher is a full window ahead
+	constexpr auto idle_wait = std::chrono::microseconds(500);
+
+	void Advise(const std::filesystem::path& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+		if (fd < 0) fd = open(path.c_str(), O_RDONLY | O_CLOEXEC); // O_NOATIME needs ownership
+		if (fd < 0) return; // the worker will report the error
+
+		// starts the read asynchronously; the pages stay in the cache after the descriptor is closed
+		posix_fadvise(fd, 0, prefetch_bytes, POSIX_FADV_WILLNEED);
+		close(fd);
+	}
+#endif
+}
+
+Prefetcher::Prefetcher(const std::vector<std::filesystem::path>& paths, const std::atomic<size_t>& next_index, size_t claimed,
+	size_t min_window, size_t max_window)
+	: paths(paths), next_index(next_index), claimed(claimed)
+{
+	this->min_window = std::max<size_t>(min_window, 1);
+	this->max_window = std::max(max_window == 0 ? default_max_window : max_window, this->min_window);
+	window = this->min_window;
+}
+
+Prefetcher::~Prefetcher()
+{
+	Stop();
+}
+
+void Prefetcher::Start()
+{
+#ifdef __linux__
+	if (!thread.joinable())
+	{
+		thread = std::jthread([this](std::stop_token stop) { Run(stop); });
+	}
+#endif
+}
+
+void Prefetcher::Stop()
+{
+	if (thread.joinable())
+	{
+		thread.request_stop();
+		thread.join();
+	}
+}
+
+void Prefetcher::RecordReadLatency(std::chrono::nanoseconds latency)
+{
+	// Lost updates between workers only make the average a little noisier
+	int64_t average = latency_ns.load(std::memory_order_relaxed);
+	latency_ns.store(average + (latency.count() - average) / 8, std::memory_order_relaxed);
+}
+
+size_t Prefetcher::Window() const
+{
+	return window.load(std::memory_order_relaxed);
+}
+
+size_t Prefetcher::Prefetched() const
+{
+	return prefetched.load(std::memory_order_relaxed);
+}
+
+size_t Prefetcher::ComputeWindow(std::chrono::nanoseconds latency, double files_per_second, size_t min_window, size_t max_window)
+{
+	// Little's law: files in flight = arrival rate * latency. Twice that absorbs bursts of slow reads.
+	double in_flight = std::chrono::duration<double>(latency).count() * files_per_second;
+	double wanted = std::ceil(2 * in_flight) + static_cast<double>(min_window);
+	if (!(wanted < static_cast<double>(max_window))) return max_window;
+	return std::max(static_cast<size_t>(wanted), min_window);
+}
+
+size_t Prefetcher::DampWindow(size_t window, size_t wanted)
+{
+	if (wanted > window + window / 4) return std::min(wanted, window * 2);
+	if (wanted + window / 4 < window) return std::max(wanted, window / 2);
+	return window;
+}
+
+void Prefetcher::Run(std::stop_token stop)
+{
+#ifdef __linux__
+	// the workers overshoot next_index past the end when they run out
+	auto claimed_end = [this] { return std::min(next_index.load(std::memory_order_relaxed), paths.size()); };
+
+	size_t ahead = claimed_end() - std::min(claimed_end(), claimed);
+	size_t sampled_index = claimed_end();
+	auto sampled_at = std::chrono::steady_clock::now();
+
+	while (!stop.stop_requested())
+	{
+		size_t current = claimed_end();
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - sampled_at >= sample_interval)
+		{
+			double elapsed = std::chrono::duration<double>(now - sampled_at).count();
+			double files_per_second = static_cast<double>(current - sampled_index) / elapsed;
+			auto latency = std::chrono::nanoseconds(latency_ns.load(std::memory_order_relaxed));
+			size_t wanted = ComputeWindow(latency, files_per_second, min_window, max_window);
+			window.store(DampWindow(Window(), wanted), std::memory_order_relaxed);
+
+			sampled_index = current;
+			sampled_at = now;
+		}
+
+		// the batches the workers have claimed may not have been opened yet, but anything before them has
+		ahead = std::max(ahead, current - std::min(current, claimed));
+		if (ahead < std::min(paths.size(), current + Window()))
+		{
+			Advise(paths[ahead++]);
+			prefetched.fetch_add(1, std::memory_order_relaxed);
+		}
+		else if (current == paths.size())
+		{
+			return;
+		}
+		else
+		{
+			std::this_thread::sleep_for(idle_wait);
+		}
+	}
+#else
+	(void)stop;
+#endif
+}
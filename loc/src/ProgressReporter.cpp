@@ -0,0 +1,180 @@
+#include "ProgressReporter.h"
+
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+namespace
+{
+	void AppendJsonString(std::ostringstream& out, const std::string& text)
+	{
+		out << '"';
+		for (unsigned char c : text)
+		{
+			if (c == '"' || c == '\\') out << '\\' << c;
+			else if (c < 0x20)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out << escaped;
+			}
+			else out << c;
+		}
+		out << '"';
+	}
+
+	// 1.5 MB, 20.3 GB, ...
+	std::string FormatBytes(double bytes)
+	{
+		const char* units[]{ "B", "KB", "MB", "GB", "TB" };
+		int unit = 0;
+		while (bytes >= 1024 && unit < 4)
+		{
+			bytes /= 1024;
+			unit++;
+		}
+
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << ' ' << units[unit];
+		return out.str();
+	}
+
+	// h:mm:ss
+	std::string FormatDuration(double seconds)
+	{
+		auto total = static_cast<long long>(seconds + 0.5);
+		std::ostringstream out;
+		out << total / 3600 << ':' << std::setfill('0') << std::setw(2) << total / 60 % 60 << ':' << std::setw(2) << total % 60;
+		return out.str();
+	}
+}
+
+void WorkerProgress::Begin(size_t index)
+{
+	current.store(index, std::memory_order_relaxed);
+}
+
+void WorkerProgress::Done(uint64_t file_bytes)
+{
+	// only this worker writes its counters, so a load and a store is enough
+	files.store(files.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	bytes.store(bytes.load(std::memory_order_relaxed) + file_bytes, std::memory_order_relaxed);
+	current.store(idle, std::memory_order_relaxed);
+}
+
+ProgressReporter::ProgressReporter(const std::vector<std::filesystem::path>& paths, unsigned int workers,
+	PROGRESS_FORMAT format, std::chrono::milliseconds interval, std::ostream& out)
+	: paths(paths), worker_count(workers), workers(std::make_unique<WorkerProgress[]>(workers)),
+	format(format), interval(interval), out(out)
+{
+	started = last_sample = std::chrono::steady_clock::now();
+}
+
+ProgressReporter::~ProgressReporter()
+{
+	Stop();
+}
+
+WorkerProgress& ProgressReporter::Worker(unsigned int index)
+{
+	return workers[index];
+}
+
+void ProgressReporter::Start()
+{
+	started = last_sample = std::chrono::steady_clock::now();
+	thread = std::jthread([this](std::stop_token stop) { Run(stop); });
+}
+
+void ProgressReporter::Stop()
+{
+	if (!thread.joinable()) return;
+
+	thread.request_stop();
+	thread.join();
+
+	out << Report() << '\n' << std::flush;
+}
+
+void ProgressReporter::Run(std::stop_token stop)
+{
+	std::unique_lock lock(mutex);
+	while (!wake.wait_for(lock, stop, interval, [] { return false; }))
+	{
+		if (stop.stop_requested()) return;
+
+		// text rewrites its line; JSON is one object per line
+		if (format == PROGRESS_FORMAT::Text) out << '\r' << Report() << std::flush;
+		else out << Report() << '\n' << std::flush;
+	}
+}
+
+std::string ProgressReporter::Report()
+{
+	uint64_t files = 0;
+	uint64_t bytes = 0;
+	unsigned int busy = 0;
+	for (unsigned int i = 0; i < worker_count; ++i)
+	{
+		files += workers[i].files.load(std::memory_order_relaxed);
+		bytes += workers[i].bytes.load(std::memory_order_relaxed);
+		busy += workers[i].current.load(std::memory_order_relaxed) != WorkerProgress::idle;
+	}
+
+	// current throughput over the last interval; the ETA uses the average so far, which is steadier
+	auto now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - started).count();
+	double since_last = std::chrono::duration<double>(now - last_sample).count();
+	double files_per_second = since_last > 0 ? static_cast<double>(files - last_files) / since_last : 0.0;
+	double bytes_per_second = since_last > 0 ? static_cast<double>(bytes - last_bytes) / since_last : 0.0;
+	double average_rate = elapsed > 0 ? static_cast<double>(files) / elapsed : 0.0;
+	bool known_total = !paths.empty();
+	double eta = average_rate > 0 ? static_cast<double>(paths.size() - std::min<uint64_t>(files, paths.size())) / average_rate : 0.0;
+	last_sample = now;
+	last_files = files;
+	last_bytes = bytes;
+
+	std::ostringstream report;
+	if (format == PROGRESS_FORMAT::Json)
+	{
+		report << std::fixed << std::setprecision(1)
+			<< "{\"elapsed_seconds\":" << elapsed
+			<< ",\"files_done\":" << files
+			<< ",\"files_total\":";
+		if (known_total) report << paths.size();
+		else report << "null";
+		report
+			<< ",\"bytes_done\":" << bytes
+			<< ",\"files_per_second\":" << files_per_second
+			<< ",\"bytes_per_second\":" << bytes_per_second
+			<< ",\"eta_seconds\":";
+		if (known_total) report << eta;
+		else report << "null";
+		report << ",\"workers\":[";
+		for (unsigned int i = 0; i < worker_count; ++i)
+		{
+			size_t current = workers[i].current.load(std::memory_order_relaxed);
+			report << (i ? "," : "")
+				<< "{\"files\":" << workers[i].files.load(std::memory_order_relaxed)
+				<< ",\"bytes\":" << workers[i].bytes.load(std::memory_order_relaxed)
+				<< ",\"current\":";
+			if (current < paths.size()) AppendJsonString(report, paths[current].string());
+			else report << "null";
+			report << '}';
+		}
+		report << "]}";
+	}
+	else
+	{
+		report << files;
+		if (known_total) report << '/' << paths.size();
+		report << " files, " << FormatBytes(static_cast<double>(bytes))
+			<< ", " << std::fixed << std::setprecision(0) << files_per_second << " files/s, "
+			<< FormatBytes(bytes_per_second) << "/s";
+		if (known_total) report << ", ETA " << FormatDuration(eta);
+		report << ", " << busy << '/' << worker_count << " workers busy   ";
+	}
+
+	return report.str();
+}
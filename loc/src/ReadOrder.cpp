@@ -0,0 +1,212 @@
+#include "ReadOrder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <linux/magic.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	struct PhysicalKey
+	{
+		uint64_t device;
+		uint64_t position;
+		size_t index;
+	};
+
+#ifdef __linux__
+	constexpr long CIFS_MAGIC = 0xFF534D42;
+	constexpr long SMB2_MAGIC = 0xFE534D42;
+
+	// Physical byte offset of the start of the file, or false if the file system doesn't support FIEMAP
+	bool FirstExtent(const char* path, uint64_t& physical)
+	{
+		int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOATIME);
+		if (fd < 0) fd = open(path, O_RDONLY | O_CLOEXEC); // O_NOATIME needs ownership
+		if (fd < 0) return false;
+
+		// fiemap header followed by room for a single extent
+		alignas(fiemap) unsigned char request[sizeof(fiemap) + sizeof(fiemap_extent)]{};
+		auto* map = reinterpret_cast<fiemap*>(request);
+		map->fm_length = FIEMAP_MAX_OFFSET;
+		map->fm_extent_count = 1;
+
+		bool ok = ioctl(fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0;
+		if (ok) physical = map->fm_extents[0].fe_physical;
+
+		close(fd);
+		return ok;
+	}
+
+	void LookupKeys(const std::vector<std::filesystem::path>& paths, std::vector<PhysicalKey>& keys,
+		size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			auto& key = keys[i];
+			key.index = i;
+
+			// files that can't be stat'ed sort last; the worker will report the error
+			struct statx stx{};
+			if (statx(AT_FDCWD, paths[i].c_str(), AT_STATX_DONT_SYNC, STATX_INO, &stx) != 0)
+			{
+				key.device = UINT64_MAX;
+				key.position = UINT64_MAX;
+				continue;
+			}
+
+			key.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+			key.position = stx.stx_ino;
+		}
+	}
+
+	// Files on storage that isn't reordered keep their place; the others are placed by their first extent, if asked
+	void PlaceKeys(const std::vector<std::filesystem::path>& paths, std::vector<PhysicalKey>& keys,
+		const std::vector<uint64_t>& ordered_devices, size_t begin, size_t end, READ_ORDER order)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			auto& key = keys[i];
+			if (key.device == UINT64_MAX) continue;
+			if (!std::binary_search(ordered_devices.begin(), ordered_devices.end(), key.device))
+			{
+				key.position = key.index;
+				continue;
+			}
+
+			uint64_t physical = 0;
+			if (order == READ_ORDER::Extent && FirstExtent(paths[i].c_str(), physical))
+			{
+				key.position = physical;
+			}
+		}
+	}
+
+	// Calls work(begin, end) on up to jobs threads, each taking a contiguous slice of [0, count)
+	template <typename Work>
+	void ForSlices(size_t count, unsigned int jobs, const Work& work)
+	{
+		size_t threads = std::clamp<size_t>(jobs, 1, count);
+		size_t slice = (count + threads - 1) / threads;
+		std::vector<std::jthread> workers;
+		for (size_t begin = 0; begin < count; begin += slice)
+		{
+			workers.emplace_back([&work, begin, end = std::min(begin + slice, count)] { work(begin, end); });
+		}
+	}
+
+	bool IsRotational(unsigned int major_number, unsigned int minor_number)
+	{
+		// partitions don't have a queue directory of their own; their parent disk does
+		std::string device = "/sys/dev/block/" + std::to_string(major_number) + ":" + std::to_string(minor_number);
+		for (const char* queue : { "/queue/rotational", "/../queue/rotational" })
+		{
+			std::ifstream file{ device + queue };
+			int rotational = 0;
+			if (file >> rotational) return rotational == 1;
+		}
+		return false;
+	}
+#endif
+}
+
+bool ReadOrder::BenefitsFromOrdering(const std::filesystem::path& path)
+{
+#ifdef __linux__
+	struct statfs fs{};
+	if (statfs(path.c_str(), &fs) != 0) return false;
+
+	switch (static_cast<long>(fs.f_type))
+	{
+	case TMPFS_MAGIC:
+	case RAMFS_MAGIC:
+		return false;
+	case NFS_SUPER_MAGIC:
+	case CIFS_MAGIC:
+	case SMB2_MAGIC:
+		return true;
+	default:
+		break;
+	}
+
+	struct stat st{};
+	if (stat(path.c_str(), &st) != 0) return false;
+	return IsRotational(major(st.st_dev), minor(st.st_dev));
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+bool ReadOrder::Sort(std::vector<std::filesystem::path>& paths, READ_ORDER order, unsigned int jobs, bool force)
+{
+	auto ordered = Order(paths, order, jobs, force);
+	if (ordered.empty()) return false;
+
+	std::vector<std::filesystem::path> sorted;
+	sorted.reserve(paths.size());
+	for (size_t index : ordered) sorted.push_back(std::move(paths[index]));
+	paths = std::move(sorted);
+	return true;
+}
+
+std::vector<size_t> ReadOrder::Order(const std::vector<std::filesystem::path>& paths, READ_ORDER order, unsigned int jobs, bool force)
+{
+	if (force) return OrderWhere(paths, order, jobs, [](const std::filesystem::path&) { return true; });
+	return OrderWhere(paths, order, jobs, BenefitsFromOrdering);
+}
+
+std::vector<size_t> ReadOrder::OrderWhere(const std::vector<std::filesystem::path>& paths, READ_ORDER order, unsigned int jobs,
+	const std::function<bool(const std::filesystem::path&)>& benefits)
+{
+#ifdef __linux__
+	if (order == READ_ORDER::None || paths.size() < 2) return {};
+
+	// Look up the metadata in parallel
+	std::vector<PhysicalKey> keys(paths.size());
+	ForSlices(paths.size(), jobs, [&](size_t begin, size_t end) { LookupKeys(paths, keys, begin, end); });
+
+	// Ask about the storage of each device once, with the first of its files
+	std::vector<uint64_t> seen_devices{};
+	std::vector<uint64_t> ordered_devices{};
+	for (const auto& key : keys)
+	{
+		if (key.device == UINT64_MAX || std::find(seen_devices.begin(), seen_devices.end(), key.device) != seen_devices.end()) continue;
+
+		seen_devices.push_back(key.device);
+		if (benefits(paths[key.index])) ordered_devices.push_back(key.device);
+	}
+	if (ordered_devices.empty()) return {};
+
+	std::sort(ordered_devices.begin(), ordered_devices.end());
+	ForSlices(paths.size(), jobs, [&](size_t begin, size_t end) { PlaceKeys(paths, keys, ordered_devices, begin, end, order); });
+
+	std::sort(keys.begin(), keys.end(), [](const PhysicalKey& a, const PhysicalKey& b) {
+		return a.device != b.device ? a.device < b.device : a.position < b.position;
+	});
+
+	std::vector<size_t> ordered;
+	ordered.reserve(paths.size());
+	for (const auto& key : keys) ordered.push_back(key.index);
+	return ordered;
+#else
+	(void)paths;
+	(void)order;
+	(void)jobs;
+	(void)benefits;
+	return {};
+#endif
+}
@@ -0,0 +1,110 @@
+#include "ScanFilter.h"
+
+#include <chrono>
+#include <charconv>
+#include <system_error>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	// A whole number taking up all of text
+	template <typename Number>
+	std::optional<Number> ParseNumber(std::string_view text)
+	{
+		Number value{};
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (text.empty() || error != std::errc{} || end != text.data() + text.size()) return std::nullopt;
+		return value;
+	}
+}
+
+bool ScanFilter::NeedsMetadata() const
+{
+	return min_size > 0 || max_size < std::numeric_limits<uintmax_t>::max()
+		|| newer_than > std::numeric_limits<int64_t>::min() || older_than < std::numeric_limits<int64_t>::max();
+}
+
+bool ScanFilter::Admits(uintmax_t size, int64_t modified) const
+{
+	return size >= min_size && size <= max_size && modified >= newer_than && modified < older_than;
+}
+
+bool ScanFilter::Metadata(const std::filesystem::path& file, uintmax_t& size, int64_t& modified)
+{
+#ifdef __linux__
+	struct statx stx{};
+	if (statx(AT_FDCWD, file.c_str(), AT_STATX_DONT_SYNC, STATX_SIZE | STATX_MTIME, &stx) != 0) return false;
+
+	size = stx.stx_size;
+	modified = stx.stx_mtime.tv_sec;
+	return true;
+#else
+	std::error_code ec;
+	size = std::filesystem::file_size(file, ec);
+	if (ec) return false;
+	auto written = std::filesystem::last_write_time(file, ec);
+	if (ec) return false;
+
+	modified = std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::file_clock::to_sys(written).time_since_epoch()).count();
+	return true;
+#endif
+}
+
+std::optional<uintmax_t> ScanFilter::ParseSize(std::string_view text)
+{
+	unsigned int shift = 0;
+	if (!text.empty())
+	{
+		switch (text.back())
+		{
+		case 'k': case 'K': shift = 10; break;
+		case 'm': case 'M': shift = 20; break;
+		case 'g': case 'G': shift = 30; break;
+		case 't': case 'T': shift = 40; break;
+		}
+		if (shift) text.remove_suffix(1);
+	}
+
+	auto value = ParseNumber<uintmax_t>(text);
+	if (!value || *value > (std::numeric_limits<uintmax_t>::max() >> shift)) return std::nullopt;
+	return *value << shift;
+}
+
+std::optional<int64_t> ScanFilter::ParseTime(std::string_view text, int64_t now)
+{
+	// a date: YYYY-MM-DD
+	if (text.size() == 10 && text[4] == '-' && text[7] == '-')
+	{
+		auto year = ParseNumber<int>(text.substr(0, 4));
+		auto month = ParseNumber<unsigned int>(text.substr(5, 2));
+		auto day = ParseNumber<unsigned int>(text.substr(8, 2));
+		if (!year || !month || !day) return std::nullopt;
+
+		std::chrono::year_month_day date{ std::chrono::year{ *year }, std::chrono::month{ *month }, std::chrono::day{ *day } };
+		if (!date.ok()) return std::nullopt;
+		return std::chrono::sys_seconds{ std::chrono::sys_days{ date } }.time_since_epoch().count();
+	}
+
+	// an age: a number of seconds, minutes, hours, days or weeks
+	if (text.empty()) return std::nullopt;
+	int64_t unit = 0;
+	switch (text.back())
+	{
+	case 's': unit = 1; break;
+	case 'm': unit = 60; break;
+	case 'h': unit = 60 * 60; break;
+	case 'd': unit = 24 * 60 * 60; break;
+	case 'w': unit = 7 * 24 * 60 * 60; break;
+	default: return std::nullopt;
+	}
+	text.remove_suffix(1);
+
+	auto count = ParseNumber<int64_t>(text);
+	if (!count || *count < 0 || *count > std::numeric_limits<int64_t>::max() / unit) return std::nullopt;
+	return now - *count * unit;
+}
@@ -0,0 +1,436 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <tuple>
+
+namespace
+{
+	constexpr char magic[8] = { 'L', 'O', 'C', 'S', 'N', 'A', 'P', '\0' };
+
+	// reads back as something else on a machine of the other byte order
+	constexpr uint32_t byte_order = 0x01020304;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t language_count;
+		uint32_t reserved;
+		uint64_t directory_count;
+		uint64_t file_count;
+		uint64_t string_bytes;
+		int64_t created;
+		uint64_t reserved2;
+	};
+
+	struct StringRecord
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct DirectoryRecord
+	{
+		StringRecord path;
+		uint32_t first_file;
+		uint32_t file_count;
+	};
+
+	struct FileRecord
+	{
+		uint32_t directory;
+		StringRecord name;
+		uint16_t language;
+		uint16_t embedded;
+		uint32_t code;
+		uint32_t comment;
+		uint32_t blank;
+		uint32_t total;
+		uint64_t size;
+		int64_t modified;
+	};
+
+	static_assert(sizeof(Header) == 64);
+	static_assert(sizeof(StringRecord) == 8);
+	static_assert(sizeof(DirectoryRecord) == 16);
+	static_assert(sizeof(FileRecord) == 48);
+
+	std::string Utf8(const std::filesystem::path& path)
+	{
+		auto text = path.generic_u8string();
+		return std::string(text.begin(), text.end());
+	}
+
+	uint32_t Clamp(unsigned long value)
+	{
+		return static_cast<uint32_t>(std::min<unsigned long>(value, UINT32_MAX));
+	}
+
+	template <typename Record>
+	void WriteRecords(std::ofstream& file, const std::vector<Record>& records)
+	{
+		file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+	}
+
+	// Adds a change to the directory and its ancestors, down to depth levels below the root
+	void AddToDirectories(std::map<std::string, Snapshot::DirectoryDelta>& directories, std::string_view directory,
+		unsigned int depth, const Snapshot::DirectoryDelta& change)
+	{
+		auto add = [&](std::string_view path) {
+			auto& totals = directories[std::string(path)];
+			totals.code += change.code;
+			totals.files += change.files;
+		};
+
+		add({});
+		size_t end = 0;
+		for (unsigned int level = 0; level < depth && !directory.empty(); ++level)
+		{
+			end = directory.find('/', end);
+			add(directory.substr(0, end));
+			if (end == std::string_view::npos) break;
+			++end;
+		}
+	}
+}
+
+bool Snapshot::Save(const std::filesystem::path& path, const DirectoryTree& tree, std::vector<Entry> entries)
+{
+	// Each directory by its path below its root; parents are numbered first, so theirs is known.
+	// Every root is "", so the same directory under two of the paths counted is one directory.
+	std::vector<std::string> relative(tree.Size());
+	for (uint32_t id = 0; id < tree.Size(); ++id)
+	{
+		uint32_t parent = tree.Parent(id);
+		if (parent == DirectoryTree::none) continue;
+
+		auto name = Utf8(tree.Path(id).filename());
+		relative[id] = relative[parent].empty() ? name : relative[parent] + '/' + name;
+	}
+	std::vector<std::string> paths = relative;
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	std::vector<uint32_t> number(tree.Size());
+	for (uint32_t id = 0; id < tree.Size(); ++id)
+	{
+		number[id] = static_cast<uint32_t>(std::lower_bound(paths.begin(), paths.end(), relative[id]) - paths.begin());
+	}
+
+	// Rows in path order, a file's own language before its embedded ones
+	std::erase_if(entries, [](const Entry& entry) { return entry.directory == DirectoryTree::none; });
+	for (auto& entry : entries) entry.directory = number[entry.directory];
+	auto key = [](const Entry& entry) {
+		return std::make_tuple(entry.directory, std::string_view(entry.name), entry.embedded, LanguageRegistry::GetInfo(entry.language).name);
+	};
+	std::sort(entries.begin(), entries.end(), [&key](const Entry& a, const Entry& b) { return key(a) < key(b); });
+
+	// Languages are stored by name, so snapshots outlive changes to the list of languages
+	std::string strings{};
+	auto intern = [&strings](std::string_view text) {
+		StringRecord record{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size()) };
+		strings += text;
+		return record;
+	};
+
+	std::vector<FILE_LANGUAGE> used{};
+	for (const auto& entry : entries) used.push_back(entry.language);
+	std::sort(used.begin(), used.end());
+	used.erase(std::unique(used.begin(), used.end()), used.end());
+	std::vector<StringRecord> language_records{};
+	for (auto language : used) language_records.push_back(intern(LanguageRegistry::GetInfo(language).name));
+
+	std::vector<DirectoryRecord> directory_records(paths.size());
+	for (size_t i = 0; i < paths.size(); ++i) directory_records[i].path = intern(paths[i]);
+
+	std::vector<FileRecord> file_records{};
+	file_records.reserve(entries.size());
+	for (const auto& entry : entries)
+	{
+		auto& directory = directory_records[entry.directory];
+		if (directory.file_count++ == 0) directory.first_file = static_cast<uint32_t>(file_records.size());
+
+		FileRecord record{};
+		record.directory = entry.directory;
+		record.name = intern(entry.name);
+		record.language = static_cast<uint16_t>(std::lower_bound(used.begin(), used.end(), entry.language) - used.begin());
+		record.embedded = entry.embedded;
+		record.code = Clamp(entry.lines.code);
+		record.comment = Clamp(entry.lines.comment);
+		record.blank = Clamp(entry.lines.blank);
+		record.total = Clamp(entry.lines.total);
+		record.size = entry.size;
+		record.modified = entry.modified;
+		file_records.push_back(record);
+	}
+
+	if (strings.size() > UINT32_MAX || file_records.size() > UINT32_MAX)
+	{
+		std::cerr << "Error: too many files for a snapshot: " << path << "\n";
+		return false;
+	}
+
+	std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+	if (!file.is_open())
+	{
+		std::cerr << "Error: unable to write snapshot: " << path << "\n";
+		return false;
+	}
+
+	Header header{};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.byte_order = byte_order;
+	header.language_count = static_cast<uint32_t>(language_records.size());
+	header.directory_count = directory_records.size();
+	header.file_count = file_records.size();
+	header.string_bytes = strings.size();
+	header.created = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	WriteRecords(file, language_records);
+	WriteRecords(file, directory_records);
+	WriteRecords(file, file_records);
+	file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+	return static_cast<bool>(file);
+}
+
+bool Snapshot::Load(const std::filesystem::path& path)
+{
+	std::ifstream file{ path, std::ios::binary | std::ios::ate };
+	if (!file.is_open())
+	{
+		std::cerr << "Error: unable to open snapshot: " << path << "\n";
+		return false;
+	}
+
+	auto bytes = static_cast<size_t>(file.tellg());
+	data.assign((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(bytes));
+
+	Header header{};
+	bool valid = file && bytes >= sizeof(header);
+	if (valid)
+	{
+		std::memcpy(&header, data.data(), sizeof(header));
+		valid = std::memcmp(header.magic, magic, sizeof(magic)) == 0 && header.version == version && header.byte_order == byte_order;
+	}
+	if (!valid)
+	{
+		std::cerr << "Error: not a loc snapshot (version " << version << "): " << path << "\n";
+		data.clear();
+		return false;
+	}
+
+	auto corrupt = [&] {
+		std::cerr << "Error: corrupt snapshot: " << path << "\n";
+		data.clear();
+		return false;
+	};
+
+	// every count is bounded by the size of the file, so the sums below can't overflow
+	if (header.directory_count > bytes || header.file_count > bytes || header.string_bytes > bytes) return corrupt();
+	directory_count = static_cast<size_t>(header.directory_count);
+	file_count = static_cast<size_t>(header.file_count);
+	string_bytes = static_cast<size_t>(header.string_bytes);
+	directories_offset = sizeof(Header) + size_t{ header.language_count } * sizeof(StringRecord);
+	files_offset = directories_offset + directory_count * sizeof(DirectoryRecord);
+	strings_offset = files_offset + file_count * sizeof(FileRecord);
+	if (strings_offset + string_bytes != bytes) return corrupt();
+
+	// Check every record once, so reading them later needs no checks
+	auto base = reinterpret_cast<const char*>(data.data());
+	auto in_strings = [this](const StringRecord& text) { return size_t{ text.offset } + text.length <= string_bytes; };
+
+	languages.clear();
+	auto language_records = reinterpret_cast<const StringRecord*>(base + sizeof(Header));
+	for (uint32_t i = 0; i < header.language_count; ++i)
+	{
+		if (!in_strings(language_records[i])) return corrupt();
+		auto name = std::string_view(base + strings_offset + language_records[i].offset, language_records[i].length);
+		languages.push_back(LanguageRegistry::FromName(name).value_or(FILE_LANGUAGE::Other));
+	}
+
+	auto directory_records = reinterpret_cast<const DirectoryRecord*>(base + directories_offset);
+	for (size_t i = 0; i < directory_count; ++i)
+	{
+		const auto& directory = directory_records[i];
+		if (!in_strings(directory.path) || size_t{ directory.first_file } + directory.file_count > file_count) return corrupt();
+	}
+
+	auto file_records = reinterpret_cast<const FileRecord*>(base + files_offset);
+	for (size_t i = 0; i < file_count; ++i)
+	{
+		const auto& record = file_records[i];
+		if (record.directory >= directory_count || !in_strings(record.name) || record.language >= languages.size()) return corrupt();
+	}
+
+	return true;
+}
+
+size_t Snapshot::DirectoryCount() const
+{
+	return directory_count;
+}
+
+std::string_view Snapshot::Directory(size_t directory) const
+{
+	auto base = reinterpret_cast<const char*>(data.data());
+	const auto& record = reinterpret_cast<const DirectoryRecord*>(base + directories_offset)[directory];
+	return std::string_view(base + strings_offset + record.path.offset, record.path.length);
+}
+
+size_t Snapshot::FileCount() const
+{
+	return file_count;
+}
+
+Snapshot::File Snapshot::GetFile(size_t file) const
+{
+	auto base = reinterpret_cast<const char*>(data.data());
+	const auto& record = reinterpret_cast<const FileRecord*>(base + files_offset)[file];
+
+	File row{};
+	row.directory = record.directory;
+	row.name = std::string_view(base + strings_offset + record.name.offset, record.name.length);
+	row.language = languages[record.language];
+	row.embedded = record.embedded != 0;
+	row.lines.code = record.code;
+	row.lines.comment = record.comment;
+	row.lines.blank = record.blank;
+	row.lines.total = record.total;
+	row.size = record.size;
+	row.modified = record.modified;
+	return row;
+}
+
+Snapshot::Range Snapshot::Files(size_t directory) const
+{
+	auto base = reinterpret_cast<const char*>(data.data());
+	const auto& record = reinterpret_cast<const DirectoryRecord*>(base + directories_offset)[directory];
+	return { record.first_file, size_t{ record.first_file } + record.file_count };
+}
+
+Snapshot::Delta Snapshot::Compare(const Snapshot& before, const Snapshot& after, unsigned int depth)
+{
+	static const Snapshot empty{};
+	Delta delta{};
+
+	// Both are sorted by directory path, and within a directory by name, so one pass over each finds every change
+	size_t b = 0;
+	size_t a = 0;
+	while (b < before.DirectoryCount() || a < after.DirectoryCount())
+	{
+		int order = b == before.DirectoryCount() ? 1
+			: a == after.DirectoryCount() ? -1
+			: before.Directory(b).compare(after.Directory(a));
+
+		DirectoryDelta changed{};
+		std::string_view directory{};
+		if (order < 0)
+		{
+			directory = before.Directory(b);
+			CompareFiles(before, before.Files(b++), empty, {}, delta.languages, changed);
+		}
+		else if (order > 0)
+		{
+			directory = after.Directory(a);
+			CompareFiles(empty, {}, after, after.Files(a++), delta.languages, changed);
+		}
+		else
+		{
+			directory = after.Directory(a);
+			CompareFiles(before, before.Files(b++), after, after.Files(a++), delta.languages, changed);
+		}
+
+		if (changed.files > 0 || changed.code != 0) AddToDirectories(delta.directories, directory, depth, changed);
+	}
+
+	return delta;
+}
+
+void Snapshot::CompareFiles(const Snapshot& before, Range old_files, const Snapshot& after, Range new_files,
+	std::map<FILE_LANGUAGE, LanguageDelta>& languages, DirectoryDelta& directory)
+{
+	// the rows of one file: its own language first, then any embedded ones
+	auto rows_of = [](const Snapshot& snapshot, Range& files) {
+		Range rows{ files.begin, files.begin };
+		if (files.begin == files.end) return rows;
+		auto name = snapshot.GetFile(files.begin).name;
+		while (rows.end < files.end && snapshot.GetFile(rows.end).name == name) ++rows.end;
+		files.begin = rows.end;
+		return rows;
+	};
+
+	auto add = [&](const Snapshot& snapshot, Range rows, long long sign) {
+		for (size_t i = rows.begin; i < rows.end; ++i)
+		{
+			auto row = snapshot.GetFile(i);
+			auto& totals = languages[row.language];
+			totals.code += sign * static_cast<long long>(row.lines.code);
+			totals.comment += sign * static_cast<long long>(row.lines.comment);
+			totals.blank += sign * static_cast<long long>(row.lines.blank);
+			directory.code += sign * static_cast<long long>(row.lines.code);
+		}
+		if (rows.begin < rows.end)
+		{
+			languages[snapshot.GetFile(rows.begin).language].files++;
+		}
+	};
+
+	auto same = [&](Range old_rows, Range new_rows) {
+		if (old_rows.end - old_rows.begin != new_rows.end - new_rows.begin) return false;
+		for (size_t i = 0; i < old_rows.end - old_rows.begin; ++i)
+		{
+			auto old_row = before.GetFile(old_rows.begin + i);
+			auto new_row = after.GetFile(new_rows.begin + i);
+			if (old_row.language != new_row.language || old_row.embedded != new_row.embedded ||
+				old_row.lines.code != new_row.lines.code || old_row.lines.comment != new_row.lines.comment ||
+				old_row.lines.blank != new_row.lines.blank)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	while (old_files.begin < old_files.end || new_files.begin < new_files.end)
+	{
+		int order = old_files.begin == old_files.end ? 1
+			: new_files.begin == new_files.end ? -1
+			: before.GetFile(old_files.begin).name.compare(after.GetFile(new_files.begin).name);
+
+		Range old_rows = order <= 0 ? rows_of(before, old_files) : Range{};
+		Range new_rows = order >= 0 ? rows_of(after, new_files) : Range{};
+		if (order == 0 && same(old_rows, new_rows)) continue;
+
+		// a changed file counts once, against its language before and after if that changed
+		add(before, old_rows, -1);
+		add(after, new_rows, +1);
+		if (order == 0 && before.GetFile(old_rows.begin).language == after.GetFile(new_rows.begin).language)
+		{
+			languages[after.GetFile(new_rows.begin).language].files--;
+		}
+		directory.files++;
+	}
+}
+
+void Snapshot::PrintDirectories(std::ostream& out, const std::map<std::string, DirectoryDelta>& directories)
+{
+	if (directories.empty()) return;
+
+	out << std::right << std::setw(12) << "Code" << "  " << std::setw(10) << "Files" << "  Directory\n";
+	for (const auto& [directory, delta] : directories)
+	{
+		out << std::right << std::showpos << std::setw(12) << delta.code << std::noshowpos << "  "
+			<< std::setw(10) << delta.files << "  " << (directory.empty() ? std::string(".") : directory) << '\n';
+	}
+}
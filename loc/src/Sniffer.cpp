@@ -0,0 +1,126 @@
+#include "Sniffer.h"
+
+#include <cstring>
+
+namespace
+{
+	// Markers code generators put in their output. "DO NOT EDIT" covers Go's
+	// "Code generated ... DO NOT EDIT." and most others.
+	constexpr std::string_view generated_markers[]{
+		"DO NOT EDIT",
+		"@generated",
+		"<auto-generated",
+		"This file was automatically generated",
+	};
+
+	// Starts of line comments in the languages generators write, and of shebangs
+	constexpr std::string_view line_comments[]{ "//", "#", "--", ";", "%", "'", "*" };
+
+	// Block comments, which a header may be written in
+	struct BlockComment
+	{
+		std::string_view open;
+		std::string_view close;
+	};
+	constexpr BlockComment block_comments[]{ { "/*", "*/" }, { "<!--", "-->" }, { "\"\"\"", "\"\"\"" } };
+
+	bool HasMarker(std::string_view text)
+	{
+		for (auto marker : generated_markers)
+		{
+			if (text.find(marker) != std::string_view::npos) return true;
+		}
+		return false;
+	}
+
+	// Whether the comments and blank lines the file starts with carry a generator's marker. Markers
+	// further down are in the code itself, such as a string or a check for generated files.
+	bool HasGeneratedHeader(std::string_view head)
+	{
+		std::string_view close{};	// the end of the block comment the line is in, if any
+		size_t line_start = 0;
+		while (line_start < head.size())
+		{
+			size_t line_end = head.find('\n', line_start);
+			if (line_end == std::string_view::npos) line_end = head.size();
+			auto line = head.substr(line_start, line_end - line_start);
+			line_start = line_end + 1;
+
+			if (close.empty())
+			{
+				size_t indent = line.find_first_not_of(" \t\r\f\v");
+				if (indent == std::string_view::npos) continue;
+				line.remove_prefix(indent);
+
+				bool comment = false;
+				for (const auto& block : block_comments)
+				{
+					if (line.starts_with(block.open))
+					{
+						comment = true;
+						if (line.find(block.close, block.open.size()) == std::string_view::npos) close = block.close;
+						break;
+					}
+				}
+				for (auto start : line_comments)
+				{
+					comment = comment || line.starts_with(start);
+				}
+				if (!comment) return false;
+			}
+			else if (line.find(close) != std::string_view::npos)
+			{
+				close = {};
+			}
+
+			if (HasMarker(line)) return true;
+		}
+		return false;
+	}
+}
+
+FILE_KIND Sniffer::Sniff(std::string_view head)
+{
+	head = head.substr(0, sniff_size);
+
+	if (std::memchr(head.data(), '\0', head.size()) != nullptr)
+	{
+		return FILE_KIND::Binary;
+	}
+
+	// The last line may be cut off by the end of the sniffed bytes, which only ever makes it shorter.
+	// A single long line, such as a table or an embedded key, isn't enough: minified files are mostly long lines.
+	size_t lines = 0;
+	size_t long_lines = 0;
+	size_t line_start = 0;
+	while (line_start < head.size())
+	{
+		size_t line_end = head.find('\n', line_start);
+		if (line_end == std::string_view::npos) line_end = head.size();
+		++lines;
+		if (line_end - line_start >= minified_line_length) ++long_lines;
+		line_start = line_end + 1;
+	}
+	if (lines > 0 && (long_lines * 2 > lines || head.size() / lines >= minified_average_length))
+	{
+		return FILE_KIND::Minified;
+	}
+
+	if (HasGeneratedHeader(head))
+	{
+		return FILE_KIND::Generated;
+	}
+
+	return FILE_KIND::Source;
+}
+
+std::string_view Sniffer::Describe(FILE_KIND kind)
+{
+	switch (kind)
+	{
+	case FILE_KIND::Binary: return "binary files";
+	case FILE_KIND::Minified: return "minified files";
+	case FILE_KIND::Generated: return "generated files";
+	default: return "source files";
+	}
+}
@@ -0,0 +1,110 @@
+#include "TextEncoding.h"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	// Only the start of the file is looked at when there is no byte order mark
+	constexpr size_t detect_size = 4096;
+
+	bool StartsWith(std::string_view head, std::string_view prefix)
+	{
+		return head.substr(0, prefix.size()) == prefix;
+	}
+
+	template <typename Unit>
+	size_t DecodeUnits(const char* bytes, size_t size, bool swap, Unit* out)
+	{
+		size_t count = size / sizeof(Unit);
+		std::memcpy(out, bytes, count * sizeof(Unit));
+		if (swap) {
+			for (size_t i = 0; i < count; ++i) {
+				if constexpr (sizeof(Unit) == 2) {
+					out[i] = static_cast<Unit>((out[i] >> 8) | (out[i] << 8));
+				}
+				else {
+					uint32_t u = out[i];
+					out[i] = static_cast<Unit>((u >> 24) | ((u >> 8) & 0xFF00) | ((u << 8) & 0xFF0000) | (u << 24));
+				}
+			}
+		}
+		return count;
+	}
+}
+
+TEXT_ENCODING TextEncoding::Detect(std::string_view head, size_t& bom_length)
+{
+	using namespace std::string_view_literals;
+
+	// UTF-32LE's mark starts with UTF-16LE's, so it is checked first
+	struct Mark { std::string_view bytes; TEXT_ENCODING encoding; };
+	constexpr Mark marks[]{
+		{ "\x00\x00\xFE\xFF"sv, TEXT_ENCODING::Utf32BE },
+		{ "\xFF\xFE\x00\x00"sv, TEXT_ENCODING::Utf32LE },
+		{ "\xFE\xFF"sv, TEXT_ENCODING::Utf16BE },
+		{ "\xFF\xFE"sv, TEXT_ENCODING::Utf16LE },
+		{ "\xEF\xBB\xBF"sv, TEXT_ENCODING::Utf8 },
+	};
+	for (const auto& mark : marks) {
+		if (StartsWith(head, mark.bytes)) {
+			bom_length = mark.bytes.size();
+			return mark.encoding;
+		}
+	}
+	bom_length = 0;
+
+	// Without a mark, mostly-ASCII text in wide units has NUL bytes in fixed positions:
+	// x0 x0 for UTF-16LE, 0x 0x for UTF-16BE, x000 for UTF-32LE and 000x for UTF-32BE
+	head = head.substr(0, detect_size);
+	size_t groups = head.size() / 4;
+	if (groups == 0) return TEXT_ENCODING::Utf8;
+
+	size_t zeros[4]{};
+	for (size_t i = 0; i < groups * 4; ++i) {
+		zeros[i % 4] += head[i] == '\0';
+	}
+
+	// most positions must match, allowing for some non-ASCII text
+	auto most = [groups](size_t count) { return count * 10 >= groups * 7; };
+	auto few = [groups](size_t count) { return count * 10 <= groups; };
+
+	if (few(zeros[0]) && most(zeros[1]) && most(zeros[2]) && most(zeros[3])) return TEXT_ENCODING::Utf32LE;
+	if (most(zeros[0]) && most(zeros[1]) && most(zeros[2]) && few(zeros[3])) return TEXT_ENCODING::Utf32BE;
+	if (few(zeros[0]) && few(zeros[2]) && most(zeros[1]) && most(zeros[3])) return TEXT_ENCODING::Utf16LE;
+	if (most(zeros[0]) && most(zeros[2]) && few(zeros[1]) && few(zeros[3])) return TEXT_ENCODING::Utf16BE;
+
+	return TEXT_ENCODING::Utf8;
+}
+
+size_t TextEncoding::UnitSize(TEXT_ENCODING encoding)
+{
+	switch (encoding)
+	{
+	case TEXT_ENCODING::Utf16LE:
+	case TEXT_ENCODING::Utf16BE:
+		return 2;
+	case TEXT_ENCODING::Utf32LE:
+	case TEXT_ENCODING::Utf32BE:
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+bool TextEncoding::NeedsSwap(TEXT_ENCODING encoding)
+{
+	bool big_endian = encoding == TEXT_ENCODING::Utf16BE || encoding == TEXT_ENCODING::Utf32BE;
+	return UnitSize(encoding) > 1 && big_endian != (std::endian::native == std::endian::big);
+}
+
+size_t TextEncoding::Decode(const char* bytes, size_t size, bool swap, char16_t* out)
+{
+	return DecodeUnits(bytes, size, swap, out);
+}
+
+size_t TextEncoding::Decode(const char* bytes, size_t size, bool swap, char32_t* out)
+{
+	return DecodeUnits(bytes, size, swap, out);
+}
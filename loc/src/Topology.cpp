@@ -0,0 +1,129 @@
+#include "Topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	// The CPUs this process may run on, which can be fewer than the machine has (taskset, cgroups)
+	std::vector<unsigned int> AllowedCpus()
+	{
+		std::vector<unsigned int> cpus{};
+#ifdef __linux__
+		cpu_set_t set{};
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		{
+			for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			{
+				if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+			}
+		}
+#endif
+		if (cpus.empty())
+		{
+			for (unsigned int cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); ++cpu) cpus.push_back(cpu);
+		}
+		return cpus;
+	}
+}
+
+Topology Topology::Detect()
+{
+	auto allowed = AllowedCpus();
+	std::vector<Node> nodes{};
+
+#ifdef __linux__
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it{ "/sys/devices/system/node", ec }, end; !ec && it != end; it.increment(ec))
+	{
+		auto name = it->path().filename().string();
+		unsigned int id = 0;
+		if (!name.starts_with("node") || std::from_chars(name.data() + 4, name.data() + name.size(), id).ec != std::errc{}) continue;
+
+		std::ifstream file{ it->path() / "cpulist" };
+		std::string list{};
+		if (!std::getline(file, list)) continue;
+
+		Node node{ id, {} };
+		for (unsigned int cpu : ParseCpuList(list))
+		{
+			if (std::binary_search(allowed.begin(), allowed.end(), cpu)) node.cpus.push_back(cpu);
+		}
+		nodes.push_back(std::move(node));
+	}
+	std::sort(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+	std::erase_if(nodes, [](const Node& node) { return node.cpus.empty(); });
+#endif
+
+	if (nodes.empty()) nodes.push_back({ 0, std::move(allowed) });
+	return Topology{ std::move(nodes) };
+}
+
+Topology::Topology(std::vector<Node> nodes)
+	: nodes(std::move(nodes))
+{
+	std::erase_if(this->nodes, [](const Node& node) { return node.cpus.empty(); });
+	if (this->nodes.empty()) this->nodes.push_back({ 0, { 0 } });
+}
+
+const std::vector<Topology::Node>& Topology::Nodes() const
+{
+	return nodes;
+}
+
+Topology::Placement Topology::Place(unsigned int worker) const
+{
+	auto node = static_cast<unsigned int>(worker % nodes.size());
+	const auto& cpus = nodes[node].cpus;
+	return { node, cpus[(worker / nodes.size()) % cpus.size()] };
+}
+
+bool Topology::Pin(unsigned int cpu)
+{
+#ifdef __linux__
+	if (cpu >= CPU_SETSIZE) return false;
+
+	cpu_set_t set{};
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+std::vector<unsigned int> Topology::ParseCpuList(std::string_view list)
+{
+	std::vector<unsigned int> cpus{};
+	while (!list.empty())
+	{
+		auto comma = list.find(',');
+		auto range = list.substr(0, comma);
+		list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+
+		while (!range.empty() && (range.back() == '\n' || range.back() == ' ')) range.remove_suffix(1);
+		unsigned int first = 0;
+		unsigned int last = 0;
+		auto [end, error] = std::from_chars(range.data(), range.data() + range.size(), first);
+		if (error != std::errc{}) continue;
+		last = first;
+		if (end != range.data() + range.size())
+		{
+			if (*end != '-' || std::from_chars(end + 1, range.data() + range.size(), last).ec != std::errc{} || last < first) continue;
+		}
+
+		for (unsigned int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+	}
+	return cpus;
+}
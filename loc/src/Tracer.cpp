@@ -0,0 +1,160 @@
+#include "Tracer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <type_traits>
+
+namespace
+{
+	// tells tracers apart in the threads' caches, even when one is created where another was freed
+	std::atomic<uint64_t> next_instance{ 1 };
+
+	struct LocalBuffer
+	{
+		uint64_t instance{};
+		void* buffer{};
+	};
+	thread_local LocalBuffer local{};
+
+	void WriteJsonString(std::ostream& out, const std::string& text)
+	{
+		out << '"';
+		for (unsigned char c : text)
+		{
+			if (c == '"' || c == '\\') out << '\\' << c;
+			else if (c < 0x20)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out << escaped;
+			}
+			else out << c;
+		}
+		out << '"';
+	}
+
+	// trace timestamps are in microseconds
+	void WriteMicroseconds(std::ostream& out, int64_t ns)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%lld.%03lld", static_cast<long long>(ns / 1000), static_cast<long long>(ns % 1000));
+		out << text;
+	}
+}
+
+Tracer::Tracer(size_t capacity)
+	: capacity(capacity == 0 ? 1 : capacity), instance(next_instance.fetch_add(1, std::memory_order_relaxed)),
+	started(std::chrono::steady_clock::now())
+{
+}
+
+Tracer::Buffer& Tracer::Local()
+{
+	if (local.instance == instance) return *static_cast<Buffer*>(local.buffer);
+
+	// first event of this thread: give it a buffer
+	std::scoped_lock lock(mutex);
+	auto& buffer = buffers.emplace_back(std::make_unique<Buffer>());
+	buffer->id = static_cast<unsigned int>(buffers.size());
+	local = { instance, buffer.get() };
+	return *buffer;
+}
+
+void Tracer::NameThread(std::string name)
+{
+	Local().name = std::move(name);
+}
+
+void Tracer::Record(const char* name, const char* category, std::chrono::steady_clock::time_point begin,
+	const std::filesystem::path* path)
+{
+	auto end = std::chrono::steady_clock::now();
+	Buffer& buffer = Local();
+
+	// fill the buffer, then overwrite the oldest events; the strings keep their storage for the next event
+	if (buffer.events.size() < capacity) buffer.events.emplace_back();
+	Event& event = buffer.events[buffer.recorded % capacity];
+	buffer.recorded++;
+
+	event.name = name;
+	event.category = category;
+	event.begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - started).count();
+	event.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+	if (!path) event.detail.clear();
+	else if constexpr (std::is_same_v<std::filesystem::path::value_type, char>) event.detail.assign(path->native());
+	else event.detail = path->string();
+}
+
+size_t Tracer::Dropped() const
+{
+	std::scoped_lock lock(mutex);
+	size_t dropped = 0;
+	for (const auto& buffer : buffers)
+	{
+		if (buffer->recorded > buffer->events.size()) dropped += buffer->recorded - buffer->events.size();
+	}
+	return dropped;
+}
+
+void Tracer::Write(std::ostream& out) const
+{
+	size_t dropped = Dropped();
+	std::scoped_lock lock(mutex);
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (const auto& buffer : buffers)
+	{
+		if (!buffer->name.empty())
+		{
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+			WriteJsonString(out, buffer->name);
+			out << "}}";
+			first = false;
+		}
+
+		// oldest first; once the ring has wrapped that is the next one to be overwritten
+		size_t count = buffer->events.size();
+		size_t oldest = buffer->recorded > count ? buffer->recorded % count : 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Event& event = buffer->events[(oldest + i) % count];
+			out << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+			WriteMicroseconds(out, event.begin_ns);
+			out << ",\"dur\":";
+			WriteMicroseconds(out, event.duration_ns);
+			if (!event.detail.empty())
+			{
+				out << ",\"args\":{\"path\":";
+				WriteJsonString(out, event.detail);
+				out << '}';
+			}
+			out << '}';
+			first = false;
+		}
+	}
+
+	out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+}
+
+bool Tracer::Write(const std::filesystem::path& path) const
+{
+	std::ofstream file{ path, std::ios::binary };
+	if (!file.is_open()) return false;
+
+	Write(file);
+	return static_cast<bool>(file);
+}
+
+TraceSpan::TraceSpan(Tracer* tracer, const char* name, const char* category, const std::filesystem::path* path)
+	: tracer(tracer), name(name), category(category), path(path)
+{
+	if (tracer) begin = std::chrono::steady_clock::now();
+}
+
+TraceSpan::~TraceSpan()
+{
+	if (tracer) tracer->Record(name, category, begin, path);
+}
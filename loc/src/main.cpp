@@ -3,12 +3,19 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <climits>
+#include <cmath>
 #include <locale>
 #include <filesystem>
+#include <map>
+#include <sstream>
 
 #include <CLI/CLI.hpp>
 
 #include "Counter.h"
+#include "GitDiff.h"
+#include "PartialResult.h"
+#include "Snapshot.h"
 
 
 // struct for printing out large numbers with commas
@@ -53,20 +60,255 @@ int main(int argc, char** argv)
 	vector<fs::path> ignore_dirs{};
 	app.add_option("-i,--ignore", ignore_dirs, "Directories to ignore");
 
+	string max_size{};
+	app.add_option("--max-size", max_size, "Leave out files larger than SIZE bytes, among those found by scanning directories; K, M, G and T multiply by 1024")->type_name("SIZE");
+
+	string min_size{};
+	app.add_option("--min-size", min_size, "Leave out files smaller than SIZE bytes, among those found by scanning directories; K, M, G and T multiply by 1024")->type_name("SIZE");
+
+	string newer_than{};
+	app.add_option("--newer-than", newer_than, "Only count files modified within this long (90s, 30m, 12h, 7d, 2w) or since this date (2024-05-31), among those found by scanning directories");
+
+	string older_than{};
+	app.add_option("--older-than", older_than, "Only count files last modified this long ago (90s, 30m, 12h, 7d, 2w) or before this date (2024-05-31), among those found by scanning directories");
+
+	unsigned max_depth = UINT_MAX;
+	app.add_option("--max-depth", max_depth, "Only look this many levels of directories below the directories given; 0 counts only their own files");
+
+	string shard{};
+	app.add_option("--shard", shard, "Only count shard i of N (i/N, 1 based) of the files, for splitting a run across machines");
+
+	fs::path partial_path{};
+	app.add_option("--partial", partial_path, "Write the per-language totals to a partial result file for 'loc merge'");
+
+	fs::path snapshot_path{};
+	app.add_option("--save-snapshot", snapshot_path, "Write the counts of every file to a binary snapshot for 'loc compare'");
+
+	string read_order = "none";
+	app.add_option("--read-order", read_order, "Read files in on-disk order: none, inode or extent. Only used on rotational or network storage")
+		->check(CLI::IsMember({ "none", "inode", "extent" }))
+		->capture_default_str();
+
+	bool force_read_order = false;
+	app.add_flag("--force-read-order", force_read_order, "Apply --read-order even on SSDs and tmpfs (for benchmarking)");
+
+	bool prefetch = false;
+	app.add_flag("--prefetch", prefetch, "Ask the kernel to read files into the page cache ahead of the workers (Linux only)");
+
+	size_t prefetch_window = 0;
+	app.add_option("--prefetch-window", prefetch_window, "Most files to prefetch ahead of the workers; 0 sizes the window from the read latency")
+		->check(CLI::NonNegativeNumber)
+		->capture_default_str();
+
+	bool pin = false;
+	app.add_flag("--pin", pin, "Pin each worker to a CPU, spread over the NUMA nodes, and give each node its own share of the files (Linux)");
+
+	bool stats = false;
+	app.add_flag("--stats", stats, "Also list the files, bytes and throughput of the workers on each NUMA node");
+
+	fs::path dir_cache{};
+	app.add_option("--dir-cache", dir_cache, "Keep directory listings in this file between runs, and only read the directories that changed since (Linux)");
+
+	bool include_unusual = false;
+	app.add_flag("--include-unusual", include_unusual, "Count binary, minified and generated files instead of skipping them");
+
+	bool fast = false;
+	app.add_flag("--fast", fast, "Only count blank and non-blank lines, without telling comments from code");
+
+	bool tree = false;
+	app.add_flag("--tree", tree, "Also list the code lines and files of every directory, largest first, with their main languages");
+
+	unsigned tree_depth = UINT_MAX;
+	app.add_option("--depth", tree_depth, "With --tree, only list directories down to this many levels below the paths given");
+
+	bool by_project = false;
+	app.add_flag("--by-project", by_project, "Also list the lines of every project, a directory with a CMakeLists.txt, package.json, Cargo.toml, go.mod, *.csproj or similar manifest");
+
+	bool markdown = false;
+	app.add_flag("--markdown", markdown, "Count Markdown files, with fenced code blocks counted as the language they are tagged with");
+
+	bool progress = false;
+	app.add_flag("--progress", progress, "Show files and bytes done, throughput and ETA on stderr while counting");
+
+	bool progress_json = false;
+	app.add_flag("--progress-json", progress_json, "Write progress to stderr as one JSON object per line");
+
+	fs::path trace_path{};
+	app.add_option("--trace", trace_path, "Write a timeline of the scan and of every worker to this file, as Chrome trace-event JSON");
+
+	unsigned progress_interval = 1000;
+	app.add_option("--progress-interval", progress_interval, "Milliseconds between progress reports")
+		->check(CLI::PositiveNumber)
+		->capture_default_str();
+
+	bool estimate = false;
+	app.add_flag("--estimate", estimate, "Count a random sample of the files and extrapolate, stopping once the total is known to within 1%");
+
+	unsigned time_budget = 0;
+	app.add_option("--time-budget", time_budget, "Estimate from as many files as can be counted in this many milliseconds")
+		->check(CLI::NonNegativeNumber);
+
+	string files_from{};
+	app.add_option("--files-from", files_from, "Also count the files listed in this file, one per line (- for stdin). Counting starts while the list is read");
+
+	bool null_separated = false;
+	app.add_flag("-0,--null", null_separated, "The --files-from list is NUL separated, as from find -print0 or git ls-files -z");
+
+	string diff_range{};
+	app.add_option("--diff", diff_range, "Count the lines of code changed since BASE (against the working tree), or in BASE..HEAD or BASE...HEAD, per language and per file. Paths limit the diff");
+
 	vector<fs::path> paths{};
 	app.add_option("paths", paths, "Files and Directories to count")
 		->check(CLI::ExistingPath)
 		->expected(0, -1);
 
+	// Subcommand for combining the partial results of a sharded run
+	CLI::App* merge = app.add_subcommand("merge", "Combine partial results written with --partial");
+	vector<fs::path> partial_files{};
+	merge->add_option("partials", partial_files, "Partial result files to combine")
+		->check(CLI::ExistingFile)
+		->required();
+
+	// Subcommand for the change between two runs, without the source trees
+	CLI::App* compare = app.add_subcommand("compare", "Show the change in lines per language and directory between two snapshots written with --save-snapshot");
+	vector<fs::path> snapshot_files{};
+	compare->add_option("snapshots", snapshot_files, "The earlier and the later snapshot")
+		->check(CLI::ExistingFile)
+		->expected(2)
+		->required();
+	unsigned compare_depth = 1;
+	compare->add_option("--depth", compare_depth, "List directories down to this many levels below the paths counted")
+		->capture_default_str();
+
 	// Parse the CLI arguments
 	CLI11_PARSE(app, argc, argv);
 
+	if (merge->parsed())
+	{
+		std::map<FILE_LANGUAGE, LanguageTotals> counts{};
+		SkippedCounts skipped{};
+		for (const auto& partial : partial_files)
+		{
+			if (!PartialResult::Load(partial, counts, &skipped)) return 1;
+		}
+
+		unsigned long lines = 0;
+		for (const auto& [language, totals] : counts) lines += totals.lines.code;
+
+		Counter::PrintLanguageBreakdown(counts);
+		Counter::PrintSkipped(skipped);
+		cout << "\nCounted " << lines << " lines of code";
+
+		auto end = std::chrono::high_resolution_clock::now();
+		chrono::duration<double, std::milli> duration = end - start;
+		cout << " in " << duration.count() << "ms\n";
+		return 0;
+	}
+
+	if (compare->parsed())
+	{
+		Snapshot before{};
+		Snapshot after{};
+		if (!before.Load(snapshot_files[0]) || !after.Load(snapshot_files[1])) return 1;
+
+		auto delta = Snapshot::Compare(before, after, compare_depth);
+		long long net = 0;
+		for (const auto& [language, change] : delta.languages) net += change.code;
+
+		GitDiff::PrintLanguageBreakdown(delta.languages);
+		if (!delta.directories.empty()) cout << std::endl;
+		Snapshot::PrintDirectories(cout, delta.directories);
+		cout << "\nNet " << std::showpos << net << std::noshowpos << " lines of code";
+
+		auto end = std::chrono::high_resolution_clock::now();
+		chrono::duration<double, std::milli> duration = end - start;
+		cout << " in " << duration.count() << "ms\n";
+		return 0;
+	}
+
+	CounterOptions options{};
+	if (!shard.empty())
+	{
+		char separator = 0;
+		std::istringstream shard_stream{ shard };
+		shard_stream >> options.shard_index >> separator >> options.shard_count;
+		if (shard_stream.fail() || separator != '/' || !shard_stream.eof() || options.shard_count == 0 ||
+			options.shard_index == 0 || options.shard_index > options.shard_count)
+		{
+			std::cerr << "Error: --shard must be i/N with 1 <= i <= N, got " << shard << "\n";
+			return 1;
+		}
+	}
+
+	// Size and age limits are checked against the metadata of each file the scan finds, before it is opened
+	auto parse_size = [](const string& text, const char* name, uintmax_t& limit)
+	{
+		if (text.empty()) return true;
+		auto size = ScanFilter::ParseSize(text);
+		if (!size)
+		{
+			std::cerr << "Error: " << name << " must be a number of bytes with an optional K, M or G suffix, got " << text << "\n";
+			return false;
+		}
+		limit = *size;
+		return true;
+	};
+	auto now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+	auto parse_time = [now](const string& text, const char* name, int64_t& limit)
+	{
+		if (text.empty()) return true;
+		auto time = ScanFilter::ParseTime(text, now);
+		if (!time)
+		{
+			std::cerr << "Error: " << name << " must be an age such as 12h, 7d or 2w, or a date such as 2024-05-31, got " << text << "\n";
+			return false;
+		}
+		limit = *time;
+		return true;
+	};
+	if (!parse_size(max_size, "--max-size", options.filter.max_size) || !parse_size(min_size, "--min-size", options.filter.min_size) ||
+		!parse_time(newer_than, "--newer-than", options.filter.newer_than) || !parse_time(older_than, "--older-than", options.filter.older_than))
+	{
+		return 1;
+	}
+	options.filter.max_depth = max_depth;
+
 	if (version)
 	{
 		cout << "loc version 1.7.1\n";
 		return 0;
 	}
-	else if (paths.empty())
+	else if (!diff_range.empty())
+	{
+		if (!files_from.empty() || !partial_path.empty() || !snapshot_path.empty() || estimate || time_budget > 0 || !shard.empty() || fast || tree || by_project)
+		{
+			std::cerr << "Error: --diff can't be combined with --files-from, --partial, --save-snapshot, --shard, --estimate, --time-budget, --fast, --tree or --by-project\n";
+			return 1;
+		}
+
+		// only the files git reports are read, so there is no scan to filter or cache and no file queue for the workers
+		if (pin || stats || prefetch || read_order != "none" || !trace_path.empty() || progress || progress_json || !dir_cache.empty() ||
+			!max_size.empty() || !min_size.empty() || !newer_than.empty() || !older_than.empty() || max_depth != UINT_MAX)
+		{
+			std::cerr << "Error: --diff can't be combined with --pin, --stats, --prefetch, --read-order, --trace, --progress, --progress-json, --dir-cache, "
+				"--max-size, --min-size, --newer-than, --older-than or --max-depth\n";
+			return 1;
+		}
+
+		GitDiff diff(diff_range, paths, !include_unusual, markdown);
+		if (!diff.Load() || !diff.Count(jobs)) return 1;
+
+		diff.PrintFiles();
+		cout << std::endl;
+		GitDiff::PrintLanguageBreakdown(diff.ByLanguage());
+		cout << "\nNet " << std::showpos << diff.NetCode() << std::noshowpos << " lines of code";
+
+		auto end = std::chrono::high_resolution_clock::now();
+		chrono::duration<double, std::milli> duration = end - start;
+		cout << " in " << duration.count() << "ms\n";
+		return 0;
+	}
+	else if (paths.empty() && files_from.empty())
 	{
 		std::cout << app.help() << '\n';
 		return 0;
@@ -87,13 +329,105 @@ int main(int argc, char** argv)
 		}
 	}
 
-	Counter counter(jobs, directory_paths, input_files, include_generated, ignore_dirs);
+	options.read_order = read_order == "inode" ? READ_ORDER::Inode
+		: read_order == "extent" ? READ_ORDER::Extent
+		: READ_ORDER::None;
+	options.force_read_order = force_read_order;
+	options.prefetch = prefetch;
+	options.prefetch_window = prefetch_window;
+	options.estimate = estimate;
+	options.include_unusual = include_unusual;
+	options.markdown = markdown;
+	options.fast = fast;
+	options.tree = tree;
+	options.by_project = by_project;
+	options.snapshot = !snapshot_path.empty();
+	options.progress = progress_json ? PROGRESS_FORMAT::Json
+		: progress ? PROGRESS_FORMAT::Text
+		: PROGRESS_FORMAT::None;
+	options.progress_interval = chrono::milliseconds(progress_interval);
+	options.files_from = files_from;
+	options.null_separated = null_separated;
+	options.trace = trace_path;
+	options.dir_cache = dir_cache;
+	options.pin = pin;
+
+	if (!files_from.empty() && (estimate || time_budget > 0))
+	{
+		std::cerr << "Error: --files-from can't be combined with --estimate or --time-budget\n";
+		return 1;
+	}
+	options.time_budget = chrono::milliseconds(time_budget);
+
+	if (tree && (!files_from.empty() || estimate || time_budget > 0))
+	{
+		std::cerr << "Error: --tree can't be combined with --files-from, --estimate or --time-budget\n";
+		return 1;
+	}
+
+	if (by_project && (!files_from.empty() || estimate || time_budget > 0))
+	{
+		std::cerr << "Error: --by-project can't be combined with --files-from, --estimate or --time-budget\n";
+		return 1;
+	}
+
+	if (!snapshot_path.empty() && (!files_from.empty() || estimate || time_budget > 0))
+	{
+		std::cerr << "Error: --save-snapshot can't be combined with --files-from, --estimate or --time-budget\n";
+		return 1;
+	}
+
+	if (!partial_path.empty() && (estimate || time_budget > 0))
+	{
+		std::cerr << "Error: --partial can't be combined with --estimate or --time-budget\n";
+		return 1;
+	}
+
+	Counter counter(jobs, directory_paths, input_files, include_generated, ignore_dirs, options);
 	auto lines = counter.Count();
+	if (counter.Failed())
+	{
+		return 1;
+	}
+
+	if (!partial_path.empty() && !PartialResult::Save(partial_path, counter.GetLanguageCounts(), counter.GetSkippedCounts()))
+	{
+		return 1;
+	}
+
+	if (!snapshot_path.empty() && !counter.SaveSnapshot(snapshot_path))
+	{
+		return 1;
+	}
 
 	// Print the lines of code
 	cout << std::endl;
 	counter.PrintLanguageBreakdown();
-	cout << "\nCounted " << lines << " lines of code";
+	counter.PrintSkipped();
+	if (const DirectoryTree* directories = counter.GetTree())
+	{
+		cout << std::endl;
+		directories->Print(cout, tree_depth);
+	}
+	if (by_project)
+	{
+		cout << std::endl;
+		DirectoryTree::PrintProjects(cout, counter.GetProjects());
+	}
+	if (stats)
+	{
+		cout << std::endl;
+		counter.PrintStats();
+	}
+	if (const Estimator* estimator = counter.GetEstimator())
+	{
+		cout << "\nEstimated " << lines << " +/- " << std::llround(estimator->TotalCode().margin)
+			<< " lines of code (95% confidence) from " << estimator->Sampled() << " of " << estimator->FileCount() << " files";
+	}
+	else
+	{
+		cout << "\nCounted " << lines << " lines of code";
+	}
 
 
 	// print out the total time it took to count the code